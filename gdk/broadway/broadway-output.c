@@ -14,27 +14,231 @@
  *                Basic I/O primitives                                  *
  ************************************************************************/
 
+/* Frames are not written synchronously, as a slow browser would
+ * then stall the whole server. Instead they are queued and written
+ * whenever the socket accepts more data. Once more than this many
+ * bytes are waiting, the output is considered congested and the
+ * server holds back node updates, and the texture uploads they
+ * need, until it drained.
+ */
+#define OUTPUT_QUEUE_BUDGET (4 * 1024 * 1024)
+
+typedef struct {
+  GBytes *bytes;
+  gint64 queue_time;
+} QueuedFrame;
+
 struct BroadwayOutput {
   GOutputStream *out;
   GString *buf;
   int error;
   guint32 serial;
+
+  GQueue frames;
+  gsize queued_bytes;
+  gsize head_written;
+  GSource *write_source;
+  gboolean congested;
+  gint64 send_latency; /* in µs, of the last frame, for debug output */
+
+  BroadwayOutputDrainFunc drain_func;
+  gpointer drain_data;
+
+  /* permessage-deflate, if negotiated */
+  GConverter *compressor;
 };
 
+static void broadway_output_write_frames (BroadwayOutput *output);
+
+static void
+queued_frame_free (QueuedFrame *frame)
+{
+  g_bytes_unref (frame->bytes);
+  g_free (frame);
+}
+
+static gboolean
+broadway_output_can_poll (BroadwayOutput *output)
+{
+  return G_IS_POLLABLE_OUTPUT_STREAM (output->out) &&
+         g_pollable_output_stream_can_poll (G_POLLABLE_OUTPUT_STREAM (output->out));
+}
+
+static gboolean
+broadway_output_writable_cb (GObject  *stream,
+                             gpointer  user_data)
+{
+  BroadwayOutput *output = user_data;
+
+  broadway_output_write_frames (output);
+
+  if (output->congested &&
+      output->queued_bytes <= OUTPUT_QUEUE_BUDGET / 2)
+    {
+      g_debug ("Broadway output drained, last send latency %" G_GINT64_FORMAT " ms",
+               output->send_latency / 1000);
+      output->congested = FALSE;
+      /* This may queue more frames, so do it before deciding
+       * whether the source is still needed */
+      if (output->drain_func)
+        output->drain_func (output, output->drain_data);
+    }
+
+  if (!g_queue_is_empty (&output->frames) && !output->error)
+    return G_SOURCE_CONTINUE;
+
+  g_clear_pointer (&output->write_source, g_source_unref);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+broadway_output_write_frames (BroadwayOutput *output)
+{
+  gboolean can_poll = broadway_output_can_poll (output);
+
+  while (!g_queue_is_empty (&output->frames) && !output->error)
+    {
+      QueuedFrame *frame = g_queue_peek_head (&output->frames);
+      GError *error = NULL;
+      const guchar *data;
+      gsize size;
+      gssize written;
+
+      data = g_bytes_get_data (frame->bytes, &size);
+
+      if (can_poll)
+        written = g_pollable_output_stream_write_nonblocking (G_POLLABLE_OUTPUT_STREAM (output->out),
+                                                              data + output->head_written,
+                                                              size - output->head_written,
+                                                              NULL, &error);
+      else
+        written = g_output_stream_write (output->out,
+                                         data + output->head_written,
+                                         size - output->head_written,
+                                         NULL, &error);
+
+      if (written < 0)
+        {
+          if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+            {
+              g_error_free (error);
+              if (output->write_source == NULL)
+                {
+                  output->write_source = g_pollable_output_stream_create_source (G_POLLABLE_OUTPUT_STREAM (output->out), NULL);
+                  g_source_set_callback (output->write_source,
+                                         (GSourceFunc) broadway_output_writable_cb,
+                                         output, NULL);
+                  g_source_attach (output->write_source, NULL);
+                }
+              return;
+            }
+
+          g_debug ("Broadway output error: %s", error->message);
+          g_error_free (error);
+          output->error = TRUE;
+          break;
+        }
+
+      output->head_written += written;
+      output->queued_bytes -= written;
+
+      if (output->head_written == size)
+        {
+          output->send_latency = g_get_monotonic_time () - frame->queue_time;
+          queued_frame_free (g_queue_pop_head (&output->frames));
+          output->head_written = 0;
+        }
+    }
+
+  if (output->error)
+    {
+      g_queue_clear_full (&output->frames, (GDestroyNotify) queued_frame_free);
+      output->queued_bytes = 0;
+      output->head_written = 0;
+    }
+}
+
+static GBytes *
+broadway_output_deflate (BroadwayOutput *output,
+                         const void     *buf,
+                         gsize           count)
+{
+  GByteArray *out;
+  const guchar *in = buf;
+  GConverterResult res;
+
+  out = g_byte_array_sized_new (count / 2 + 64);
+
+  /* Flushing after each message ends it on a byte boundary, followed
+   * by the 00 00 ff ff marker which RFC 7692 has us strip again. The
+   * deflate context is kept across messages.
+   */
+  do
+    {
+      GError *error = NULL;
+      gsize old_len = out->len;
+      gsize avail = MAX (count + count / 1000 + 64, 1024);
+      gsize bytes_read = 0, bytes_written = 0;
+
+      g_byte_array_set_size (out, old_len + avail);
+      res = g_converter_convert (output->compressor,
+                                 in, count,
+                                 out->data + old_len, avail,
+                                 G_CONVERTER_FLUSH,
+                                 &bytes_read, &bytes_written,
+                                 &error);
+      if (res == G_CONVERTER_ERROR)
+        {
+          g_warning ("Failed to compress Broadway message: %s", error->message);
+          g_error_free (error);
+          output->error = TRUE;
+          g_byte_array_set_size (out, 0);
+          break;
+        }
+
+      g_byte_array_set_size (out, old_len + bytes_written);
+      in += bytes_read;
+      count -= bytes_read;
+    }
+  while (res != G_CONVERTER_FLUSHED);
+
+  if (out->len >= 4 &&
+      memcmp (out->data + out->len - 4, "\x00\x00\xff\xff", 4) == 0)
+    g_byte_array_set_size (out, out->len - 4);
+
+  return g_byte_array_free_to_bytes (out);
+}
+
 static void
 broadway_output_send_cmd (BroadwayOutput *output,
                           gboolean fin, BroadwayWSOpCode code,
                           const void *buf, gsize count)
 {
   gboolean mask = FALSE;
+  gboolean compressed = FALSE;
+  gboolean mid_header, long_header;
+  GBytes *compressed_bytes = NULL;
   guchar header[16];
   size_t p;
+  GByteArray *frame;
+  QueuedFrame *queued;
+
+  if (output->error)
+    return;
+
+  /* Control frames must not be compressed */
+  if (output->compressor && code == BROADWAY_WS_BINARY)
+    {
+      compressed_bytes = broadway_output_deflate (output, buf, count);
+      buf = g_bytes_get_data (compressed_bytes, &count);
+      compressed = TRUE;
+    }
 
-  gboolean mid_header = count > 125 && count <= 65535;
-  gboolean long_header = count > 65535;
+  mid_header = count > 125 && count <= 65535;
+  long_header = count > 65535;
 
   /* NB. big-endian spec => bit 0 == MSB */
-  header[0] = ( (fin ? 0x80 : 0) | (code & 0x0f) );
+  header[0] = ( (fin ? 0x80 : 0) | (compressed ? 0x40 : 0) | (code & 0x0f) );
   header[1] = ( (mask ? 0x80 : 0) |
                 (mid_header ? 126 : long_header ? 127 : count) );
   p = 2;
@@ -49,9 +253,19 @@ broadway_output_send_cmd (BroadwayOutput *output,
       p += 8;
     }
   // FIXME: if we are paranoid we should 'mask' the data
-  // FIXME: we should really emit these as a single write
-  g_output_stream_write_all (output->out, header, p, NULL, NULL, NULL);
-  g_output_stream_write_all (output->out, buf, count, NULL, NULL, NULL);
+  frame = g_byte_array_sized_new (p + count);
+  g_byte_array_append (frame, header, p);
+  if (count > 0)
+    g_byte_array_append (frame, buf, count);
+  g_clear_pointer (&compressed_bytes, g_bytes_unref);
+
+  queued = g_new (QueuedFrame, 1);
+  queued->bytes = g_byte_array_free_to_bytes (frame);
+  queued->queue_time = g_get_monotonic_time ();
+  g_queue_push_tail (&output->frames, queued);
+  output->queued_bytes += p + count;
+
+  broadway_output_write_frames (output);
 }
 
 void broadway_output_pong (BroadwayOutput *output)
@@ -63,7 +277,7 @@ int
 broadway_output_flush (BroadwayOutput *output)
 {
   if (output->buf->len == 0)
-    return TRUE;
+    return !output->error;
 
   broadway_output_send_cmd (output, TRUE, BROADWAY_WS_BINARY,
                             output->buf->str, output->buf->len);
@@ -74,6 +288,12 @@ broadway_output_flush (BroadwayOutput *output)
 
 }
 
+int
+broadway_output_has_error (BroadwayOutput *output)
+{
+  return output->error;
+}
+
 BroadwayOutput *
 broadway_output_new (GOutputStream *out, guint32 serial)
 {
@@ -84,6 +304,7 @@ broadway_output_new (GOutputStream *out, guint32 serial)
   output->out = g_object_ref (out);
   output->buf = g_string_new ("");
   output->serial = serial;
+  g_queue_init (&output->frames);
 
   return output;
 }
@@ -91,8 +312,51 @@ broadway_output_new (GOutputStream *out, guint32 serial)
 void
 broadway_output_free (BroadwayOutput *output)
 {
+  if (output->write_source)
+    {
+      g_source_destroy (output->write_source);
+      g_source_unref (output->write_source);
+    }
+  g_queue_clear_full (&output->frames, (GDestroyNotify) queued_frame_free);
+  g_clear_object (&output->compressor);
+  g_string_free (output->buf, TRUE);
   g_object_unref (output->out);
-  free (output);
+  g_free (output);
+}
+
+/* Compress all following binary frames with permessage-deflate,
+ * after the browser agreed to it in the handshake. */
+void
+broadway_output_enable_deflate (BroadwayOutput *output)
+{
+  if (output->compressor == NULL)
+    output->compressor = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW, 1));
+}
+
+void
+broadway_output_set_drain_func (BroadwayOutput          *output,
+                                BroadwayOutputDrainFunc  func,
+                                gpointer                 user_data)
+{
+  output->drain_func = func;
+  output->drain_data = user_data;
+}
+
+/* Whether so much is waiting to be written that updates which can
+ * be coalesced should be held back. Once the queue has drained to
+ * half the budget, the drain func is called.
+ */
+gboolean
+broadway_output_is_congested (BroadwayOutput *output)
+{
+  if (!output->congested && output->queued_bytes > OUTPUT_QUEUE_BUDGET)
+    {
+      g_debug ("Broadway output congested, %" G_GSIZE_FORMAT " bytes in %u frames queued",
+               output->queued_bytes, g_queue_get_length (&output->frames));
+      output->congested = TRUE;
+    }
+
+  return output->congested;
 }
 
 guint32
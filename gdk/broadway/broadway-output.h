@@ -17,11 +17,19 @@ typedef enum {
   BROADWAY_WS_CNX_PONG = 0xa
 } BroadwayWSOpCode;
 
+typedef void (* BroadwayOutputDrainFunc) (BroadwayOutput *output,
+                                          gpointer        user_data);
+
 BroadwayOutput *broadway_output_new                 (GOutputStream  *out,
                                                      guint32         serial);
 void            broadway_output_free                (BroadwayOutput *output);
 int             broadway_output_flush               (BroadwayOutput *output);
 int             broadway_output_has_error           (BroadwayOutput *output);
+void            broadway_output_enable_deflate      (BroadwayOutput *output);
+void            broadway_output_set_drain_func      (BroadwayOutput *output,
+                                                     BroadwayOutputDrainFunc func,
+                                                     gpointer        user_data);
+gboolean        broadway_output_is_congested        (BroadwayOutput *output);
 void            broadway_output_set_next_serial     (BroadwayOutput *output,
                                                      guint32         serial);
 guint32         broadway_output_get_next_serial     (BroadwayOutput *output);
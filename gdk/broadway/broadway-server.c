@@ -67,6 +67,7 @@ struct _BroadwayServer {
 
   guint32 next_texture_id;
   GHashTable *textures;
+  GHashTable *textures_by_content;
 
   guint32 screen_scale;
 
@@ -112,6 +113,7 @@ struct BroadwayInput {
   gboolean seen_time;
   gint64 time_base;
   gboolean active;
+  GConverter *decompressor;
 };
 
 struct BroadwaySurface {
@@ -126,15 +128,26 @@ struct BroadwaySurface {
   guint32 texture;
   BroadwayNode *nodes;
   GHashTable *node_lookup;
+  /* The tree last sent to the browser. This lags behind nodes
+   * while the output is congested. */
+  BroadwayNode *sent_nodes;
+  GHashTable *sent_node_lookup;
+  gboolean nodes_pending;
 };
 
 struct _BroadwayTexture {
   grefcount refcount;
   guint32 id;
   GBytes *bytes;
+  /* Whether the current output has been sent the texture. This
+   * only happens once a tree using it is sent. */
+  gboolean uploaded;
 };
 
 static void broadway_server_resync_surfaces (BroadwayServer *server);
+static void broadway_input_close (BroadwayInput *input);
+static void broadway_server_output_drained (BroadwayOutput *output,
+                                            gpointer        user_data);
 static void send_outstanding_roundtrips (BroadwayServer *server);
 
 static void broadway_server_ref_texture (BroadwayServer   *server,
@@ -264,6 +277,8 @@ broadway_server_init (BroadwayServer *server)
   server->id_counter = 0;
   server->textures = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
                                             (GDestroyNotify)broadway_texture_free);
+  server->textures_by_content = g_hash_table_new ((GHashFunc)g_bytes_hash,
+                                                  (GEqualFunc)g_bytes_equal);
 
   root = g_new0 (BroadwaySurface, 1);
   root->id = server->id_counter++;
@@ -287,6 +302,7 @@ broadway_server_finalize (GObject *object)
   g_free (server->address);
   g_free (server->ssl_cert);
   g_free (server->ssl_key);
+  g_hash_table_destroy (server->textures_by_content);
   g_hash_table_destroy (server->textures);
 
   G_OBJECT_CLASS (broadway_server_parent_class)->finalize (object);
@@ -307,6 +323,9 @@ broadway_surface_free (BroadwayServer *server,
   if (surface->nodes)
     broadway_node_unref (server, surface->nodes);
   g_hash_table_unref (surface->node_lookup);
+  if (surface->sent_nodes)
+    broadway_node_unref (server, surface->sent_nodes);
+  g_hash_table_unref (surface->sent_node_lookup);
   g_free (surface);
 }
 
@@ -336,9 +355,26 @@ broadway_input_free (BroadwayInput *input)
   g_object_unref (input->connection);
   g_byte_array_free (input->buffer, FALSE);
   g_source_destroy (input->source);
+  g_clear_object (&input->decompressor);
   g_free (input);
 }
 
+static void
+broadway_input_close (BroadwayInput *input)
+{
+  BroadwayServer *server = input->server;
+
+  if (server->input == input)
+    {
+      send_outstanding_roundtrips (server);
+
+      server->input = NULL;
+    }
+
+  g_io_stream_close (input->connection, NULL, NULL);
+  broadway_input_free (input);
+}
+
 static void
 update_event_state (BroadwayServer *server,
                     BroadwayInputMsg *message)
@@ -763,11 +799,89 @@ hex_dump (guchar *data, gsize len)
 #endif
 }
 
-static void
+/* Input messages from the browser are a few dozen bytes. A compressed
+ * message inflating to more than this is not from broadway.js.
+ */
+#define MAX_INPUT_MESSAGE_SIZE 4096
+
+/* Inverts what the browser did for permessage-deflate: the message
+ * is completed with the sync flush marker that was stripped off, and
+ * inflated with the context of the previous messages.
+ * Returns %NULL if the message is corrupt or too large.
+ */
+static GByteArray *
+inflate_input_message (BroadwayInput *input,
+                       const guchar  *data,
+                       gsize          len)
+{
+  GByteArray *in, *out;
+  const guchar *p;
+  gsize remaining, written;
+  GConverterResult res;
+
+  in = g_byte_array_sized_new (len + 4);
+  g_byte_array_append (in, data, len);
+  g_byte_array_append (in, (const guchar *) "\x00\x00\xff\xff", 4);
+
+  out = g_byte_array_sized_new (MAX_INPUT_MESSAGE_SIZE);
+  g_byte_array_set_size (out, MAX_INPUT_MESSAGE_SIZE);
+
+  p = in->data;
+  remaining = in->len;
+  written = 0;
+  do
+    {
+      GError *error = NULL;
+      gsize bytes_read = 0, bytes_written = 0;
+
+      if (written == MAX_INPUT_MESSAGE_SIZE)
+        {
+          g_warning ("Broadway input message too large");
+          goto fail;
+        }
+
+      res = g_converter_convert (input->decompressor,
+                                 p, remaining,
+                                 out->data + written, MAX_INPUT_MESSAGE_SIZE - written,
+                                 G_CONVERTER_FLUSH,
+                                 &bytes_read, &bytes_written,
+                                 &error);
+      if (res == G_CONVERTER_ERROR)
+        {
+          if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE))
+            g_warning ("Broadway input message too large");
+          else
+            g_warning ("Failed to inflate Broadway input: %s", error->message);
+          g_error_free (error);
+          goto fail;
+        }
+
+      written += bytes_written;
+      p += bytes_read;
+      remaining -= bytes_read;
+    }
+  while (res != G_CONVERTER_FLUSHED && res != G_CONVERTER_FINISHED);
+
+  g_byte_array_unref (in);
+  g_byte_array_set_size (out, written);
+
+  return out;
+
+fail:
+  g_byte_array_unref (in);
+  g_byte_array_unref (out);
+
+  return NULL;
+}
+
+/* Returns %FALSE if the browser broke the protocol, and the
+ * connection should be closed.
+ */
+static gboolean
 parse_input (BroadwayInput *input)
 {
   if (!input->buffer->len)
-    return;
+    return TRUE;
 
   hex_dump (input->buffer->data, input->buffer->len);
 
@@ -775,7 +889,7 @@ parse_input (BroadwayInput *input)
     {
       gsize len, payload_len;
       BroadwayWSOpCode code;
-      gboolean is_mask, fin;
+      gboolean is_mask, fin, compressed;
       guchar *buf, *data, *mask;
 
       buf = input->buffer->data;
@@ -786,6 +900,7 @@ parse_input (BroadwayInput *input)
 #endif
 
       fin = buf[0] & 0x80;
+      compressed = buf[0] & 0x40;
       code = buf[0] & 0x0f;
       payload_len = buf[1] & 0x7f;
       is_mask = buf[1] & 0x80;
@@ -794,14 +909,14 @@ parse_input (BroadwayInput *input)
       if (payload_len == 126)
         {
           if (len < 4)
-            return;
+            return TRUE;
           payload_len = GUINT16_FROM_BE( *(guint16 *) data );
           data += 2;
         }
       else if (payload_len == 127)
         {
           if (len < 10)
-            return;
+            return TRUE;
           payload_len = GUINT64_FROM_BE( *(guint64 *) data );
           data += 8;
         }
@@ -810,13 +925,22 @@ parse_input (BroadwayInput *input)
       if (is_mask)
         {
           if (data - buf + 4 > len)
-            return;
+            return TRUE;
           mask = data;
           data += 4;
         }
 
       if (data - buf + payload_len > len)
-        return; /* wait to accumulate more */
+        return TRUE; /* wait to accumulate more */
+
+      /* RSV1 marks compressed data messages, if permessage-deflate
+       * was negotiated. It is not allowed otherwise. */
+      if (compressed &&
+          (input->decompressor == NULL || code != BROADWAY_WS_BINARY))
+        {
+          g_warning ("Unexpected compressed Broadway input, closing connection");
+          return FALSE;
+        }
 
       if (is_mask)
         {
@@ -835,6 +959,16 @@ parse_input (BroadwayInput *input)
             g_warning ("can't yet accept fragmented input");
 #endif
           }
+        else if (compressed)
+          {
+            GByteArray *message = inflate_input_message (input, data, payload_len);
+
+            if (message == NULL)
+              return FALSE;
+
+            parse_input_message (input, message->data);
+            g_byte_array_unref (message);
+          }
         else
           {
             parse_input_message (input, data);
@@ -856,6 +990,8 @@ parse_input (BroadwayInput *input)
 
       g_byte_array_remove_range (input->buffer, 0, data - buf + payload_len);
     }
+
+  return TRUE;
 }
 
 
@@ -900,13 +1036,7 @@ broadway_server_read_all_input_nonblocking (BroadwayInput *input)
           return TRUE;
         }
 
-      if (input->server->input == input)
-        {
-          send_outstanding_roundtrips (input->server);
-
-          input->server->input = NULL;
-        }
-      broadway_input_free (input);
+      broadway_input_close (input);
       if (res < 0)
         {
           g_printerr ("input error %s\n", error->message);
@@ -917,7 +1047,12 @@ broadway_server_read_all_input_nonblocking (BroadwayInput *input)
 
   g_byte_array_append (input->buffer, buffer, res);
 
-  parse_input (input);
+  if (!parse_input (input))
+    {
+      broadway_input_close (input);
+      return FALSE;
+    }
+
   return TRUE;
 }
 
@@ -1034,6 +1169,45 @@ parse_line (const char *line, const char *key)
   return p;
 }
 
+/* Whether one of the extension offers in a Sec-WebSocket-Extensions
+ * header is permessage-deflate (RFC 7692) with parameters we can
+ * honour. We always use the full window and keep the context across
+ * messages, so offers restricting either on our side are declined.
+ */
+static gboolean
+accept_permessage_deflate (const char *header)
+{
+  char **offers;
+  gboolean accept = FALSE;
+  int i;
+
+  offers = g_strsplit (header, ",", 0);
+  for (i = 0; offers[i] != NULL && !accept; i++)
+    {
+      char **params = g_strsplit (offers[i], ";", 0);
+      int j;
+
+      if (params[0] != NULL &&
+          strcmp (g_strstrip (params[0]), "permessage-deflate") == 0)
+        {
+          accept = TRUE;
+          for (j = 1; params[j] != NULL; j++)
+            {
+              const char *param = g_strstrip (params[j]);
+
+              if (g_str_has_prefix (param, "server_max_window_bits") ||
+                  g_str_has_prefix (param, "server_no_context_takeover"))
+                accept = FALSE;
+            }
+        }
+
+      g_strfreev (params);
+    }
+  g_strfreev (offers);
+
+  return accept;
+}
+
 static void
 send_error (HttpRequest *request,
             int error_code,
@@ -1095,6 +1269,7 @@ start_input (HttpRequest *request)
   gsize data_buffer_size;
   GInputStream *in;
   const char *key;
+  gboolean deflate;
   GSocket *socket;
   int flag = 1;
 
@@ -1106,10 +1281,13 @@ start_input (HttpRequest *request)
   key = NULL;
   origin = NULL;
   host = NULL;
+  deflate = FALSE;
   for (i = 0; lines[i] != NULL; i++)
     {
       if ((p = parse_line (lines[i], "Sec-WebSocket-Key")))
         key = p;
+      else if ((p = parse_line (lines[i], "Sec-WebSocket-Extensions")))
+        deflate = deflate || accept_permessage_deflate (p);
       else if ((p = parse_line (lines[i], "Origin")))
         origin = p;
       else if ((p = parse_line (lines[i], "Host")))
@@ -1135,9 +1313,11 @@ start_input (HttpRequest *request)
                              "%s%s%s"
                              "Sec-WebSocket-Location: ws://%s/socket\r\n"
                              "Sec-WebSocket-Protocol: broadway\r\n"
+                             "%s"
                              "\r\n", accept,
                              origin?"Sec-WebSocket-Origin: ":"", origin?origin:"", origin?"\r\n":"",
-                             host);
+                             host,
+                             deflate?"Sec-WebSocket-Extensions: permessage-deflate\r\n":"");
       g_free (accept);
 
 #ifdef DEBUG_WEBSOCKETS
@@ -1170,6 +1350,12 @@ start_input (HttpRequest *request)
   input->output =
     broadway_output_new (g_io_stream_get_output_stream (request->connection), 0);
 
+  if (deflate)
+    {
+      broadway_output_enable_deflate (input->output);
+      input->decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW));
+    }
+
   /* This will free and close the data input stream, but we got all the buffered content already */
   http_request_free (request);
 
@@ -1182,7 +1368,8 @@ start_input (HttpRequest *request)
   start (input);
 
   /* Process any data in the pipe already */
-  parse_input (input);
+  if (!parse_input (input))
+    broadway_input_close (input);
 
   g_strfreev (lines);
 }
@@ -1233,6 +1420,7 @@ start (BroadwayInput *input)
       broadway_output_free (server->output);
     }
   server->output = input->output;
+  broadway_output_set_drain_func (server->output, broadway_server_output_drained, server);
 
   broadway_output_set_next_serial (server->output, server->saved_serial);
   broadway_output_flush (server->output);
@@ -1862,6 +2050,93 @@ decode_nodes (BroadwayServer *server,
   return node;
 }
 
+/* Uploads the textures of @node and its children that the browser
+ * doesn't have yet. Subtrees the browser already got are skipped.
+ */
+static void
+broadway_server_upload_node_textures (BroadwayServer  *server,
+                                      BroadwaySurface *surface,
+                                      BroadwayNode    *node)
+{
+  int i;
+
+  if (g_hash_table_lookup (surface->sent_node_lookup, GINT_TO_POINTER (node->id)) == node)
+    return;
+
+  if (node->texture_id)
+    {
+      BroadwayTexture *texture;
+
+      texture = g_hash_table_lookup (server->textures, GINT_TO_POINTER (node->texture_id));
+      if (texture && !texture->uploaded)
+        {
+          broadway_output_upload_texture (server->output, texture->id, texture->bytes);
+          texture->uploaded = TRUE;
+        }
+    }
+
+  for (i = 0; i < node->n_children; i++)
+    broadway_server_upload_node_textures (server, surface, node->children[i]);
+}
+
+/* Sends the difference between the tree the browser has and the
+ * current one, after the textures it needs. While the output is
+ * congested, this is postponed until it drained, so intermediate
+ * trees, and textures only they use, are never sent.
+ */
+static void
+broadway_server_send_surface_nodes (BroadwayServer  *server,
+                                    BroadwaySurface *surface)
+{
+  if (broadway_output_is_congested (server->output))
+    {
+      surface->nodes_pending = TRUE;
+      return;
+    }
+
+  if (surface->nodes)
+    broadway_server_upload_node_textures (server, surface, surface->nodes);
+
+  broadway_output_surface_set_nodes (server->output, surface->id,
+                                     surface->nodes,
+                                     surface->sent_nodes,
+                                     surface->sent_node_lookup);
+  surface->nodes_pending = FALSE;
+
+  /* Keep the old tree alive until after the diff, as it
+   * shares nodes with the new one */
+  broadway_node_ref (surface->nodes);
+  if (surface->sent_nodes)
+    broadway_node_unref (server, surface->sent_nodes);
+  surface->sent_nodes = surface->nodes;
+
+  g_hash_table_remove_all (surface->sent_node_lookup);
+  broadway_node_add_to_lookup (surface->sent_nodes, surface->sent_node_lookup);
+}
+
+static void
+broadway_server_output_drained (BroadwayOutput *output,
+                                gpointer        user_data)
+{
+  BroadwayServer *server = user_data;
+  GList *l;
+
+  if (server->output != output)
+    return;
+
+  for (l = server->surfaces; l != NULL; l = l->next)
+    {
+      BroadwaySurface *surface = l->data;
+
+      if (surface->nodes_pending)
+        broadway_server_send_surface_nodes (server, surface);
+    }
+
+  /* Errors are noticed on the next broadway_server_flush(), the
+   * output can't be freed from inside its own callback */
+  broadway_output_flush (output);
+}
+
 /* passes ownership of nodes */
 void
 broadway_server_surface_update_nodes (BroadwayServer   *server,
@@ -1880,12 +2155,6 @@ broadway_server_surface_update_nodes (BroadwayServer   *server,
 
   root = decode_nodes (server, surface, len, data, client_texture_map, &pos);
 
-  if (server->output != NULL)
-    broadway_output_surface_set_nodes (server->output, surface->id,
-                                       root,
-                                       surface->nodes,
-                                       surface->node_lookup);
-
   if (surface->nodes)
     broadway_node_unref (server, surface->nodes);
 
@@ -1893,6 +2162,9 @@ broadway_server_surface_update_nodes (BroadwayServer   *server,
 
   g_hash_table_remove_all (surface->node_lookup);
   broadway_node_add_to_lookup (root, surface->node_lookup);
+
+  if (server->output != NULL)
+    broadway_server_send_surface_nodes (server, surface);
 }
 
 guint32
@@ -1901,6 +2173,16 @@ broadway_server_upload_texture (BroadwayServer   *server,
 {
   BroadwayTexture *texture;
 
+  /* Identical images, from any client, share a single texture in
+   * the browser, so they are only ever sent once.
+   */
+  texture = g_hash_table_lookup (server->textures_by_content, bytes);
+  if (texture)
+    {
+      g_ref_count_inc (&texture->refcount);
+      return texture->id;
+    }
+
   texture = g_new0 (BroadwayTexture, 1);
   g_ref_count_init (&texture->refcount);
   texture->id = ++server->next_texture_id;
@@ -1909,9 +2191,9 @@ broadway_server_upload_texture (BroadwayServer   *server,
   g_hash_table_replace (server->textures,
                         GINT_TO_POINTER (texture->id),
                         texture);
+  g_hash_table_insert (server->textures_by_content, texture->bytes, texture);
 
-  if (server->output)
-    broadway_output_upload_texture (server->output, texture->id, texture->bytes);
+  /* Sent with the first tree that uses it */
 
   return texture->id;
 }
@@ -1937,10 +2219,11 @@ broadway_server_release_texture (BroadwayServer   *server,
 
   if (texture && g_ref_count_dec (&texture->refcount))
     {
-      g_hash_table_remove (server->textures, GINT_TO_POINTER (id));
-
-      if (server->output)
+      if (server->output && texture->uploaded)
         broadway_output_release_texture (server->output, id);
+
+      g_hash_table_remove (server->textures_by_content, texture->bytes);
+      g_hash_table_remove (server->textures, GINT_TO_POINTER (id));
     }
 }
 
@@ -2086,6 +2369,7 @@ broadway_server_new_surface (BroadwayServer *server,
   surface->width = width;
   surface->height = height;
   surface->node_lookup = g_hash_table_new (g_direct_hash, g_direct_equal);
+  surface->sent_node_lookup = g_hash_table_new (g_direct_hash, g_direct_equal);
 
   g_hash_table_insert (server->surface_id_hash,
                        GINT_TO_POINTER (surface->id),
@@ -2110,23 +2394,22 @@ static void
 broadway_server_resync_surfaces (BroadwayServer *server)
 {
   GHashTableIter iter;
-  gpointer key, value;
+  gpointer value;
   GList *l;
 
   if (server->output == NULL)
     return;
 
-  /* First upload all textures */
+  /* The browser starts out without any textures, they are
+   * uploaded again with the trees using them */
   g_hash_table_iter_init (&iter, server->textures);
-  while (g_hash_table_iter_next (&iter, &key, &value))
+  while (g_hash_table_iter_next (&iter, NULL, &value))
     {
       BroadwayTexture *texture = value;
-      broadway_output_upload_texture (server->output,
-                                      GPOINTER_TO_INT (key),
-                                      texture->bytes);
+      texture->uploaded = FALSE;
     }
 
-  /* Then create all surfaces */
+  /* First create all surfaces */
   for (l = server->surfaces; l != NULL; l = l->next)
     {
       BroadwaySurface *surface = l->data;
@@ -2154,10 +2437,15 @@ broadway_server_resync_surfaces (BroadwayServer *server)
         broadway_output_set_transient_for (server->output, surface->id,
                                            surface->transient_for);
 
+      /* The browser starts out without any nodes */
+      if (surface->sent_nodes)
+        {
+          broadway_node_unref (server, surface->sent_nodes);
+          surface->sent_nodes = NULL;
+        }
+      g_hash_table_remove_all (surface->sent_node_lookup);
       if (surface->nodes)
-        broadway_output_surface_set_nodes (server->output, surface->id,
-                                           surface->nodes,
-                                           NULL, NULL);
+        broadway_server_send_surface_nodes (server, surface);
 
       if (surface->visible)
         broadway_output_show_surface (server->output, surface->id);
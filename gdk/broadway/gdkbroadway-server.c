@@ -14,6 +14,7 @@
 
 #include "gdkprivate-broadway.h"
 #include <gdk/gdktextureprivate.h>
+#include <gdk/gdkprofilerprivate.h>
 
 #include <glib.h>
 #include <glib/gprintf.h>
@@ -36,12 +37,38 @@
 
 typedef struct BroadwayInput BroadwayInput;
 
+typedef struct {
+  guint32 id;
+  int ref_count;
+  char *checksum;
+} UploadedTexture;
+
+typedef struct {
+  guint32 id;
+  cairo_surface_t *surface;
+  int fd;
+  gsize size;
+  gint64 start_time;
+  gint64 end_time;
+  gboolean done;
+} EncodeJob;
+
 struct _GdkBroadwayServer {
   GObject parent_instance;
   GdkDisplay *display;
 
   guint32 next_serial;
   guint32 next_texture_id;
+  GHashTable *textures;             /* id -> UploadedTexture */
+  GHashTable *textures_by_checksum; /* checksum of the pixels -> UploadedTexture */
+
+  /* Textures are encoded in worker threads, the jobs are kept in
+   * upload order and sent before any other request.
+   */
+  GThreadPool *encode_pool;
+  GQueue encode_jobs;
+  GMutex encode_mutex;
+  GCond encode_cond;
   GSocketConnection *connection;
 
   guint32 recv_buffer_size;
@@ -57,21 +84,52 @@ struct _GdkBroadwayServerClass
 };
 
 static gboolean input_available_cb (gpointer stream, gpointer user_data);
+static void gdk_broadway_server_send_encoded_textures (GdkBroadwayServer *server);
 
 static GType gdk_broadway_server_get_type (void);
 
 G_DEFINE_TYPE (GdkBroadwayServer, gdk_broadway_server, G_TYPE_OBJECT)
 
+static void
+uploaded_texture_free (UploadedTexture *texture)
+{
+  g_free (texture->checksum);
+  g_free (texture);
+}
+
 static void
 gdk_broadway_server_init (GdkBroadwayServer *server)
 {
   server->next_serial = 1;
   server->next_texture_id = 1;
+  server->textures = g_hash_table_new_full (NULL, NULL, NULL,
+                                            (GDestroyNotify)uploaded_texture_free);
+  server->textures_by_checksum = g_hash_table_new (g_str_hash, g_str_equal);
+  g_mutex_init (&server->encode_mutex);
+  g_cond_init (&server->encode_cond);
 }
 
 static void
 gdk_broadway_server_finalize (GObject *object)
 {
+  GdkBroadwayServer *server = GDK_BROADWAY_SERVER (object);
+
+  if (server->encode_pool)
+    g_thread_pool_free (server->encode_pool, FALSE, TRUE);
+  while (!g_queue_is_empty (&server->encode_jobs))
+    {
+      EncodeJob *job = g_queue_pop_head (&server->encode_jobs);
+
+      if (job->fd != -1)
+        close (job->fd);
+      g_free (job);
+    }
+  g_mutex_clear (&server->encode_mutex);
+  g_cond_clear (&server->encode_cond);
+
+  g_hash_table_destroy (server->textures_by_checksum);
+  g_hash_table_destroy (server->textures);
+
   G_OBJECT_CLASS (gdk_broadway_server_parent_class)->finalize (object);
 }
 
@@ -161,8 +219,8 @@ _gdk_broadway_server_new (GdkDisplay *display,
 }
 
 static guint32
-gdk_broadway_server_send_message_with_size (GdkBroadwayServer *server, BroadwayRequestBase *base,
-                                            gsize size, guint32 type, int fd)
+send_message_now (GdkBroadwayServer *server, BroadwayRequestBase *base,
+                  gsize size, guint32 type, int fd)
 {
   GOutputStream *out;
   gsize written;
@@ -223,12 +281,19 @@ gdk_broadway_server_send_message_with_size (GdkBroadwayServer *server, BroadwayR
   return base->serial;
 }
 
+static guint32
+gdk_broadway_server_send_message_with_size (GdkBroadwayServer *server, BroadwayRequestBase *base,
+                                            gsize size, guint32 type, int fd)
+{
+  /* Later requests may refer to textures that are still being encoded */
+  gdk_broadway_server_send_encoded_textures (server);
+
+  return send_message_now (server, base, size, type, fd);
+}
+
 #define gdk_broadway_server_send_message(_server, _msg, _type) \
   gdk_broadway_server_send_message_with_size(_server, (BroadwayRequestBase *)&_msg, sizeof (_msg), _type, -1)
 
-#define gdk_broadway_server_send_fd_message(_server, _msg, _type, _fd)      \
-  gdk_broadway_server_send_message_with_size(_server, (BroadwayRequestBase *)&_msg, sizeof (_msg), _type, _fd)
-
 static void
 parse_all_input (GdkBroadwayServer *server)
 {
@@ -607,58 +672,181 @@ open_shared_memory (void)
   return ret;
 }
 
-typedef struct {
-  int fd;
-  gsize size;
-} PngData;
-
-static cairo_status_t
-write_png_cb (void         *closure,
-              const guchar *data,
-              unsigned int  length)
+static gboolean
+write_png_cb (const char  *data,
+              gsize        length,
+              GError     **error,
+              gpointer     user_data)
 {
-  PngData *png_data = closure;
-  int fd = png_data->fd;
+  EncodeJob *job = user_data;
 
   while (length)
     {
-      gssize ret = write (fd, data, length);
+      gssize ret = write (job->fd, data, length);
 
       if (ret <= 0)
-        return CAIRO_STATUS_WRITE_ERROR;
+        return FALSE;
 
-      png_data->size += ret;
+      job->size += ret;
       length -= ret;
       data += ret;
     }
 
-  return CAIRO_STATUS_SUCCESS;
+  return TRUE;
+}
+
+/* Runs in a worker thread. The default zlib level that cairo uses
+ * for PNGs is slow, and the fastest one compresses UI content almost
+ * as well.
+ */
+static void
+encode_texture (gpointer data,
+                gpointer user_data)
+{
+  EncodeJob *job = data;
+  GdkBroadwayServer *server = user_data;
+  GdkPixbuf *pixbuf;
+
+  job->start_time = g_get_monotonic_time ();
+
+  pixbuf = gdk_pixbuf_get_from_surface (job->surface, 0, 0,
+                                        cairo_image_surface_get_width (job->surface),
+                                        cairo_image_surface_get_height (job->surface));
+  g_clear_pointer (&job->surface, cairo_surface_destroy);
+
+  if (pixbuf == NULL ||
+      !gdk_pixbuf_save_to_callback (pixbuf, write_png_cb, job, "png", NULL,
+                                    "compression", "1",
+                                    NULL))
+    g_warning ("Failed to encode texture %u", job->id);
+
+  g_clear_object (&pixbuf);
+
+  job->end_time = g_get_monotonic_time ();
+
+  g_mutex_lock (&server->encode_mutex);
+  job->done = TRUE;
+  g_cond_broadcast (&server->encode_cond);
+  g_mutex_unlock (&server->encode_mutex);
+}
+
+static void
+gdk_broadway_server_send_encoded_textures (GdkBroadwayServer *server)
+{
+  static guint time_counter, size_counter;
+
+  while (!g_queue_is_empty (&server->encode_jobs))
+    {
+      EncodeJob *job = g_queue_pop_head (&server->encode_jobs);
+      BroadwayRequestUploadTexture msg;
+
+      g_mutex_lock (&server->encode_mutex);
+      while (!job->done)
+        g_cond_wait (&server->encode_cond, &server->encode_mutex);
+      g_mutex_unlock (&server->encode_mutex);
+
+      if (GDK_PROFILER_IS_RUNNING)
+        {
+          if (time_counter == 0)
+            {
+              time_counter = gdk_profiler_define_int_counter ("broadway-encode-time",
+                                                              "Broadway Texture Encode Time (µs)");
+              size_counter = gdk_profiler_define_int_counter ("broadway-encode-bytes",
+                                                              "Broadway Texture Encoded Size");
+            }
+
+          gdk_profiler_add_markf (job->start_time, job->end_time - job->start_time,
+                                  "broadway", "encode texture %u, %" G_GSIZE_FORMAT " bytes",
+                                  job->id, job->size);
+          gdk_profiler_set_int_counter (time_counter, job->end_time, job->end_time - job->start_time);
+          gdk_profiler_set_int_counter (size_counter, job->end_time, job->size);
+        }
+
+      msg.id = job->id;
+      msg.offset = 0;
+      msg.size = job->size;
+
+      /* This passes ownership of fd */
+      send_message_now (server, (BroadwayRequestBase *) &msg, sizeof (msg),
+                        BROADWAY_REQUEST_UPLOAD_TEXTURE, job->fd);
+
+      g_free (job);
+    }
+}
+
+static char *
+compute_surface_checksum (cairo_surface_t *surface)
+{
+  GChecksum *checksum;
+  const guchar *data;
+  guint32 size[2];
+  int stride, y;
+  char *res;
+
+  cairo_surface_flush (surface);
+
+  size[0] = cairo_image_surface_get_width (surface);
+  size[1] = cairo_image_surface_get_height (surface);
+  data = cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) size, sizeof (size));
+  for (y = 0; y < size[1]; y++)
+    g_checksum_update (checksum, data + y * stride, size[0] * 4);
+
+  res = g_strdup (g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+
+  return res;
 }
 
 guint32
 gdk_broadway_server_upload_texture (GdkBroadwayServer *server,
                                     GdkTexture        *texture)
 {
-  guint32 id;
+  UploadedTexture *uploaded;
   cairo_surface_t *surface = gdk_texture_download_surface (texture);
-  BroadwayRequestUploadTexture msg;
-  PngData data;
-
-  id = server->next_texture_id++;
-
-  data.fd = open_shared_memory ();
-  data.size = 0;
-  cairo_surface_write_to_png_stream (surface, write_png_cb, &data);
-
-  msg.id = id;
-  msg.offset = 0;
-  msg.size = data.size;
+  EncodeJob *job;
+  char *checksum;
+
+  /* Textures with the same pixels are often created over and over,
+   * e.g. for icons or unchanged cairo fallback content, so reuse an
+   * upload with the same content instead of encoding it again.
+   */
+  checksum = compute_surface_checksum (surface);
+  uploaded = g_hash_table_lookup (server->textures_by_checksum, checksum);
+  if (uploaded)
+    {
+      uploaded->ref_count++;
+      g_free (checksum);
+      cairo_surface_destroy (surface);
+      return uploaded->id;
+    }
 
-  /* This passes ownership of fd */
-  gdk_broadway_server_send_fd_message (server, msg,
-                                       BROADWAY_REQUEST_UPLOAD_TEXTURE, data.fd);
+  uploaded = g_new0 (UploadedTexture, 1);
+  uploaded->id = server->next_texture_id++;
+  uploaded->ref_count = 1;
+  uploaded->checksum = checksum;
+  g_hash_table_insert (server->textures, GUINT_TO_POINTER (uploaded->id), uploaded);
+  g_hash_table_insert (server->textures_by_checksum, uploaded->checksum, uploaded);
+
+  /* The upload request is sent once the texture is encoded, at
+   * the latest before the next request that might refer to it.
+   */
+  job = g_new0 (EncodeJob, 1);
+  job->id = uploaded->id;
+  job->surface = surface;
+  job->fd = open_shared_memory ();
+  g_queue_push_tail (&server->encode_jobs, job);
+
+  if (server->encode_pool == NULL)
+    server->encode_pool = g_thread_pool_new (encode_texture, server,
+                                             g_get_num_processors (), FALSE,
+                                             NULL);
+  g_thread_pool_push (server->encode_pool, job, NULL);
 
-  return id;
+  return uploaded->id;
 }
 
 
@@ -667,6 +855,17 @@ gdk_broadway_server_release_texture (GdkBroadwayServer *server,
                                      guint32            id)
 {
   BroadwayRequestReleaseTexture msg;
+  UploadedTexture *uploaded;
+
+  uploaded = g_hash_table_lookup (server->textures, GUINT_TO_POINTER (id));
+  if (uploaded)
+    {
+      if (--uploaded->ref_count > 0)
+        return;
+
+      g_hash_table_remove (server->textures_by_checksum, uploaded->checksum);
+      g_hash_table_remove (server->textures, GUINT_TO_POINTER (id));
+    }
 
   msg.id = id;
 
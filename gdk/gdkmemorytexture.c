@@ -21,6 +21,8 @@
 
 #include "gdkmemorytextureprivate.h"
 
+#include "gdkparalleltaskprivate.h"
+
 struct _GdkMemoryTexture
 {
   GdkTexture parent_instance;
@@ -287,6 +289,290 @@ static ConversionFunc converters[GDK_MEMORY_N_FORMATS][2] =
   { convert_swizzle_opaque_3012, convert_swizzle_opaque_0321 }
 };
 
+#define NO_CHANNEL 0x80
+
+/* Byte offsets of the alpha, red, green and blue channels
+ * inside a pixel, used to set up the vectorized converters.
+ */
+typedef struct {
+  guchar a, r, g, b;
+  guchar bpp;
+  guchar premultiply;
+} PixelLayout;
+
+static const PixelLayout layouts[GDK_MEMORY_N_FORMATS] = {
+  { 3, 2, 1, 0, 4, FALSE },
+  { 0, 1, 2, 3, 4, FALSE },
+  { 3, 2, 1, 0, 4, TRUE },
+  { 0, 1, 2, 3, 4, TRUE },
+  { 3, 0, 1, 2, 4, TRUE },
+  { 0, 3, 2, 1, 4, TRUE },
+  { NO_CHANNEL, 0, 1, 2, 3, FALSE },
+  { NO_CHANNEL, 2, 1, 0, 3, FALSE },
+};
+
+/* Masks for converting 4 pixels at once with a byte shuffle:
+ * @shuffle picks the source byte for every destination byte,
+ * @fill is or'ed in afterwards to make opaque formats opaque
+ * and @alpha has the alpha channel of every destination byte.
+ * @alpha_mask selects the alpha bytes that must not be premultiplied.
+ */
+typedef struct {
+  guchar shuffle[16];
+  guchar fill[16];
+  guchar alpha[16];
+  guchar alpha_mask[16];
+  gsize src_bpp;
+  gboolean premultiply;
+} ShuffleMasks;
+
+static void
+shuffle_masks_init (ShuffleMasks    *masks,
+                    GdkMemoryFormat  dest_format,
+                    GdkMemoryFormat  src_format)
+{
+  const PixelLayout *dest = &layouts[dest_format];
+  const PixelLayout *src = &layouts[src_format];
+  guint i;
+
+  memset (masks->fill, 0, sizeof (masks->fill));
+  memset (masks->alpha_mask, 0, sizeof (masks->alpha_mask));
+
+  for (i = 0; i < 4; i++)
+    {
+      guchar *shuffle = &masks->shuffle[4 * i];
+      guchar *alpha = &masks->alpha[4 * i];
+
+      if (src->a == NO_CHANNEL)
+        {
+          shuffle[dest->a] = NO_CHANNEL;
+          masks->fill[4 * i + dest->a] = 0xFF;
+        }
+      else
+        shuffle[dest->a] = src->bpp * i + src->a;
+      shuffle[dest->r] = src->bpp * i + src->r;
+      shuffle[dest->g] = src->bpp * i + src->g;
+      shuffle[dest->b] = src->bpp * i + src->b;
+
+      alpha[0] = alpha[1] = alpha[2] = alpha[3] = 4 * i + dest->a;
+      masks->alpha_mask[4 * i + dest->a] = 0xFF;
+    }
+
+  masks->src_bpp = src->bpp;
+  masks->premultiply = src->premultiply;
+}
+
+typedef void (* VectorConversionFunc) (guchar             *dest_data,
+                                       const guchar       *src_data,
+                                       gsize               n_pixels,
+                                       const ShuffleMasks *masks);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <tmmintrin.h>
+
+#define HAVE_SSSE3_CONVERT 1
+
+__attribute__((target("ssse3")))
+static void
+convert_row_ssse3 (guchar             *dest_data,
+                   const guchar       *src_data,
+                   gsize               n_pixels,
+                   const ShuffleMasks *masks)
+{
+  const __m128i shuffle = _mm_loadu_si128 ((const __m128i *) masks->shuffle);
+  const __m128i fill = _mm_loadu_si128 ((const __m128i *) masks->fill);
+  const __m128i alpha_shuffle = _mm_loadu_si128 ((const __m128i *) masks->alpha);
+  const __m128i alpha_mask = _mm_loadu_si128 ((const __m128i *) masks->alpha_mask);
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i half = _mm_set1_epi16 (0x80);
+  gsize x;
+
+  for (x = 0; x < n_pixels; x += 4)
+    {
+      __m128i pixels;
+
+      pixels = _mm_loadu_si128 ((const __m128i *) (src_data + x * masks->src_bpp));
+      pixels = _mm_or_si128 (_mm_shuffle_epi8 (pixels, shuffle), fill);
+
+      if (masks->premultiply)
+        {
+          __m128i alpha, lo, hi;
+
+          alpha = _mm_shuffle_epi8 (pixels, alpha_shuffle);
+
+          lo = _mm_mullo_epi16 (_mm_unpacklo_epi8 (pixels, zero), _mm_unpacklo_epi8 (alpha, zero));
+          hi = _mm_mullo_epi16 (_mm_unpackhi_epi8 (pixels, zero), _mm_unpackhi_epi8 (alpha, zero));
+          /* Same rounding as PREMULTIPLY() */
+          lo = _mm_add_epi16 (lo, half);
+          hi = _mm_add_epi16 (hi, half);
+          lo = _mm_srli_epi16 (_mm_add_epi16 (lo, _mm_srli_epi16 (lo, 8)), 8);
+          hi = _mm_srli_epi16 (_mm_add_epi16 (hi, _mm_srli_epi16 (hi, 8)), 8);
+
+          pixels = _mm_or_si128 (_mm_and_si128 (alpha_mask, pixels),
+                                 _mm_andnot_si128 (alpha_mask, _mm_packus_epi16 (lo, hi)));
+        }
+
+      _mm_storeu_si128 ((__m128i *) (dest_data + 4 * x), pixels);
+    }
+}
+
+#elif defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#define HAVE_NEON_CONVERT 1
+
+static void
+convert_row_neon (guchar             *dest_data,
+                  const guchar       *src_data,
+                  gsize               n_pixels,
+                  const ShuffleMasks *masks)
+{
+  const uint8x16_t shuffle = vld1q_u8 (masks->shuffle);
+  const uint8x16_t fill = vld1q_u8 (masks->fill);
+  const uint8x16_t alpha_shuffle = vld1q_u8 (masks->alpha);
+  const uint8x16_t alpha_mask = vld1q_u8 (masks->alpha_mask);
+  const uint16x8_t half = vdupq_n_u16 (0x80);
+  gsize x;
+
+  for (x = 0; x < n_pixels; x += 4)
+    {
+      uint8x16_t pixels;
+
+      pixels = vld1q_u8 (src_data + x * masks->src_bpp);
+      pixels = vorrq_u8 (vqtbl1q_u8 (pixels, shuffle), fill);
+
+      if (masks->premultiply)
+        {
+          uint8x16_t alpha;
+          uint16x8_t lo, hi;
+
+          alpha = vqtbl1q_u8 (pixels, alpha_shuffle);
+
+          lo = vaddq_u16 (vmull_u8 (vget_low_u8 (pixels), vget_low_u8 (alpha)), half);
+          hi = vaddq_u16 (vmull_high_u8 (pixels, alpha), half);
+          /* Same rounding as PREMULTIPLY() */
+          lo = vaddq_u16 (lo, vshrq_n_u16 (lo, 8));
+          hi = vaddq_u16 (hi, vshrq_n_u16 (hi, 8));
+
+          pixels = vbslq_u8 (alpha_mask,
+                             pixels,
+                             vcombine_u8 (vshrn_n_u16 (lo, 8), vshrn_n_u16 (hi, 8)));
+        }
+
+      vst1q_u8 (dest_data + 4 * x, pixels);
+    }
+}
+
+#endif
+
+static VectorConversionFunc
+get_vector_converter (void)
+{
+  static VectorConversionFunc func;
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+#if defined(HAVE_SSSE3_CONVERT)
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("ssse3"))
+        func = convert_row_ssse3;
+#elif defined(HAVE_NEON_CONVERT)
+      func = convert_row_neon;
+#endif
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return func;
+}
+
+static void
+convert_rows (guchar          *dest_data,
+              gsize            dest_stride,
+              GdkMemoryFormat  dest_format,
+              const guchar    *src_data,
+              gsize            src_stride,
+              GdkMemoryFormat  src_format,
+              gsize            width,
+              gsize            height)
+{
+  VectorConversionFunc vector_func;
+  ShuffleMasks masks;
+  gsize y, n_vector;
+
+  vector_func = get_vector_converter ();
+  if (vector_func == NULL || src_format == dest_format || width < 8)
+    {
+      converters[src_format][dest_format] (dest_data, dest_stride, src_data, src_stride, width, height);
+      return;
+    }
+
+  shuffle_masks_init (&masks, dest_format, src_format);
+
+  /* The vector converters load 16 bytes at a time, make sure
+   * they don't read past the end of the row.
+   */
+  if (masks.src_bpp == 3)
+    n_vector = (width - 2) & ~3;
+  else
+    n_vector = width & ~3;
+
+  for (y = 0; y < height; y++)
+    {
+      vector_func (dest_data, src_data, n_vector, &masks);
+
+      if (n_vector < width)
+        converters[src_format][dest_format] (dest_data + 4 * n_vector, dest_stride,
+                                             src_data + masks.src_bpp * n_vector, src_stride,
+                                             width - n_vector, 1);
+
+      dest_data += dest_stride;
+      src_data += src_stride;
+    }
+}
+
+/* Conversions of more pixels than this are split across threads */
+#define PARALLEL_CONVERSION_PIXELS (512 * 512)
+#define PARALLEL_CONVERSION_CHUNK_PIXELS (64 * 1024)
+
+typedef struct {
+  guchar *dest_data;
+  gsize dest_stride;
+  GdkMemoryFormat dest_format;
+  const guchar *src_data;
+  gsize src_stride;
+  GdkMemoryFormat src_format;
+  gsize width;
+  gsize height;
+  gsize rows_per_chunk;
+  int next_chunk;
+} ConversionTask;
+
+static void
+gdk_memory_convert_task (gpointer data)
+{
+  ConversionTask *task = data;
+  gsize y, n_rows;
+
+  for (y = g_atomic_int_add (&task->next_chunk, 1) * task->rows_per_chunk;
+       y < task->height;
+       y = g_atomic_int_add (&task->next_chunk, 1) * task->rows_per_chunk)
+    {
+      n_rows = MIN (task->rows_per_chunk, task->height - y);
+
+      convert_rows (task->dest_data + y * task->dest_stride,
+                    task->dest_stride,
+                    task->dest_format,
+                    task->src_data + y * task->src_stride,
+                    task->src_stride,
+                    task->src_format,
+                    task->width,
+                    n_rows);
+    }
+}
+
 void
 gdk_memory_convert (guchar          *dest_data,
                     gsize            dest_stride,
@@ -297,8 +583,32 @@ gdk_memory_convert (guchar          *dest_data,
                     gsize            width,
                     gsize            height)
 {
+  ConversionTask task;
+  gsize n_chunks;
+
   g_assert (dest_format < 2);
   g_assert (src_format < GDK_MEMORY_N_FORMATS);
 
-  converters[src_format][dest_format] (dest_data, dest_stride, src_data, src_stride, width, height);
+  if (width * height < PARALLEL_CONVERSION_PIXELS)
+    {
+      convert_rows (dest_data, dest_stride, dest_format,
+                    src_data, src_stride, src_format,
+                    width, height);
+      return;
+    }
+
+  task.dest_data = dest_data;
+  task.dest_stride = dest_stride;
+  task.dest_format = dest_format;
+  task.src_data = src_data;
+  task.src_stride = src_stride;
+  task.src_format = src_format;
+  task.width = width;
+  task.height = height;
+  task.rows_per_chunk = MAX (1, PARALLEL_CONVERSION_CHUNK_PIXELS / width);
+  task.next_chunk = 0;
+
+  n_chunks = (height + task.rows_per_chunk - 1) / task.rows_per_chunk;
+
+  gdk_parallel_task_run (gdk_memory_convert_task, &task, n_chunks);
 }
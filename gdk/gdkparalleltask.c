@@ -0,0 +1,94 @@
+/*
+ * Copyright © 2020 GNOME Foundation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkparalleltaskprivate.h"
+
+typedef struct _TaskData TaskData;
+
+struct _TaskData
+{
+  GdkTaskFunc task_func;
+  gpointer task_data;
+  int n_running_tasks;
+};
+
+static void
+gdk_parallel_task_thread_func (gpointer data,
+                               gpointer unused)
+{
+  TaskData *task = data;
+
+  task->task_func (task->task_data);
+
+  g_atomic_int_dec_and_test (&task->n_running_tasks);
+}
+
+/*< private >
+ * gdk_parallel_task_run:
+ * @task_func: the function to run
+ * @task_data: data to pass to @task_func
+ * @max_tasks: the maximum number of times to run @task_func
+ *
+ * Runs @task_func in up to @max_tasks threads in parallel, including
+ * the calling one, and waits until all of them have returned.
+ *
+ * @task_func must split up the work by itself, usually by using an
+ * atomic counter in @task_data. There is no guarantee that more than
+ * one thread is used, so every invocation must be prepared to do all
+ * of the work.
+ */
+void
+gdk_parallel_task_run (GdkTaskFunc task_func,
+                       gpointer    task_data,
+                       guint       max_tasks)
+{
+  static GThreadPool *pool;
+  TaskData task = {
+    .task_func = task_func,
+    .task_data = task_data,
+  };
+  guint i, n_tasks;
+
+  n_tasks = MIN (max_tasks, g_get_num_processors ());
+  if (n_tasks <= 1)
+    {
+      task_func (task_data);
+      return;
+    }
+
+  if (g_once_init_enter (&pool))
+    {
+      GThreadPool *the_pool = g_thread_pool_new (gdk_parallel_task_thread_func,
+                                                 NULL,
+                                                 MAX (2, g_get_num_processors ()) - 1,
+                                                 FALSE,
+                                                 NULL);
+      g_once_init_leave (&pool, the_pool);
+    }
+
+  task.n_running_tasks = n_tasks;
+
+  for (i = 1; i < n_tasks; i++)
+    g_thread_pool_push (pool, &task, NULL);
+
+  gdk_parallel_task_thread_func (&task, NULL);
+
+  while (g_atomic_int_get (&task.n_running_tasks) > 0)
+    g_thread_yield ();
+}
@@ -24,6 +24,11 @@ struct _GskBroadwayRenderer
   /* Kept from last frame */
   GHashTable *last_node_lookup;
   GskRenderNode *last_root; /* Owning refs to the things in last_node_lookup */
+
+  /* Tiles of large images, see add_tiled_surface() */
+  GHashTable *tiles;          /* render node => GPtrArray of Tile */
+  GHashTable *last_tiles;     /* Kept from last frame, like tiles */
+  GHashTable *last_tile_positions; /* TileKey => Tile in last_tiles */
 };
 
 struct _GskBroadwayRendererClass
@@ -57,6 +62,8 @@ gsk_broadway_renderer_unrealize (GskRenderer *renderer)
 {
   GskBroadwayRenderer *self = GSK_BROADWAY_RENDERER (renderer);
   g_clear_object (&self->draw_context);
+  g_clear_pointer (&self->last_tile_positions, g_hash_table_unref);
+  g_clear_pointer (&self->last_tiles, g_hash_table_unref);
 }
 
 static GdkTexture *
@@ -203,6 +210,24 @@ static void
 collect_reused_child_nodes (GskRenderer *renderer,
                             GskRenderNode *node);
 
+/* The tiles of a reused node are still shown, so keep them */
+static void
+carry_over_tiles (GskBroadwayRenderer *self,
+                  GskRenderNode       *node)
+{
+  GPtrArray *tiles;
+
+  if (self->last_tiles == NULL)
+    return;
+
+  tiles = g_hash_table_lookup (self->last_tiles, node);
+  if (tiles == NULL)
+    return;
+
+  g_hash_table_steal (self->last_tiles, node);
+  g_hash_table_insert (self->tiles, node, tiles);
+}
+
 static void
 collect_reused_node (GskRenderer *renderer,
                      GskRenderNode *node)
@@ -214,6 +239,7 @@ collect_reused_node (GskRenderer *renderer,
       (old_id = GPOINTER_TO_INT(g_hash_table_lookup (self->last_node_lookup, node))) != 0)
     {
       g_hash_table_insert (self->node_lookup, node, GINT_TO_POINTER (old_id));
+      carry_over_tiles (self, node);
       collect_reused_child_nodes (renderer, node);
     }
 }
@@ -313,6 +339,7 @@ add_new_node (GskRenderer *renderer,
       add_uint32 (self->nodes, old_id);
 
       g_hash_table_insert (self->node_lookup, node, GINT_TO_POINTER(old_id));
+      carry_over_tiles (self, node);
       collect_reused_child_nodes (renderer, node);
 
       return FALSE;
@@ -466,6 +493,192 @@ get_colorized_texture (GdkTexture *texture,
 }
 
 
+/* Images larger than this in either direction are sent as a container
+ * of tiles. When only a part of a cairo node or fallback changes, as
+ * with a blinking cursor in a large drawing area, only the changed
+ * tiles get a new texture. broadwayd then just patches the texture of
+ * those tile nodes in the browser, and the unchanged tiles are not
+ * sent again.
+ *
+ * Tiles are kept per render node, for as long as the node is part of
+ * the tree. A new node is compared against the tiles that were at the
+ * same position in the last frame.
+ */
+#define TILE_SIZE 128
+
+typedef struct {
+  float x, y, width, height;
+} TileKey;
+
+typedef struct {
+  TileKey key;
+  cairo_surface_t *surface;
+  GdkTexture *texture;
+} Tile;
+
+static guint
+tile_hash (gconstpointer data)
+{
+  const TileKey *key = data;
+
+  return (guint) (int) key->x ^ ((guint) (int) key->y << 16) ^
+         ((guint) (int) key->width << 8) ^ ((guint) (int) key->height << 24);
+}
+
+static gboolean
+tile_equal (gconstpointer data1,
+            gconstpointer data2)
+{
+  return memcmp (data1, data2, sizeof (TileKey)) == 0;
+}
+
+static void
+tile_free (Tile *tile)
+{
+  cairo_surface_destroy (tile->surface);
+  g_object_unref (tile->texture);
+  g_free (tile);
+}
+
+/* Tiles are only placed at whole CSS pixels, so they must map
+ * one to one to device pixels, see add_tiled_surface().
+ */
+static gboolean
+should_tile_surface (cairo_surface_t       *surface,
+                     const graphene_rect_t *bounds,
+                     int                    scale)
+{
+  int width, height;
+
+  if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE ||
+      cairo_image_surface_get_format (surface) != CAIRO_FORMAT_ARGB32)
+    return FALSE;
+
+  width = cairo_image_surface_get_width (surface);
+  height = cairo_image_surface_get_height (surface);
+
+  return (width > TILE_SIZE || height > TILE_SIZE) &&
+         width == bounds->size.width * scale &&
+         height == bounds->size.height * scale;
+}
+
+static Tile *
+get_tile (GskBroadwayRenderer *self,
+          const TileKey       *key,
+          cairo_surface_t     *surface,
+          int                  tile_x,
+          int                  tile_y,
+          int                  tile_width,
+          int                  tile_height)
+{
+  const guchar *src_data, *src;
+  guchar *dst_data;
+  int src_stride, dst_stride;
+  Tile *tile, *last_tile;
+  int y;
+
+  src_data = cairo_image_surface_get_data (surface);
+  src_stride = cairo_image_surface_get_stride (surface);
+
+  tile = g_new0 (Tile, 1);
+  tile->key = *key;
+
+  /* Reuse the texture of the last frame if the pixels are the same */
+  last_tile = self->last_tile_positions ? g_hash_table_lookup (self->last_tile_positions, key) : NULL;
+  if (last_tile &&
+      cairo_image_surface_get_width (last_tile->surface) == tile_width &&
+      cairo_image_surface_get_height (last_tile->surface) == tile_height)
+    {
+      dst_data = cairo_image_surface_get_data (last_tile->surface);
+      dst_stride = cairo_image_surface_get_stride (last_tile->surface);
+
+      for (y = 0; y < tile_height; y++)
+        {
+          src = src_data + (tile_y + y) * src_stride + tile_x * 4;
+          if (memcmp (src, dst_data + y * dst_stride, tile_width * 4) != 0)
+            break;
+        }
+
+      if (y == tile_height)
+        {
+          tile->surface = cairo_surface_reference (last_tile->surface);
+          tile->texture = g_object_ref (last_tile->texture);
+          return tile;
+        }
+    }
+
+  tile->surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, tile_width, tile_height);
+  dst_data = cairo_image_surface_get_data (tile->surface);
+  dst_stride = cairo_image_surface_get_stride (tile->surface);
+  for (y = 0; y < tile_height; y++)
+    memcpy (dst_data + y * dst_stride,
+            src_data + (tile_y + y) * src_stride + tile_x * 4,
+            tile_width * 4);
+  cairo_surface_mark_dirty (tile->surface);
+  tile->texture = gdk_texture_new_for_surface (tile->surface);
+
+  return tile;
+}
+
+/* Adds the children of a container node showing @surface for @node,
+ * at the given parent-relative position. @surface must be an ARGB32
+ * image with @scale device pixels per CSS pixel. Tiles are a whole
+ * number of CSS pixels wide, so their edges don't fall between pixels
+ * and no seams show between them.
+ */
+static void
+add_tiled_surface (GskRenderer     *renderer,
+                   GskRenderNode   *node,
+                   cairo_surface_t *surface,
+                   float            x,
+                   float            y,
+                   int              scale)
+{
+  GskBroadwayRenderer *self = GSK_BROADWAY_RENDERER (renderer);
+  GdkDisplay *display = gdk_surface_get_display (gsk_renderer_get_surface (renderer));
+  int surface_width = cairo_image_surface_get_width (surface);
+  int surface_height = cairo_image_surface_get_height (surface);
+  int tile_size = MAX (TILE_SIZE / scale, 1) * scale;
+  GPtrArray *tiles;
+  int tile_x, tile_y;
+
+  cairo_surface_flush (surface);
+
+  tiles = g_ptr_array_new_with_free_func ((GDestroyNotify) tile_free);
+
+  add_uint32 (self->nodes, ((surface_width + tile_size - 1) / tile_size) *
+                           ((surface_height + tile_size - 1) / tile_size));
+
+  for (tile_y = 0; tile_y < surface_height; tile_y += tile_size)
+    for (tile_x = 0; tile_x < surface_width; tile_x += tile_size)
+      {
+        int tile_width = MIN (tile_size, surface_width - tile_x);
+        int tile_height = MIN (tile_size, surface_height - tile_y);
+        Tile *tile;
+        TileKey key;
+
+        key.x = x + tile_x / scale;
+        key.y = y + tile_y / scale;
+        key.width = (float) tile_width / scale;
+        key.height = (float) tile_height / scale;
+
+        tile = get_tile (self, &key, surface,
+                         tile_x, tile_y, tile_width, tile_height);
+        g_ptr_array_add (tiles, tile);
+        g_ptr_array_add (self->node_textures, g_object_ref (tile->texture));
+
+        add_uint32 (self->nodes, BROADWAY_NODE_TEXTURE);
+        add_uint32 (self->nodes, ++self->next_node_id);
+        add_float (self->nodes, key.x);
+        add_float (self->nodes, key.y);
+        add_float (self->nodes, key.width);
+        add_float (self->nodes, key.height);
+        add_uint32 (self->nodes, gdk_broadway_display_ensure_texture (display, tile->texture));
+      }
+
+  g_hash_table_insert (self->tiles, node, tiles);
+}
+
 /* Note: This tracks the offset so that we can convert
    the absolute coordinates of the GskRenderNodes to
    parent-relative which is what the dom uses, and
@@ -505,6 +718,20 @@ gsk_broadway_renderer_add_node (GskRenderer *renderer,
       return;
 
     case GSK_CAIRO_NODE:
+      {
+        cairo_surface_t *surface = gsk_cairo_node_peek_surface (node);
+
+        if (surface != NULL &&
+            should_tile_surface (surface, &node->bounds, broadway_display->scale_factor))
+          {
+            if (add_new_node (renderer, node, BROADWAY_NODE_CONTAINER))
+              add_tiled_surface (renderer, node, surface,
+                                 node->bounds.origin.x - offset_x,
+                                 node->bounds.origin.y - offset_y,
+                                 broadway_display->scale_factor);
+            return;
+          }
+      }
       if (add_new_node (renderer, node, BROADWAY_NODE_TEXTURE))
         {
           cairo_surface_t *surface = gsk_cairo_node_peek_surface (node);
@@ -744,42 +971,58 @@ gsk_broadway_renderer_add_node (GskRenderer *renderer,
       break; /* Fallback */
     }
 
-  if (add_new_node (renderer, node, BROADWAY_NODE_TEXTURE))
-    {
-      GdkTexture *texture;
-      cairo_surface_t *surface;
-      cairo_t *cr;
-      guint32 texture_id;
-      int x = floorf (node->bounds.origin.x);
-      int y = floorf (node->bounds.origin.y);
-      int width = ceil (node->bounds.origin.x + node->bounds.size.width) - x;
-      int height = ceil (node->bounds.origin.y + node->bounds.size.height) - y;
-      int scale = broadway_display->scale_factor;
+  {
+    int x = floorf (node->bounds.origin.x);
+    int y = floorf (node->bounds.origin.y);
+    int width = ceil (node->bounds.origin.x + node->bounds.size.width) - x;
+    int height = ceil (node->bounds.origin.y + node->bounds.size.height) - y;
+    int scale = broadway_display->scale_factor;
+    gboolean tiled;
 
 #define MAX_IMAGE_SIZE 32767
 
-      surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-                                            MIN (width * scale, MAX_IMAGE_SIZE),
-                                            MIN (height * scale, MAX_IMAGE_SIZE));
+    /* Clamped images are stretched, so they can't be tiled */
+    tiled = (width * scale > TILE_SIZE || height * scale > TILE_SIZE) &&
+            width * scale <= MAX_IMAGE_SIZE && height * scale <= MAX_IMAGE_SIZE;
+
+    if (add_new_node (renderer, node, tiled ? BROADWAY_NODE_CONTAINER : BROADWAY_NODE_TEXTURE))
+      {
+        GdkTexture *texture;
+        cairo_surface_t *surface;
+        cairo_t *cr;
+        guint32 texture_id;
+
+        surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                              MIN (width * scale, MAX_IMAGE_SIZE),
+                                              MIN (height * scale, MAX_IMAGE_SIZE));
 
 #undef MAX_IMAGE_SIZE
 
-      cr = cairo_create (surface);
-      cairo_scale (cr, scale, scale);
-      cairo_translate (cr, -x, -y);
-      gsk_render_node_draw (node, cr);
-      cairo_destroy (cr);
-
-      texture = gdk_texture_new_for_surface (surface);
-      g_ptr_array_add (self->node_textures, texture); /* Transfers ownership to node_textures */
-
-      texture_id = gdk_broadway_display_ensure_texture (display, texture);
-      add_float (nodes, x - offset_x);
-      add_float (nodes, y - offset_y);
-      add_float (nodes, width);
-      add_float (nodes, height);
-      add_uint32 (nodes, texture_id);
-    }
+        cr = cairo_create (surface);
+        cairo_scale (cr, scale, scale);
+        cairo_translate (cr, -x, -y);
+        gsk_render_node_draw (node, cr);
+        cairo_destroy (cr);
+
+        if (tiled)
+          {
+            add_tiled_surface (renderer, node, surface,
+                               x - offset_x, y - offset_y, scale);
+            cairo_surface_destroy (surface);
+            return;
+          }
+
+        texture = gdk_texture_new_for_surface (surface);
+        g_ptr_array_add (self->node_textures, texture); /* Transfers ownership to node_textures */
+
+        texture_id = gdk_broadway_display_ensure_texture (display, texture);
+        add_float (nodes, x - offset_x);
+        add_float (nodes, y - offset_y);
+        add_float (nodes, width);
+        add_float (nodes, height);
+        add_uint32 (nodes, texture_id);
+      }
+  }
 }
 
 static void
@@ -790,6 +1033,8 @@ gsk_broadway_renderer_render (GskRenderer          *renderer,
   GskBroadwayRenderer *self = GSK_BROADWAY_RENDERER (renderer);
 
   self->node_lookup = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->tiles = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                       NULL, (GDestroyNotify) g_ptr_array_unref);
 
   gdk_draw_context_begin_frame (GDK_DRAW_CONTEXT (self->draw_context), update_area);
 
@@ -814,6 +1059,33 @@ gsk_broadway_renderer_render (GskRenderer          *renderer,
     gsk_render_node_unref (self->last_root);
   self->last_root = gsk_render_node_ref (root);
 
+  /* Tiles of nodes that left the tree are dropped */
+  g_clear_pointer (&self->last_tile_positions, g_hash_table_unref);
+  if (self->last_tiles)
+    g_hash_table_unref (self->last_tiles);
+  self->last_tiles = self->tiles;
+  self->tiles = NULL;
+
+  if (g_hash_table_size (self->last_tiles) > 0)
+    {
+      GHashTableIter iter;
+      GPtrArray *tiles;
+      guint i;
+
+      self->last_tile_positions = g_hash_table_new (tile_hash, tile_equal);
+
+      g_hash_table_iter_init (&iter, self->last_tiles);
+      while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tiles))
+        {
+          for (i = 0; i < tiles->len; i++)
+            {
+              Tile *tile = g_ptr_array_index (tiles, i);
+
+              g_hash_table_replace (self->last_tile_positions, &tile->key, tile);
+            }
+        }
+    }
+
   if (self->next_node_id > G_MAXUINT32 / 2)
     {
       /* We're "near" a wrap of the ids, lets avoid reusing any of
@@ -211,6 +211,17 @@ gsk_gl_driver_in_frame (GskGLDriver *self)
   return self->in_frame;
 }
 
+/* Only counted in debug builds */
+gint64
+gsk_gl_driver_get_n_uploads (GskGLDriver *self)
+{
+#ifdef G_ENABLE_DEBUG
+  return gsk_profiler_counter_get (self->profiler, self->counters.surface_uploads);
+#else
+  return 0;
+#endif
+}
+
 void
 gsk_gl_driver_end_frame (GskGLDriver *self)
 {
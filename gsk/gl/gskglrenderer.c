@@ -448,8 +448,11 @@ struct _GskGLRenderer
 #ifdef G_ENABLE_DEBUG
   struct {
     GQuark frames;
+    GQuark draw_calls;
+    GQuark texture_uploads;
   } profile_counters;
   struct {
+    GQuark ops_time;
     GQuark cpu_time;
     GQuark gpu_time;
   } profile_timers;
@@ -3588,6 +3591,10 @@ gsk_gl_renderer_render_ops (GskGLRenderer *self)
             OP_PRINT (" -> draw %ld, size %ld and program %d\n",
                       op->vao_offset, op->vao_size, program->index);
             glDrawArrays (GL_TRIANGLES, op->vao_offset, op->vao_size);
+#ifdef G_ENABLE_DEBUG
+            gsk_profiler_counter_inc (gsk_renderer_get_profiler (GSK_RENDERER (self)),
+                                      self->profile_counters.draw_calls);
+#endif
             break;
           }
 
@@ -3635,7 +3642,7 @@ gsk_gl_renderer_do_render (GskRenderer           *renderer,
   graphene_matrix_t projection;
 #ifdef G_ENABLE_DEBUG
   GskProfiler *profiler;
-  gint64 gpu_time, cpu_time, start_time;
+  gint64 gpu_time, cpu_time, ops_time, start_time;
 #endif
   GPtrArray *removed;
 
@@ -3651,6 +3658,11 @@ gsk_gl_renderer_do_render (GskRenderer           *renderer,
 
   g_assert (gsk_gl_driver_in_frame (self->gl_driver));
 
+#ifdef G_ENABLE_DEBUG
+  gsk_profiler_counter_set (profiler, self->profile_counters.draw_calls, 0);
+  gsk_profiler_timer_begin (profiler, self->profile_timers.ops_time);
+#endif
+
   /* Set up the modelview and projection matrices to fit our viewport */
   graphene_matrix_init_ortho (&projection,
                               viewport->origin.x,
@@ -3716,6 +3728,11 @@ gsk_gl_renderer_do_render (GskRenderer           *renderer,
 
   /*g_message ("Ops: %u", self->render_ops->len);*/
 
+#ifdef G_ENABLE_DEBUG
+  ops_time = gsk_profiler_timer_end (profiler, self->profile_timers.ops_time);
+  gsk_profiler_timer_set (profiler, self->profile_timers.ops_time, ops_time);
+#endif
+
   /* Now actually draw things... */
 #ifdef G_ENABLE_DEBUG
   gsk_gl_profiler_begin_gpu_region (self->gl_profiler);
@@ -3744,6 +3761,8 @@ gsk_gl_renderer_do_render (GskRenderer           *renderer,
 
 #ifdef G_ENABLE_DEBUG
   gsk_profiler_counter_inc (profiler, self->profile_counters.frames);
+  gsk_profiler_counter_set (profiler, self->profile_counters.texture_uploads,
+                            gsk_gl_driver_get_n_uploads (self->gl_driver));
 
   start_time = gsk_profiler_timer_get_start (profiler, self->profile_timers.cpu_time);
   cpu_time = gsk_profiler_timer_end (profiler, self->profile_timers.cpu_time);
@@ -3922,7 +3941,10 @@ gsk_gl_renderer_init (GskGLRenderer *self)
     GskProfiler *profiler = gsk_renderer_get_profiler (GSK_RENDERER (self));
 
     self->profile_counters.frames = gsk_profiler_add_counter (profiler, "frames", "Frames", FALSE);
+    self->profile_counters.draw_calls = gsk_profiler_add_counter (profiler, "draw-calls", "Draw calls", TRUE);
+    self->profile_counters.texture_uploads = gsk_profiler_add_counter (profiler, "texture-uploads", "Texture uploads", TRUE);
 
+    self->profile_timers.ops_time = gsk_profiler_add_timer (profiler, "ops-time", "Op building time", FALSE, TRUE);
     self->profile_timers.cpu_time = gsk_profiler_add_timer (profiler, "cpu-time", "CPU time", FALSE, TRUE);
     self->profile_timers.gpu_time = gsk_profiler_add_timer (profiler, "gpu-time", "GPU time", FALSE, TRUE);
   }
@@ -525,3 +525,47 @@ gsk_profiler_append_timers (GskProfiler *profiler,
       g_string_append (buffer, "\n");
     }
 }
+
+/*< private >
+ * gsk_profiler_get_values:
+ * @profiler: a #GskProfiler
+ *
+ * Collects the current values of all counters and timers of @profiler,
+ * keyed by the name they were added with. Timer values are in usec,
+ * just like the ones returned by gsk_profiler_timer_get().
+ *
+ * Returns: (transfer floating): a #GVariant of type `a{sx}`
+ */
+GVariant *
+gsk_profiler_get_values (GskProfiler *profiler)
+{
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  gpointer value_p = NULL;
+
+  g_return_val_if_fail (GSK_IS_PROFILER (profiler), NULL);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sx}"));
+
+  g_hash_table_iter_init (&iter, profiler->counters);
+  while (g_hash_table_iter_next (&iter, NULL, &value_p))
+    {
+      NamedCounter *counter = value_p;
+
+      g_variant_builder_add (&builder, "{sx}",
+                             g_quark_to_string (counter->id),
+                             counter->value);
+    }
+
+  g_hash_table_iter_init (&iter, profiler->timers);
+  while (g_hash_table_iter_next (&iter, NULL, &value_p))
+    {
+      NamedTimer *timer = value_p;
+
+      g_variant_builder_add (&builder, "{sx}",
+                             g_quark_to_string (timer->id),
+                             gsk_profiler_timer_get (profiler, timer->id));
+    }
+
+  return g_variant_builder_end (&builder);
+}
@@ -51,6 +51,8 @@ void            gsk_profiler_append_counters    (GskProfiler *profiler,
 void            gsk_profiler_append_timers      (GskProfiler *profiler,
                                                  GString     *buffer);
 
+GVariant *      gsk_profiler_get_values         (GskProfiler *profiler);
+
 G_END_DECLS
 
 #endif /* __GSK_PROFILER_PRIVATE_H__ */
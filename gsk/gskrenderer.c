@@ -74,6 +74,11 @@ typedef struct
 
   GskProfiler *profiler;
 
+  struct {
+    GQuark arena_nodes;
+    GQuark arena_bytes;
+  } profile_counters;
+
   GskDebugFlags debug_flags;
 
   gboolean is_realized : 1;
@@ -203,6 +208,15 @@ gsk_renderer_init (GskRenderer *self)
 
   priv->profiler = gsk_profiler_new ();
   priv->debug_flags = gsk_get_debug_flags ();
+
+  priv->profile_counters.arena_nodes = gsk_profiler_add_counter (priv->profiler,
+                                                                 "arena-nodes",
+                                                                 "Render nodes allocated from arenas",
+                                                                 TRUE);
+  priv->profile_counters.arena_bytes = gsk_profiler_add_counter (priv->profiler,
+                                                                 "arena-bytes",
+                                                                 "Bytes of render nodes allocated from arenas",
+                                                                 TRUE);
 }
 
 /**
@@ -404,6 +418,7 @@ gsk_renderer_render (GskRenderer          *renderer,
 {
   GskRendererPrivate *priv = gsk_renderer_get_instance_private (renderer);
   cairo_region_t *clip;
+  guint n_arena_nodes, n_arena_bytes;
 
   g_return_if_fail (GSK_IS_RENDERER (renderer));
   g_return_if_fail (priv->is_realized);
@@ -432,6 +447,10 @@ gsk_renderer_render (GskRenderer          *renderer,
 
   priv->root_node = gsk_render_node_ref (root);
 
+  gsk_render_node_arena_collect_stats (&n_arena_nodes, &n_arena_bytes);
+  gsk_profiler_counter_set (priv->profiler, priv->profile_counters.arena_nodes, n_arena_nodes);
+  gsk_profiler_counter_set (priv->profiler, priv->profile_counters.arena_bytes, n_arena_bytes);
+
   GSK_RENDERER_GET_CLASS (renderer)->render (renderer, root, clip);
 
 #ifdef G_ENABLE_DEBUG
@@ -475,6 +494,28 @@ gsk_renderer_get_profiler (GskRenderer *renderer)
   return priv->profiler;
 }
 
+/*< private >
+ * gsk_renderer_get_profiler_values:
+ * @renderer: a #GskRenderer
+ *
+ * Retrieves the current values of the counters and timers that
+ * @renderer collected during its last render, see
+ * gsk_profiler_get_values().
+ *
+ * Most of the values are only collected in debug builds.
+ *
+ * Returns: (transfer floating): a #GVariant of type `a{sx}`
+ */
+GVariant *
+gsk_renderer_get_profiler_values (GskRenderer *renderer)
+{
+  GskRendererPrivate *priv = gsk_renderer_get_instance_private (renderer);
+
+  g_return_val_if_fail (GSK_IS_RENDERER (renderer), NULL);
+
+  return gsk_profiler_get_values (priv->profiler);
+}
+
 static GType
 get_renderer_for_name (const char *renderer_name)
 {
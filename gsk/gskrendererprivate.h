@@ -55,6 +55,10 @@ GskRenderNode *         gsk_renderer_get_root_node              (GskRenderer
 
 GskProfiler *           gsk_renderer_get_profiler               (GskRenderer    *renderer);
 
+/* Exported for tests/rendernode-benchmark.c */
+GDK_AVAILABLE_IN_ALL
+GVariant *              gsk_renderer_get_profiler_values        (GskRenderer    *renderer);
+
 GskDebugFlags           gsk_renderer_get_debug_flags            (GskRenderer    *renderer);
 void                    gsk_renderer_set_debug_flags            (GskRenderer    *renderer,
                                                                  GskDebugFlags   flags);
@@ -42,6 +42,7 @@
 
 #include "gskdebugprivate.h"
 #include "gskrendererprivate.h"
+#include "gskrendernodebinaryprivate.h"
 #include "gskrendernodeparserprivate.h"
 
 #include <graphene-gobject.h>
@@ -139,10 +140,15 @@ value_render_node_lcopy_value (const GValue *value,
   return NULL;
 }
 
+static void gsk_render_node_arena_unref (GskRenderNodeArena *arena);
+
 static void
 gsk_render_node_finalize (GskRenderNode *self)
 {
-  g_type_free_instance ((GTypeInstance *) self);
+  if (self->arena)
+    gsk_render_node_arena_unref (self->arena);
+  else
+    g_type_free_instance ((GTypeInstance *) self);
 }
 
 static void
@@ -236,6 +242,18 @@ gsk_render_node_get_type (void)
   return render_node_type__volatile;
 }
 
+/* What we need to know to create instances without going
+ * through g_type_create_instance(), indexed by node type.
+ */
+typedef struct
+{
+  GskRenderNodeClass *node_class;
+  gsize instance_size;
+  void (* instance_init) (GskRenderNode *node);
+} RenderNodeInstanceInfo;
+
+static RenderNodeInstanceInfo render_node_instance_info[GSK_RENDER_NODE_TYPE_N_TYPES];
+
 typedef struct
 {
   GskRenderNodeType node_type;
@@ -294,7 +312,9 @@ GType
 gsk_render_node_type_register_static (const char                  *node_name,
                                       const GskRenderNodeTypeInfo *node_info)
 {
+  RenderNodeInstanceInfo *instance_info;
   GTypeInfo info;
+  GType node_type;
 
   info.class_size = sizeof (GskRenderNodeClass);
   info.base_init = NULL;
@@ -322,7 +342,230 @@ gsk_render_node_type_register_static (const char                  *node_name,
   info.instance_init = (GInstanceInitFunc) node_info->instance_init;
   info.value_table = NULL;
 
-  return g_type_register_static (GSK_TYPE_RENDER_NODE, node_name, &info, 0);
+  node_type = g_type_register_static (GSK_TYPE_RENDER_NODE, node_name, &info, 0);
+
+  /* Render node types are never unloaded, so we keep this
+   * reference around forever.
+   */
+  instance_info = &render_node_instance_info[node_info->node_type];
+  instance_info->node_class = g_type_class_ref (node_type);
+  instance_info->instance_size = node_info->instance_size;
+  instance_info->instance_init = node_info->instance_init;
+
+  return node_type;
+}
+
+/* Render node arenas
+ *
+ * While an arena is active on a thread, all render nodes created
+ * on that thread are bump-allocated from it instead of going
+ * through g_type_create_instance(). Every node holds a reference
+ * on its arena, and the memory is released in one go when the
+ * last of them is finalized.
+ *
+ * Arenas are meant to be short-lived and small, like the nodes
+ * created for a single widget in gtk_widget_snapshot(), so that
+ * one long-lived node doesn't keep a lot of memory alive. Code
+ * that caches nodes beyond the snapshot that created them must
+ * create them in an arena of their own, so that the cache does
+ * not keep the arena of the surrounding snapshot alive.
+ *
+ * The first chunk is sized from a hint, usually the number of
+ * bytes the same content needed last time, so that arenas of leaf
+ * widgets with one or two nodes don't waste a full chunk. Without
+ * a hint, chunks start small and grow up to ARENA_CHUNK_SIZE.
+ */
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~(gsize) (ARENA_ALIGNMENT - 1))
+#define ARENA_MIN_CHUNK_SIZE 256
+#define ARENA_CHUNK_SIZE 4096
+
+typedef struct _GskRenderNodeArenaChunk GskRenderNodeArenaChunk;
+
+struct _GskRenderNodeArenaChunk
+{
+  GskRenderNodeArenaChunk *next;
+};
+
+#define ARENA_CHUNK_HEADER_SIZE ARENA_ALIGN (sizeof (GskRenderNodeArenaChunk))
+
+struct _GskRenderNodeArena
+{
+  gatomicrefcount ref_count;
+
+  GskRenderNodeArena *previous;
+
+  GskRenderNodeArenaChunk *chunks;
+  guchar *pos;
+  gsize remaining;
+  gsize next_chunk_size;
+  gsize used;
+
+  guint n_nodes;
+  guint n_bytes;
+};
+
+static GPrivate current_arena;
+
+static guint arena_stats_n_nodes;
+static guint arena_stats_n_bytes;
+
+static void
+gsk_render_node_arena_unref (GskRenderNodeArena *arena)
+{
+  GskRenderNodeArenaChunk *chunk, *next;
+
+  if (!g_atomic_ref_count_dec (&arena->ref_count))
+    return;
+
+  for (chunk = arena->chunks; chunk; chunk = next)
+    {
+      next = chunk->next;
+      g_free (chunk);
+    }
+
+  g_slice_free (GskRenderNodeArena, arena);
+}
+
+/*< private >
+ * gsk_render_node_arena_begin:
+ * @size_hint: the number of bytes that will likely be allocated,
+ *   as returned by gsk_render_node_arena_end() for the same content
+ *   last time, or 0 if unknown
+ *
+ * Makes a new arena the current one for the calling thread.
+ *
+ * Until gsk_render_node_arena_end() is called, all render nodes
+ * created on this thread will be allocated from it. Arenas can be
+ * nested.
+ *
+ * Returns: the new arena
+ */
+GskRenderNodeArena *
+gsk_render_node_arena_begin (gsize size_hint)
+{
+  GskRenderNodeArena *arena;
+
+  arena = g_slice_new0 (GskRenderNodeArena);
+  g_atomic_ref_count_init (&arena->ref_count);
+  if (size_hint > 0)
+    arena->next_chunk_size = ARENA_CHUNK_HEADER_SIZE + ARENA_ALIGN (size_hint);
+  else
+    arena->next_chunk_size = ARENA_MIN_CHUNK_SIZE;
+  arena->previous = g_private_get (&current_arena);
+
+  g_private_set (&current_arena, arena);
+
+  return arena;
+}
+
+/*< private >
+ * gsk_render_node_arena_end:
+ * @arena: the arena returned by the matching gsk_render_node_arena_begin()
+ *
+ * Stops allocating render nodes from @arena and makes the previous
+ * arena, if any, current again.
+ *
+ * The memory of @arena stays around until all the nodes allocated
+ * from it have been finalized.
+ *
+ * Returns: the number of bytes allocated from @arena, to be used
+ *   as size hint the next time
+ */
+gsize
+gsk_render_node_arena_end (GskRenderNodeArena *arena)
+{
+  gsize used;
+
+  g_return_val_if_fail (g_private_get (&current_arena) == arena, 0);
+
+  g_private_set (&current_arena, arena->previous);
+  arena->previous = NULL;
+
+  g_atomic_int_add (&arena_stats_n_nodes, arena->n_nodes);
+  g_atomic_int_add (&arena_stats_n_bytes, arena->n_bytes);
+
+  used = arena->used;
+  gsk_render_node_arena_unref (arena);
+
+  return used;
+}
+
+/*< private >
+ * gsk_render_node_arena_collect_stats:
+ * @n_nodes: (out): return location for the number of nodes
+ * @n_bytes: (out): return location for the number of bytes
+ *
+ * Retrieves the number of render nodes and bytes that have been
+ * allocated from arenas since the last call, and resets them.
+ *
+ * The numbers are totals over all arenas ended on any thread,
+ * they are not tracked per widget.
+ */
+void
+gsk_render_node_arena_collect_stats (guint *n_nodes,
+                                     guint *n_bytes)
+{
+  *n_nodes = g_atomic_int_and (&arena_stats_n_nodes, 0);
+  *n_bytes = g_atomic_int_and (&arena_stats_n_bytes, 0);
+}
+
+static gpointer
+gsk_render_node_arena_alloc (GskRenderNodeArena *arena,
+                             gsize               size)
+{
+  gpointer mem;
+
+  size = ARENA_ALIGN (size);
+
+  if (size > arena->remaining)
+    {
+      GskRenderNodeArenaChunk *chunk;
+      gsize chunk_size;
+
+      chunk_size = MAX (arena->next_chunk_size, ARENA_CHUNK_HEADER_SIZE + size);
+      arena->next_chunk_size = MAX (MIN (2 * chunk_size, ARENA_CHUNK_SIZE), ARENA_MIN_CHUNK_SIZE);
+      chunk = g_malloc (chunk_size);
+      chunk->next = arena->chunks;
+      arena->chunks = chunk;
+
+      arena->pos = (guchar *) chunk + ARENA_CHUNK_HEADER_SIZE;
+      arena->remaining = chunk_size - ARENA_CHUNK_HEADER_SIZE;
+    }
+
+  mem = arena->pos;
+  arena->pos += size;
+  arena->remaining -= size;
+  arena->used += size;
+
+  memset (mem, 0, size);
+
+  return mem;
+}
+
+static GskRenderNode *
+gsk_render_node_arena_create_instance (GskRenderNodeArena *arena,
+                                       GskRenderNodeType   node_type)
+{
+  const RenderNodeInstanceInfo *info = &render_node_instance_info[node_type];
+  GskRenderNode *node;
+
+  node = gsk_render_node_arena_alloc (arena, info->instance_size);
+
+  /* This is what g_type_create_instance() would do for us */
+  node->parent_instance.g_class = (GTypeClass *) info->node_class;
+  gsk_render_node_init (node);
+  if (info->instance_init)
+    info->instance_init (node);
+
+  node->arena = arena;
+  g_atomic_ref_count_inc (&arena->ref_count);
+
+  arena->n_nodes++;
+  arena->n_bytes += info->instance_size;
+
+  return node;
 }
 
 /*< private >
@@ -336,10 +579,17 @@ gsk_render_node_type_register_static (const char                  *node_name,
 gpointer
 gsk_render_node_alloc (GskRenderNodeType node_type)
 {
+  GskRenderNodeArena *arena;
+
   g_return_val_if_fail (node_type > GSK_NOT_A_RENDER_NODE, NULL);
   g_return_val_if_fail (node_type < GSK_RENDER_NODE_TYPE_N_TYPES, NULL);
 
   g_assert (gsk_render_node_types[node_type] != G_TYPE_INVALID);
+
+  arena = g_private_get (&current_arena);
+  if (arena)
+    return gsk_render_node_arena_create_instance (arena, node_type);
+
   return g_type_create_instance (gsk_render_node_types[node_type]);
 }
 
@@ -591,14 +841,42 @@ gsk_render_node_write_to_file (GskRenderNode *node,
   return result;
 }
 
+/**
+ * gsk_render_node_serialize_binary:
+ * @node: a #GskRenderNode
+ *
+ * Serializes the @node into a compact binary format for later
+ * deserialization via gsk_render_node_deserialize().
+ *
+ * Unlike the text format produced by gsk_render_node_serialize(),
+ * the binary format stores pixel data uncompressed and doesn't need
+ * to be parsed, so it is a lot faster to load. Textures loaded from
+ * it refer to the data directly, so mapping a file with
+ * g_mapped_file_get_bytes() avoids reading pixels that are never used.
+ *
+ * The same caveats about the stability of the format as for
+ * gsk_render_node_serialize() apply.
+ *
+ * Returns: a #GBytes representing the node.
+ **/
+GBytes *
+gsk_render_node_serialize_binary (GskRenderNode *node)
+{
+  g_return_val_if_fail (GSK_IS_RENDER_NODE (node), NULL);
+
+  return gsk_render_node_binary_serialize (node);
+}
+
 /**
  * gsk_render_node_deserialize:
  * @bytes: the bytes containing the data
  * @error_func: (nullable) (scope call): Callback on parsing errors or %NULL
  * @user_data: (closure error_func): user_data for @error_func
  *
- * Loads data previously created via gsk_render_node_serialize(). For a
- * discussion of the supported format, see that function.
+ * Loads data previously created via gsk_render_node_serialize() or
+ * gsk_render_node_serialize_binary(). The format is detected
+ * automatically. For a discussion of the supported formats, see those
+ * functions.
  *
  * Returns: (nullable) (transfer full): a new #GskRenderNode or %NULL on
  *     error.
@@ -610,7 +888,10 @@ gsk_render_node_deserialize (GBytes            *bytes,
 {
   GskRenderNode *node = NULL;
 
-  node = gsk_render_node_deserialize_from_bytes (bytes, error_func, user_data);
+  if (gsk_render_node_binary_check (bytes))
+    node = gsk_render_node_binary_deserialize (bytes, error_func, user_data);
+  else
+    node = gsk_render_node_deserialize_from_bytes (bytes, error_func, user_data);
 
   return node;
 }
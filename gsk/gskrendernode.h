@@ -91,6 +91,8 @@ void                    gsk_render_node_draw                    (GskRenderNode *
 GDK_AVAILABLE_IN_ALL
 GBytes *                gsk_render_node_serialize               (GskRenderNode *node);
 GDK_AVAILABLE_IN_ALL
+GBytes *                gsk_render_node_serialize_binary        (GskRenderNode *node);
+GDK_AVAILABLE_IN_ALL
 gboolean                gsk_render_node_write_to_file           (GskRenderNode *node,
                                                                  const char    *filename,
                                                                  GError       **error);
@@ -0,0 +1,1565 @@
+/* GSK - The GTK Scene Kit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gskrendernodebinaryprivate.h"
+
+#include "gskrendernodeprivate.h"
+#include "gsktransformprivate.h"
+
+#include "gdk/gdkmemorytextureprivate.h"
+#include "gdk/gdktextureprivate.h"
+
+#include <math.h>
+#include <pango/pangocairo.h>
+#include <string.h>
+
+/* The binary render node format
+ *
+ * All integers are little-endian. A file starts with this header:
+ *
+ *   char    magic[8]         GSK_BINARY_MAGIC
+ *   guint32 version          GSK_BINARY_VERSION
+ *   guint32 n_strings
+ *   guint32 n_textures
+ *   guint32 n_nodes
+ *   guint64 strings_offset
+ *   guint64 textures_offset
+ *   guint64 nodes_offset
+ *
+ * The string table is an array of { guint64 offset, guint64 length }
+ * pairs pointing to nul-terminated UTF-8 data elsewhere in the file.
+ *
+ * The texture table is an array of { guint32 width, guint32 height,
+ * guint32 stride, guint32 format, guint64 offset, guint64 size }
+ * entries pointing to raw pixel data. Pixel data is aligned so it can
+ * be used directly when the file is mapped into memory, and textures
+ * are only created when a node refers to them.
+ *
+ * Nodes are stored as a sequence of { guint32 type, guint32 size }
+ * records, each followed by @size bytes of payload. Children are
+ * always written before their parents and are referred to by their
+ * index in the sequence, so nodes that appear multiple times in a
+ * tree are only stored once. The last node is the root.
+ */
+
+#define GSK_BINARY_MAGIC "\211GSKNODE"
+#define GSK_BINARY_MAGIC_LENGTH 8
+#define GSK_BINARY_VERSION 1
+#define GSK_BINARY_HEADER_SIZE (GSK_BINARY_MAGIC_LENGTH + 4 * 4 + 3 * 8)
+#define GSK_BINARY_STRING_ENTRY_SIZE (2 * 8)
+#define GSK_BINARY_TEXTURE_ENTRY_SIZE (4 * 4 + 2 * 8)
+#define GSK_BINARY_ALIGNMENT 16
+
+#define GSK_BINARY_NONE G_MAXUINT32
+
+/*** Writing ***/
+
+typedef struct
+{
+  GByteArray *records;  /* all node records, in order */
+  GByteArray *payload;  /* payload of the node being written */
+  guint n_nodes;
+  GHashTable *node_ids;
+
+  GPtrArray *strings;
+  GHashTable *string_ids;
+
+  GPtrArray *textures;
+  GHashTable *texture_ids;
+} Writer;
+
+static void
+write_uint32 (GByteArray *array,
+              guint32     value)
+{
+  value = GUINT32_TO_LE (value);
+  g_byte_array_append (array, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+write_int32 (GByteArray *array,
+             gint32      value)
+{
+  write_uint32 (array, (guint32) value);
+}
+
+static void
+write_uint64 (GByteArray *array,
+              guint64     value)
+{
+  value = GUINT64_TO_LE (value);
+  g_byte_array_append (array, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+write_float (GByteArray *array,
+             float       value)
+{
+  guint32 bits;
+
+  memcpy (&bits, &value, sizeof (bits));
+  write_uint32 (array, bits);
+}
+
+static void
+write_point (GByteArray             *array,
+             const graphene_point_t *point)
+{
+  write_float (array, point->x);
+  write_float (array, point->y);
+}
+
+static void
+write_rect (GByteArray            *array,
+            const graphene_rect_t *rect)
+{
+  write_float (array, rect->origin.x);
+  write_float (array, rect->origin.y);
+  write_float (array, rect->size.width);
+  write_float (array, rect->size.height);
+}
+
+static void
+write_rounded_rect (GByteArray           *array,
+                    const GskRoundedRect *rect)
+{
+  guint i;
+
+  write_rect (array, &rect->bounds);
+  for (i = 0; i < 4; i++)
+    {
+      write_float (array, rect->corner[i].width);
+      write_float (array, rect->corner[i].height);
+    }
+}
+
+static void
+write_rgba (GByteArray    *array,
+            const GdkRGBA *rgba)
+{
+  write_float (array, rgba->red);
+  write_float (array, rgba->green);
+  write_float (array, rgba->blue);
+  write_float (array, rgba->alpha);
+}
+
+static void
+write_string (Writer     *writer,
+              const char *string)
+{
+  gpointer id;
+
+  if (string == NULL)
+    {
+      write_uint32 (writer->payload, GSK_BINARY_NONE);
+      return;
+    }
+
+  if (!g_hash_table_lookup_extended (writer->string_ids, string, NULL, &id))
+    {
+      char *copy = g_strdup (string);
+
+      id = GUINT_TO_POINTER (writer->strings->len);
+      g_ptr_array_add (writer->strings, copy);
+      g_hash_table_insert (writer->string_ids, copy, id);
+    }
+
+  write_uint32 (writer->payload, GPOINTER_TO_UINT (id));
+}
+
+static void
+write_texture (Writer     *writer,
+               GdkTexture *texture)
+{
+  gpointer id;
+
+  if (!g_hash_table_lookup_extended (writer->texture_ids, texture, NULL, &id))
+    {
+      id = GUINT_TO_POINTER (writer->textures->len);
+      g_ptr_array_add (writer->textures, g_object_ref (texture));
+      g_hash_table_insert (writer->texture_ids, texture, id);
+    }
+
+  write_uint32 (writer->payload, GPOINTER_TO_UINT (id));
+}
+
+static guint32 write_node (Writer        *writer,
+                           GskRenderNode *node);
+
+static GdkTexture *
+cairo_node_to_texture (GskRenderNode *node)
+{
+  cairo_surface_t *surface, *image;
+  GdkTexture *texture;
+  cairo_t *cr;
+  int width, height;
+
+  surface = gsk_cairo_node_peek_surface (node);
+  width = ceilf (node->bounds.size.width);
+  height = ceilf (node->bounds.size.height);
+  if (surface == NULL || width <= 0 || height <= 0)
+    return NULL;
+
+  image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+  cr = cairo_create (image);
+  cairo_set_source_surface (cr, surface, - node->bounds.origin.x, - node->bounds.origin.y);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  texture = gdk_texture_new_for_surface (image);
+  cairo_surface_destroy (image);
+
+  return texture;
+}
+
+static void
+write_node_payload (Writer        *writer,
+                    GskRenderNode *node)
+{
+  GByteArray *array = writer->payload;
+
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_CONTAINER_NODE:
+      {
+        guint i, n_children;
+        guint32 *children;
+
+        n_children = gsk_container_node_get_n_children (node);
+        children = g_new (guint32, n_children);
+        for (i = 0; i < n_children; i++)
+          children[i] = write_node (writer, gsk_container_node_get_child (node, i));
+
+        write_uint32 (array, n_children);
+        for (i = 0; i < n_children; i++)
+          write_uint32 (array, children[i]);
+
+        g_free (children);
+      }
+      break;
+
+    case GSK_CAIRO_NODE:
+      {
+        GdkTexture *texture = cairo_node_to_texture (node);
+
+        write_rect (array, &node->bounds);
+        if (texture)
+          {
+            write_texture (writer, texture);
+            g_object_unref (texture);
+          }
+        else
+          write_uint32 (array, GSK_BINARY_NONE);
+      }
+      break;
+
+    case GSK_COLOR_NODE:
+      write_rect (array, &node->bounds);
+      write_rgba (array, gsk_color_node_peek_color (node));
+      break;
+
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      {
+        const GskColorStop *stops;
+        gsize i, n_stops;
+
+        stops = gsk_linear_gradient_node_peek_color_stops (node, &n_stops);
+
+        write_rect (array, &node->bounds);
+        write_point (array, gsk_linear_gradient_node_peek_start (node));
+        write_point (array, gsk_linear_gradient_node_peek_end (node));
+        write_uint32 (array, n_stops);
+        for (i = 0; i < n_stops; i++)
+          {
+            write_float (array, stops[i].offset);
+            write_rgba (array, &stops[i].color);
+          }
+      }
+      break;
+
+    case GSK_BORDER_NODE:
+      {
+        const float *widths = gsk_border_node_peek_widths (node);
+        const GdkRGBA *colors = gsk_border_node_peek_colors (node);
+        guint i;
+
+        write_rounded_rect (array, gsk_border_node_peek_outline (node));
+        for (i = 0; i < 4; i++)
+          write_float (array, widths[i]);
+        for (i = 0; i < 4; i++)
+          write_rgba (array, &colors[i]);
+      }
+      break;
+
+    case GSK_TEXTURE_NODE:
+      write_rect (array, &node->bounds);
+      write_texture (writer, gsk_texture_node_get_texture (node));
+      break;
+
+    case GSK_INSET_SHADOW_NODE:
+      write_rounded_rect (array, gsk_inset_shadow_node_peek_outline (node));
+      write_rgba (array, gsk_inset_shadow_node_peek_color (node));
+      write_float (array, gsk_inset_shadow_node_get_dx (node));
+      write_float (array, gsk_inset_shadow_node_get_dy (node));
+      write_float (array, gsk_inset_shadow_node_get_spread (node));
+      write_float (array, gsk_inset_shadow_node_get_blur_radius (node));
+      break;
+
+    case GSK_OUTSET_SHADOW_NODE:
+      write_rounded_rect (array, gsk_outset_shadow_node_peek_outline (node));
+      write_rgba (array, gsk_outset_shadow_node_peek_color (node));
+      write_float (array, gsk_outset_shadow_node_get_dx (node));
+      write_float (array, gsk_outset_shadow_node_get_dy (node));
+      write_float (array, gsk_outset_shadow_node_get_spread (node));
+      write_float (array, gsk_outset_shadow_node_get_blur_radius (node));
+      break;
+
+    case GSK_TRANSFORM_NODE:
+      {
+        guint32 child = write_node (writer, gsk_transform_node_get_child (node));
+        char *transform = gsk_transform_to_string (gsk_transform_node_get_transform (node));
+
+        write_uint32 (array, child);
+        write_string (writer, transform);
+
+        g_free (transform);
+      }
+      break;
+
+    case GSK_OPACITY_NODE:
+      {
+        guint32 child = write_node (writer, gsk_opacity_node_get_child (node));
+
+        write_uint32 (array, child);
+        write_float (array, gsk_opacity_node_get_opacity (node));
+      }
+      break;
+
+    case GSK_COLOR_MATRIX_NODE:
+      {
+        guint32 child = write_node (writer, gsk_color_matrix_node_get_child (node));
+        float matrix[16], offset[4];
+        guint i;
+
+        graphene_matrix_to_float (gsk_color_matrix_node_peek_color_matrix (node), matrix);
+        graphene_vec4_to_float (gsk_color_matrix_node_peek_color_offset (node), offset);
+
+        write_uint32 (array, child);
+        for (i = 0; i < 16; i++)
+          write_float (array, matrix[i]);
+        for (i = 0; i < 4; i++)
+          write_float (array, offset[i]);
+      }
+      break;
+
+    case GSK_REPEAT_NODE:
+      {
+        guint32 child = write_node (writer, gsk_repeat_node_get_child (node));
+
+        write_rect (array, &node->bounds);
+        write_uint32 (array, child);
+        write_rect (array, gsk_repeat_node_peek_child_bounds (node));
+      }
+      break;
+
+    case GSK_CLIP_NODE:
+      {
+        guint32 child = write_node (writer, gsk_clip_node_get_child (node));
+
+        write_uint32 (array, child);
+        write_rect (array, gsk_clip_node_peek_clip (node));
+      }
+      break;
+
+    case GSK_ROUNDED_CLIP_NODE:
+      {
+        guint32 child = write_node (writer, gsk_rounded_clip_node_get_child (node));
+
+        write_uint32 (array, child);
+        write_rounded_rect (array, gsk_rounded_clip_node_peek_clip (node));
+      }
+      break;
+
+    case GSK_SHADOW_NODE:
+      {
+        guint32 child = write_node (writer, gsk_shadow_node_get_child (node));
+        gsize i, n_shadows;
+
+        n_shadows = gsk_shadow_node_get_n_shadows (node);
+
+        write_uint32 (array, child);
+        write_uint32 (array, n_shadows);
+        for (i = 0; i < n_shadows; i++)
+          {
+            const GskShadow *shadow = gsk_shadow_node_peek_shadow (node, i);
+
+            write_rgba (array, &shadow->color);
+            write_float (array, shadow->dx);
+            write_float (array, shadow->dy);
+            write_float (array, shadow->radius);
+          }
+      }
+      break;
+
+    case GSK_BLEND_NODE:
+      {
+        guint32 bottom = write_node (writer, gsk_blend_node_get_bottom_child (node));
+        guint32 top = write_node (writer, gsk_blend_node_get_top_child (node));
+
+        write_uint32 (array, bottom);
+        write_uint32 (array, top);
+        write_uint32 (array, gsk_blend_node_get_blend_mode (node));
+      }
+      break;
+
+    case GSK_CROSS_FADE_NODE:
+      {
+        guint32 start = write_node (writer, gsk_cross_fade_node_get_start_child (node));
+        guint32 end = write_node (writer, gsk_cross_fade_node_get_end_child (node));
+
+        write_uint32 (array, start);
+        write_uint32 (array, end);
+        write_float (array, gsk_cross_fade_node_get_progress (node));
+      }
+      break;
+
+    case GSK_TEXT_NODE:
+      {
+        PangoFontDescription *desc;
+        const PangoGlyphInfo *glyphs;
+        char *font_name;
+        guint i, n_glyphs;
+
+        desc = pango_font_describe (gsk_text_node_peek_font (node));
+        font_name = pango_font_description_to_string (desc);
+        glyphs = gsk_text_node_peek_glyphs (node, &n_glyphs);
+
+        write_string (writer, font_name);
+        write_rgba (array, gsk_text_node_peek_color (node));
+        write_point (array, gsk_text_node_get_offset (node));
+        write_uint32 (array, n_glyphs);
+        for (i = 0; i < n_glyphs; i++)
+          {
+            write_uint32 (array, glyphs[i].glyph);
+            write_int32 (array, glyphs[i].geometry.width);
+            write_int32 (array, glyphs[i].geometry.x_offset);
+            write_int32 (array, glyphs[i].geometry.y_offset);
+            write_uint32 (array, glyphs[i].attr.is_cluster_start ? 1 : 0);
+          }
+
+        g_free (font_name);
+        pango_font_description_free (desc);
+      }
+      break;
+
+    case GSK_BLUR_NODE:
+      {
+        guint32 child = write_node (writer, gsk_blur_node_get_child (node));
+
+        write_uint32 (array, child);
+        write_float (array, gsk_blur_node_get_radius (node));
+      }
+      break;
+
+    case GSK_DEBUG_NODE:
+      {
+        guint32 child = write_node (writer, gsk_debug_node_get_child (node));
+
+        write_uint32 (array, child);
+        write_string (writer, gsk_debug_node_get_message (node));
+      }
+      break;
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      g_assert_not_reached ();
+      break;
+    }
+}
+
+static guint32
+write_node (Writer        *writer,
+            GskRenderNode *node)
+{
+  gpointer id;
+  GByteArray *payload, *parent_payload;
+
+  if (g_hash_table_lookup_extended (writer->node_ids, node, NULL, &id))
+    return GPOINTER_TO_UINT (id);
+
+  /* Children are written to the records while we build the
+   * payload, so it is collected separately, and only the ids
+   * of the children end up in it */
+  parent_payload = writer->payload;
+  payload = g_byte_array_new ();
+  writer->payload = payload;
+  write_node_payload (writer, node);
+  writer->payload = parent_payload;
+
+  write_uint32 (writer->records, gsk_render_node_get_node_type (node));
+  write_uint32 (writer->records, payload->len);
+  g_byte_array_append (writer->records, payload->data, payload->len);
+  g_byte_array_unref (payload);
+
+  id = GUINT_TO_POINTER (writer->n_nodes);
+  writer->n_nodes++;
+  g_hash_table_insert (writer->node_ids, node, id);
+
+  return GPOINTER_TO_UINT (id);
+}
+
+static void
+pad_to_alignment (GByteArray *array)
+{
+  static const guint8 zeros[GSK_BINARY_ALIGNMENT] = { 0, };
+
+  if (array->len % GSK_BINARY_ALIGNMENT)
+    g_byte_array_append (array, zeros, GSK_BINARY_ALIGNMENT - array->len % GSK_BINARY_ALIGNMENT);
+}
+
+/*< private >
+ * gsk_render_node_binary_serialize:
+ * @node: a #GskRenderNode
+ *
+ * Serializes @node into the binary format.
+ *
+ * Returns: a #GBytes containing the data
+ */
+GBytes *
+gsk_render_node_binary_serialize (GskRenderNode *node)
+{
+  Writer writer;
+  GByteArray *result;
+  guint64 strings_offset, textures_offset, nodes_offset, data_offset;
+  guint i;
+
+  writer.records = g_byte_array_new ();
+  writer.payload = NULL;
+  writer.n_nodes = 0;
+  writer.node_ids = g_hash_table_new (NULL, NULL);
+  writer.strings = g_ptr_array_new_with_free_func (g_free);
+  writer.string_ids = g_hash_table_new (g_str_hash, g_str_equal);
+  writer.textures = g_ptr_array_new_with_free_func (g_object_unref);
+  writer.texture_ids = g_hash_table_new (NULL, NULL);
+
+  write_node (&writer, node);
+
+  strings_offset = GSK_BINARY_HEADER_SIZE;
+  textures_offset = strings_offset + (guint64) writer.strings->len * GSK_BINARY_STRING_ENTRY_SIZE;
+  nodes_offset = textures_offset + (guint64) writer.textures->len * GSK_BINARY_TEXTURE_ENTRY_SIZE;
+  data_offset = nodes_offset + writer.records->len;
+
+  result = g_byte_array_sized_new (data_offset);
+
+  /* Header */
+  g_byte_array_append (result, (const guint8 *) GSK_BINARY_MAGIC, GSK_BINARY_MAGIC_LENGTH);
+  write_uint32 (result, GSK_BINARY_VERSION);
+  write_uint32 (result, writer.strings->len);
+  write_uint32 (result, writer.textures->len);
+  write_uint32 (result, writer.n_nodes);
+  write_uint64 (result, strings_offset);
+  write_uint64 (result, textures_offset);
+  write_uint64 (result, nodes_offset);
+
+  /* String table */
+  for (i = 0; i < writer.strings->len; i++)
+    {
+      const char *string = g_ptr_array_index (writer.strings, i);
+      gsize length = strlen (string);
+
+      write_uint64 (result, data_offset);
+      write_uint64 (result, length);
+      data_offset += length + 1;
+    }
+
+  /* Texture table */
+  data_offset = (data_offset + GSK_BINARY_ALIGNMENT - 1) & ~(guint64) (GSK_BINARY_ALIGNMENT - 1);
+  for (i = 0; i < writer.textures->len; i++)
+    {
+      GdkTexture *texture = g_ptr_array_index (writer.textures, i);
+      guint64 size = (guint64) texture->width * texture->height * 4;
+
+      write_uint32 (result, texture->width);
+      write_uint32 (result, texture->height);
+      write_uint32 (result, texture->width * 4);
+      write_uint32 (result, GDK_MEMORY_DEFAULT);
+      write_uint64 (result, data_offset);
+      write_uint64 (result, size);
+      data_offset += size;
+      data_offset = (data_offset + GSK_BINARY_ALIGNMENT - 1) & ~(guint64) (GSK_BINARY_ALIGNMENT - 1);
+    }
+
+  g_assert (result->len == nodes_offset);
+  g_byte_array_append (result, writer.records->data, writer.records->len);
+
+  /* String data */
+  for (i = 0; i < writer.strings->len; i++)
+    {
+      const char *string = g_ptr_array_index (writer.strings, i);
+
+      g_byte_array_append (result, (const guint8 *) string, strlen (string) + 1);
+    }
+
+  /* Pixel data */
+  for (i = 0; i < writer.textures->len; i++)
+    {
+      GdkTexture *texture = g_ptr_array_index (writer.textures, i);
+      gsize offset;
+
+      pad_to_alignment (result);
+      offset = result->len;
+      g_byte_array_set_size (result, offset + (gsize) texture->width * texture->height * 4);
+      gdk_texture_download (texture, result->data + offset, texture->width * 4);
+    }
+
+  g_byte_array_unref (writer.records);
+  g_hash_table_unref (writer.node_ids);
+  g_hash_table_unref (writer.string_ids);
+  g_ptr_array_unref (writer.strings);
+  g_hash_table_unref (writer.texture_ids);
+  g_ptr_array_unref (writer.textures);
+
+  return g_byte_array_free_to_bytes (result);
+}
+
+/*** Reading ***/
+
+typedef struct
+{
+  GBytes *bytes;
+  const guchar *data;
+  gsize size;
+
+  guint32 n_strings;
+  const guchar *string_table;
+
+  guint32 n_textures;
+  const guchar *texture_table;
+  GdkTexture **textures;
+
+  guint32 n_nodes;
+  GskRenderNode **nodes;
+
+  GskParseErrorFunc error_func;
+  gpointer user_data;
+  gboolean had_error;
+} Reader;
+
+typedef struct
+{
+  Reader *reader;
+  gsize start;
+  gsize pos;
+  gsize end;
+  gboolean failed;
+} Record;
+
+static guint32
+get_uint32 (const guchar *data)
+{
+  guint32 value;
+
+  memcpy (&value, data, sizeof (value));
+
+  return GUINT32_FROM_LE (value);
+}
+
+static guint64
+get_uint64 (const guchar *data)
+{
+  guint64 value;
+
+  memcpy (&value, data, sizeof (value));
+
+  return GUINT64_FROM_LE (value);
+}
+
+static void reader_error (Reader                *reader,
+                          gsize                  offset,
+                          GskSerializationError  code,
+                          const char            *format,
+                          ...) G_GNUC_PRINTF (4, 5);
+
+static void
+reader_error (Reader                *reader,
+              gsize                  offset,
+              GskSerializationError  code,
+              const char            *format,
+              ...)
+{
+  GtkCssLocation location = { offset, offset, 0, offset, offset };
+  GtkCssSection *section;
+  GError *error;
+  va_list args;
+
+  reader->had_error = TRUE;
+
+  if (reader->error_func == NULL)
+    return;
+
+  va_start (args, format);
+  error = g_error_new_valist (GSK_SERIALIZATION_ERROR, code, format, args);
+  va_end (args);
+
+  section = gtk_css_section_new (NULL, &location, &location);
+  reader->error_func (section, error, reader->user_data);
+
+  gtk_css_section_unref (section);
+  g_error_free (error);
+}
+
+static guint32
+read_uint32 (Record *record)
+{
+  guint32 value;
+
+  if (record->failed)
+    return 0;
+
+  if (record->end - record->pos < 4)
+    {
+      reader_error (record->reader, record->pos, GSK_SERIALIZATION_INVALID_DATA,
+                    "Node record is too short");
+      record->failed = TRUE;
+      return 0;
+    }
+
+  value = get_uint32 (record->reader->data + record->pos);
+  record->pos += 4;
+
+  return value;
+}
+
+static gint32
+read_int32 (Record *record)
+{
+  return (gint32) read_uint32 (record);
+}
+
+static float
+read_float (Record *record)
+{
+  guint32 bits = read_uint32 (record);
+  float value;
+
+  memcpy (&value, &bits, sizeof (value));
+
+  return value;
+}
+
+static void
+read_point (Record           *record,
+            graphene_point_t *point)
+{
+  point->x = read_float (record);
+  point->y = read_float (record);
+}
+
+static void
+read_rect (Record          *record,
+           graphene_rect_t *rect)
+{
+  rect->origin.x = read_float (record);
+  rect->origin.y = read_float (record);
+  rect->size.width = read_float (record);
+  rect->size.height = read_float (record);
+}
+
+static void
+read_rounded_rect (Record         *record,
+                   GskRoundedRect *rect)
+{
+  guint i;
+
+  read_rect (record, &rect->bounds);
+  for (i = 0; i < 4; i++)
+    {
+      rect->corner[i].width = read_float (record);
+      rect->corner[i].height = read_float (record);
+    }
+}
+
+static void
+read_rgba (Record  *record,
+           GdkRGBA *rgba)
+{
+  rgba->red = read_float (record);
+  rgba->green = read_float (record);
+  rgba->blue = read_float (record);
+  rgba->alpha = read_float (record);
+}
+
+static guint32
+read_count (Record *record,
+            gsize   item_size)
+{
+  guint32 n = read_uint32 (record);
+
+  if (record->failed)
+    return 0;
+
+  if (n > (record->end - record->pos) / item_size)
+    {
+      reader_error (record->reader, record->pos, GSK_SERIALIZATION_INVALID_DATA,
+                    "Invalid number of items: %u", n);
+      record->failed = TRUE;
+      return 0;
+    }
+
+  return n;
+}
+
+static const char *
+read_string (Record *record)
+{
+  Reader *reader = record->reader;
+  gsize pos = record->pos;
+  guint64 offset, length;
+  const guchar *entry;
+  guint32 id;
+
+  id = read_uint32 (record);
+  if (record->failed || id == GSK_BINARY_NONE)
+    return NULL;
+
+  if (id >= reader->n_strings)
+    {
+      reader_error (reader, pos, GSK_SERIALIZATION_INVALID_DATA,
+                    "Invalid string index %u", id);
+      record->failed = TRUE;
+      return NULL;
+    }
+
+  entry = reader->string_table + (gsize) id * GSK_BINARY_STRING_ENTRY_SIZE;
+  offset = get_uint64 (entry);
+  length = get_uint64 (entry + 8);
+
+  if (offset >= reader->size ||
+      length >= reader->size - offset ||
+      reader->data[offset + length] != '\0' ||
+      !g_utf8_validate ((const char *) reader->data + offset, length, NULL))
+    {
+      reader_error (reader, pos, GSK_SERIALIZATION_INVALID_DATA,
+                    "Invalid string %u", id);
+      record->failed = TRUE;
+      return NULL;
+    }
+
+  return (const char *) reader->data + offset;
+}
+
+static GdkTexture *
+reader_get_texture (Reader *reader,
+                    guint32 id,
+                    gsize   pos)
+{
+  const guchar *entry;
+  guint32 width, height, stride, format;
+  guint64 offset, size;
+  GBytes *pixels;
+
+  if (reader->textures[id])
+    return reader->textures[id];
+
+  entry = reader->texture_table + (gsize) id * GSK_BINARY_TEXTURE_ENTRY_SIZE;
+  width = get_uint32 (entry);
+  height = get_uint32 (entry + 4);
+  stride = get_uint32 (entry + 8);
+  format = get_uint32 (entry + 12);
+  offset = get_uint64 (entry + 16);
+  size = get_uint64 (entry + 24);
+
+  /* We only ever write 4 bytes per pixel */
+  if ((format != GDK_MEMORY_B8G8R8A8_PREMULTIPLIED &&
+       format != GDK_MEMORY_A8R8G8B8_PREMULTIPLIED) ||
+      width == 0 || height == 0 ||
+      width > G_MAXINT / 4 || height > G_MAXINT ||
+      stride < width * 4 ||
+      offset > reader->size ||
+      size > reader->size - offset ||
+      size < (guint64) stride * (height - 1) + width * 4)
+    {
+      reader_error (reader, pos, GSK_SERIALIZATION_INVALID_DATA,
+                    "Invalid texture %u", id);
+      return NULL;
+    }
+
+  /* This doesn't copy the data, so if the file was mapped into
+   * memory, the pixels will only be read when they are needed.
+   */
+  pixels = g_bytes_new_from_bytes (reader->bytes, offset, size);
+  reader->textures[id] = gdk_memory_texture_new (width, height, format, pixels, stride);
+  g_bytes_unref (pixels);
+
+  return reader->textures[id];
+}
+
+static GdkTexture *
+read_texture (Record *record)
+{
+  Reader *reader = record->reader;
+  gsize pos = record->pos;
+  GdkTexture *texture;
+  guint32 id;
+
+  id = read_uint32 (record);
+  if (record->failed)
+    return NULL;
+
+  if (id >= reader->n_textures)
+    {
+      reader_error (reader, pos, GSK_SERIALIZATION_INVALID_DATA,
+                    "Invalid texture index %u", id);
+      record->failed = TRUE;
+      return NULL;
+    }
+
+  texture = reader_get_texture (reader, id, pos);
+  if (texture == NULL)
+    record->failed = TRUE;
+
+  return texture;
+}
+
+static GskRenderNode *
+read_node (Record  *record,
+           guint32  current)
+{
+  gsize pos = record->pos;
+  guint32 id;
+
+  id = read_uint32 (record);
+  if (record->failed)
+    return NULL;
+
+  /* Children always come before their parents */
+  if (id >= current)
+    {
+      reader_error (record->reader, pos, GSK_SERIALIZATION_INVALID_DATA,
+                    "Invalid node index %u", id);
+      record->failed = TRUE;
+      return NULL;
+    }
+
+  return record->reader->nodes[id];
+}
+
+static PangoFont *
+font_from_string (const char *string)
+{
+  PangoFontDescription *desc;
+  PangoFontMap *font_map;
+  PangoContext *context;
+  PangoFont *font;
+
+  desc = pango_font_description_from_string (string);
+  font_map = pango_cairo_font_map_get_default ();
+  context = pango_font_map_create_context (font_map);
+  font = pango_font_map_load_font (font_map, context, desc);
+
+  pango_font_description_free (desc);
+  g_object_unref (context);
+
+  return font;
+}
+
+/* Mirrors the checks in the gradient node constructors */
+static gboolean
+color_stops_valid (const GskColorStop *stops,
+                   guint               n_stops)
+{
+  guint i;
+
+  if (!(stops[0].offset >= 0))
+    return FALSE;
+
+  for (i = 1; i < n_stops; i++)
+    {
+      if (!(stops[i].offset >= stops[i - 1].offset))
+        return FALSE;
+    }
+
+  return stops[n_stops - 1].offset <= 1;
+}
+
+static GskRenderNode *
+read_node_payload (Record            *record,
+                   GskRenderNodeType  node_type,
+                   guint32            current)
+{
+  switch (node_type)
+    {
+    case GSK_CONTAINER_NODE:
+      {
+        GskRenderNode **children;
+        GskRenderNode *result;
+        guint i, n_children;
+
+        n_children = read_count (record, 4);
+        children = g_new (GskRenderNode *, n_children);
+        for (i = 0; i < n_children; i++)
+          children[i] = read_node (record, current);
+
+        if (record->failed)
+          result = NULL;
+        else
+          result = gsk_container_node_new (children, n_children);
+
+        g_free (children);
+
+        return result;
+      }
+
+    case GSK_CAIRO_NODE:
+      {
+        graphene_rect_t bounds;
+        GskRenderNode *result;
+        GdkTexture *texture;
+
+        read_rect (record, &bounds);
+        if (record->failed)
+          return NULL;
+
+        /* No texture means the node was never drawn to */
+        if (record->end - record->pos >= 4 &&
+            get_uint32 (record->reader->data + record->pos) == GSK_BINARY_NONE)
+          return gsk_cairo_node_new (&bounds);
+
+        texture = read_texture (record);
+        if (texture == NULL)
+          return NULL;
+
+        result = gsk_cairo_node_new (&bounds);
+        if (texture->width > 0 && texture->height > 0)
+          {
+            cairo_surface_t *surface = gdk_texture_download_surface (texture);
+            cairo_t *cr = gsk_cairo_node_get_draw_context (result);
+
+            cairo_set_source_surface (cr, surface, bounds.origin.x, bounds.origin.y);
+            cairo_paint (cr);
+
+            cairo_destroy (cr);
+            cairo_surface_destroy (surface);
+          }
+
+        return result;
+      }
+
+    case GSK_COLOR_NODE:
+      {
+        graphene_rect_t bounds;
+        GdkRGBA color;
+
+        read_rect (record, &bounds);
+        read_rgba (record, &color);
+        if (record->failed)
+          return NULL;
+
+        return gsk_color_node_new (&color, &bounds);
+      }
+
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      {
+        graphene_rect_t bounds;
+        graphene_point_t start, end;
+        GskColorStop *stops;
+        GskRenderNode *result;
+        guint i, n_stops;
+
+        read_rect (record, &bounds);
+        read_point (record, &start);
+        read_point (record, &end);
+        n_stops = read_count (record, 5 * 4);
+        stops = g_new (GskColorStop, n_stops);
+        for (i = 0; i < n_stops; i++)
+          {
+            stops[i].offset = read_float (record);
+            read_rgba (record, &stops[i].color);
+          }
+
+        if (record->failed)
+          result = NULL;
+        else if (n_stops < 2)
+          {
+            reader_error (record->reader, record->start, GSK_SERIALIZATION_INVALID_DATA,
+                          "Gradients need at least 2 color stops");
+            result = NULL;
+          }
+        else if (!color_stops_valid (stops, n_stops))
+          {
+            reader_error (record->reader, record->start, GSK_SERIALIZATION_INVALID_DATA,
+                          "Color stop offsets must be increasing and between 0 and 1");
+            result = NULL;
+          }
+        else if (node_type == GSK_REPEATING_LINEAR_GRADIENT_NODE)
+          result = gsk_repeating_linear_gradient_node_new (&bounds, &start, &end, stops, n_stops);
+        else
+          result = gsk_linear_gradient_node_new (&bounds, &start, &end, stops, n_stops);
+
+        g_free (stops);
+
+        return result;
+      }
+
+    case GSK_BORDER_NODE:
+      {
+        GskRoundedRect outline;
+        float widths[4];
+        GdkRGBA colors[4];
+        guint i;
+
+        read_rounded_rect (record, &outline);
+        for (i = 0; i < 4; i++)
+          widths[i] = read_float (record);
+        for (i = 0; i < 4; i++)
+          read_rgba (record, &colors[i]);
+        if (record->failed)
+          return NULL;
+
+        return gsk_border_node_new (&outline, widths, colors);
+      }
+
+    case GSK_TEXTURE_NODE:
+      {
+        graphene_rect_t bounds;
+        GdkTexture *texture;
+
+        read_rect (record, &bounds);
+        texture = read_texture (record);
+        if (record->failed)
+          return NULL;
+
+        return gsk_texture_node_new (texture, &bounds);
+      }
+
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+      {
+        GskRoundedRect outline;
+        GdkRGBA color;
+        float dx, dy, spread, blur_radius;
+
+        read_rounded_rect (record, &outline);
+        read_rgba (record, &color);
+        dx = read_float (record);
+        dy = read_float (record);
+        spread = read_float (record);
+        blur_radius = read_float (record);
+        if (record->failed)
+          return NULL;
+
+        if (node_type == GSK_INSET_SHADOW_NODE)
+          return gsk_inset_shadow_node_new (&outline, &color, dx, dy, spread, blur_radius);
+        else
+          return gsk_outset_shadow_node_new (&outline, &color, dx, dy, spread, blur_radius);
+      }
+
+    case GSK_TRANSFORM_NODE:
+      {
+        GskRenderNode *child, *result;
+        GskTransform *transform;
+        const char *string;
+
+        child = read_node (record, current);
+        string = read_string (record);
+        if (record->failed)
+          return NULL;
+
+        if (string == NULL || !gsk_transform_parse (string, &transform))
+          {
+            reader_error (record->reader, record->start, GSK_SERIALIZATION_INVALID_DATA,
+                          "Invalid transform");
+            return NULL;
+          }
+
+        result = gsk_transform_node_new (child, transform);
+        gsk_transform_unref (transform);
+
+        return result;
+      }
+
+    case GSK_OPACITY_NODE:
+      {
+        GskRenderNode *child;
+        float opacity;
+
+        child = read_node (record, current);
+        opacity = read_float (record);
+        if (record->failed)
+          return NULL;
+
+        return gsk_opacity_node_new (child, opacity);
+      }
+
+    case GSK_COLOR_MATRIX_NODE:
+      {
+        GskRenderNode *child;
+        float values[16], offset_values[4];
+        graphene_matrix_t matrix;
+        graphene_vec4_t offset;
+        guint i;
+
+        child = read_node (record, current);
+        for (i = 0; i < 16; i++)
+          values[i] = read_float (record);
+        for (i = 0; i < 4; i++)
+          offset_values[i] = read_float (record);
+        if (record->failed)
+          return NULL;
+
+        graphene_matrix_init_from_float (&matrix, values);
+        graphene_vec4_init_from_float (&offset, offset_values);
+
+        return gsk_color_matrix_node_new (child, &matrix, &offset);
+      }
+
+    case GSK_REPEAT_NODE:
+      {
+        graphene_rect_t bounds, child_bounds;
+        GskRenderNode *child;
+
+        read_rect (record, &bounds);
+        child = read_node (record, current);
+        read_rect (record, &child_bounds);
+        if (record->failed)
+          return NULL;
+
+        return gsk_repeat_node_new (&bounds, child, &child_bounds);
+      }
+
+    case GSK_CLIP_NODE:
+      {
+        GskRenderNode *child;
+        graphene_rect_t clip;
+
+        child = read_node (record, current);
+        read_rect (record, &clip);
+        if (record->failed)
+          return NULL;
+
+        return gsk_clip_node_new (child, &clip);
+      }
+
+    case GSK_ROUNDED_CLIP_NODE:
+      {
+        GskRenderNode *child;
+        GskRoundedRect clip;
+
+        child = read_node (record, current);
+        read_rounded_rect (record, &clip);
+        if (record->failed)
+          return NULL;
+
+        return gsk_rounded_clip_node_new (child, &clip);
+      }
+
+    case GSK_SHADOW_NODE:
+      {
+        GskRenderNode *child, *result;
+        GskShadow *shadows;
+        guint i, n_shadows;
+
+        child = read_node (record, current);
+        n_shadows = read_count (record, 7 * 4);
+        shadows = g_new (GskShadow, n_shadows);
+        for (i = 0; i < n_shadows; i++)
+          {
+            read_rgba (record, &shadows[i].color);
+            shadows[i].dx = read_float (record);
+            shadows[i].dy = read_float (record);
+            shadows[i].radius = read_float (record);
+          }
+
+        if (record->failed || n_shadows == 0)
+          result = NULL;
+        else
+          result = gsk_shadow_node_new (child, shadows, n_shadows);
+
+        g_free (shadows);
+
+        return result;
+      }
+
+    case GSK_BLEND_NODE:
+      {
+        GskRenderNode *bottom, *top;
+        guint32 mode;
+
+        bottom = read_node (record, current);
+        top = read_node (record, current);
+        mode = read_uint32 (record);
+        if (record->failed)
+          return NULL;
+
+        if (mode > GSK_BLEND_MODE_LUMINOSITY)
+          {
+            reader_error (record->reader, record->start, GSK_SERIALIZATION_INVALID_DATA,
+                          "Invalid blend mode %u", mode);
+            return NULL;
+          }
+
+        return gsk_blend_node_new (bottom, top, mode);
+      }
+
+    case GSK_CROSS_FADE_NODE:
+      {
+        GskRenderNode *start, *end;
+        float progress;
+
+        start = read_node (record, current);
+        end = read_node (record, current);
+        progress = read_float (record);
+        if (record->failed)
+          return NULL;
+
+        return gsk_cross_fade_node_new (start, end, progress);
+      }
+
+    case GSK_TEXT_NODE:
+      {
+        GskRenderNode *result;
+        PangoGlyphString *glyphs;
+        graphene_point_t offset;
+        const char *font_name;
+        PangoFont *font;
+        GdkRGBA color;
+        guint i, n_glyphs;
+
+        font_name = read_string (record);
+        read_rgba (record, &color);
+        read_point (record, &offset);
+        n_glyphs = read_count (record, 5 * 4);
+        glyphs = pango_glyph_string_new ();
+        pango_glyph_string_set_size (glyphs, n_glyphs);
+        for (i = 0; i < n_glyphs; i++)
+          {
+            glyphs->glyphs[i].glyph = read_uint32 (record);
+            glyphs->glyphs[i].geometry.width = read_int32 (record);
+            glyphs->glyphs[i].geometry.x_offset = read_int32 (record);
+            glyphs->glyphs[i].geometry.y_offset = read_int32 (record);
+            glyphs->glyphs[i].attr.is_cluster_start = read_uint32 (record) & 1;
+          }
+
+        if (record->failed || font_name == NULL)
+          {
+            pango_glyph_string_free (glyphs);
+            return NULL;
+          }
+
+        font = font_from_string (font_name);
+        if (font == NULL)
+          {
+            reader_error (record->reader, record->start, GSK_SERIALIZATION_INVALID_DATA,
+                          "Failed to load font \"%s\"", font_name);
+            pango_glyph_string_free (glyphs);
+            return NULL;
+          }
+
+        result = gsk_text_node_new (font, glyphs, &color, &offset);
+        if (result == NULL)
+          {
+            reader_error (record->reader, record->start, GSK_SERIALIZATION_INVALID_DATA,
+                          "Glyphs result in empty text");
+            result = gsk_container_node_new (NULL, 0);
+          }
+
+        g_object_unref (font);
+        pango_glyph_string_free (glyphs);
+
+        return result;
+      }
+
+    case GSK_BLUR_NODE:
+      {
+        GskRenderNode *child;
+        float radius;
+
+        child = read_node (record, current);
+        radius = read_float (record);
+        if (record->failed)
+          return NULL;
+
+        return gsk_blur_node_new (child, radius);
+      }
+
+    case GSK_DEBUG_NODE:
+      {
+        GskRenderNode *child;
+        const char *message;
+
+        child = read_node (record, current);
+        message = read_string (record);
+        if (record->failed)
+          return NULL;
+
+        return gsk_debug_node_new (child, g_strdup (message));
+      }
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      reader_error (record->reader, record->start, GSK_SERIALIZATION_INVALID_DATA,
+                    "Unknown node type %u", node_type);
+      return NULL;
+    }
+}
+
+/*< private >
+ * gsk_render_node_binary_check:
+ * @bytes: the data to check
+ *
+ * Checks if @bytes looks like it is in the binary format.
+ *
+ * Returns: %TRUE if @bytes starts with the binary format's magic
+ */
+gboolean
+gsk_render_node_binary_check (GBytes *bytes)
+{
+  gsize size;
+  const guchar *data = g_bytes_get_data (bytes, &size);
+
+  return size >= GSK_BINARY_MAGIC_LENGTH &&
+         memcmp (data, GSK_BINARY_MAGIC, GSK_BINARY_MAGIC_LENGTH) == 0;
+}
+
+/*< private >
+ * gsk_render_node_binary_deserialize:
+ * @bytes: data in the binary format
+ * @error_func: (nullable): callback on errors
+ * @user_data: user data for @error_func
+ *
+ * Loads a render node tree written by gsk_render_node_binary_serialize().
+ *
+ * The returned nodes may keep references to @bytes to avoid copying
+ * pixel data.
+ *
+ * Returns: (nullable) (transfer full): the loaded node or %NULL on error
+ */
+GskRenderNode *
+gsk_render_node_binary_deserialize (GBytes            *bytes,
+                                    GskParseErrorFunc  error_func,
+                                    gpointer           user_data)
+{
+  Reader reader = { NULL, };
+  GskRenderNode *result = NULL;
+  guint64 strings_offset, textures_offset, nodes_offset;
+  guint32 version, i;
+  gsize pos;
+
+  reader.bytes = bytes;
+  reader.data = g_bytes_get_data (bytes, &reader.size);
+  reader.error_func = error_func;
+  reader.user_data = user_data;
+
+  if (reader.size < GSK_BINARY_HEADER_SIZE ||
+      memcmp (reader.data, GSK_BINARY_MAGIC, GSK_BINARY_MAGIC_LENGTH) != 0)
+    {
+      reader_error (&reader, 0, GSK_SERIALIZATION_UNSUPPORTED_FORMAT,
+                    "Not a binary render node file");
+      return NULL;
+    }
+
+  version = get_uint32 (reader.data + GSK_BINARY_MAGIC_LENGTH);
+  if (version != GSK_BINARY_VERSION)
+    {
+      reader_error (&reader, GSK_BINARY_MAGIC_LENGTH, GSK_SERIALIZATION_UNSUPPORTED_VERSION,
+                    "Unsupported version %u", version);
+      return NULL;
+    }
+
+  reader.n_strings = get_uint32 (reader.data + GSK_BINARY_MAGIC_LENGTH + 4);
+  reader.n_textures = get_uint32 (reader.data + GSK_BINARY_MAGIC_LENGTH + 8);
+  reader.n_nodes = get_uint32 (reader.data + GSK_BINARY_MAGIC_LENGTH + 12);
+  strings_offset = get_uint64 (reader.data + GSK_BINARY_MAGIC_LENGTH + 16);
+  textures_offset = get_uint64 (reader.data + GSK_BINARY_MAGIC_LENGTH + 24);
+  nodes_offset = get_uint64 (reader.data + GSK_BINARY_MAGIC_LENGTH + 32);
+
+  /* All counts are checked against the space their entries need,
+   * so corrupt headers can't make us allocate huge arrays. Node
+   * records are at least 8 bytes each. */
+  if (strings_offset > reader.size ||
+      (reader.size - strings_offset) / GSK_BINARY_STRING_ENTRY_SIZE < reader.n_strings ||
+      textures_offset > reader.size ||
+      (reader.size - textures_offset) / GSK_BINARY_TEXTURE_ENTRY_SIZE < reader.n_textures ||
+      nodes_offset > reader.size ||
+      (reader.size - nodes_offset) / 8 < reader.n_nodes ||
+      reader.n_nodes == 0)
+    {
+      reader_error (&reader, GSK_BINARY_MAGIC_LENGTH, GSK_SERIALIZATION_INVALID_DATA,
+                    "Invalid header");
+      return NULL;
+    }
+
+  reader.string_table = reader.data + strings_offset;
+  reader.texture_table = reader.data + textures_offset;
+  reader.textures = g_new0 (GdkTexture *, reader.n_textures);
+  reader.nodes = g_new0 (GskRenderNode *, reader.n_nodes);
+
+  pos = nodes_offset;
+  for (i = 0; i < reader.n_nodes; i++)
+    {
+      Record record;
+      guint32 node_type, size;
+
+      if (reader.size - pos < 8)
+        {
+          reader_error (&reader, pos, GSK_SERIALIZATION_INVALID_DATA,
+                        "Unexpected end of data");
+          goto out;
+        }
+
+      node_type = get_uint32 (reader.data + pos);
+      size = get_uint32 (reader.data + pos + 4);
+      if (reader.size - pos - 8 < size)
+        {
+          reader_error (&reader, pos, GSK_SERIALIZATION_INVALID_DATA,
+                        "Node record is too long");
+          goto out;
+        }
+
+      record.reader = &reader;
+      record.start = pos;
+      record.pos = pos + 8;
+      record.end = pos + 8 + size;
+      record.failed = FALSE;
+
+      reader.nodes[i] = read_node_payload (&record, node_type, i);
+      if (reader.nodes[i] == NULL)
+        {
+          if (!reader.had_error)
+            reader_error (&reader, pos, GSK_SERIALIZATION_INVALID_DATA,
+                          "Invalid node of type %u", node_type);
+          goto out;
+        }
+
+      pos = record.end;
+    }
+
+  result = gsk_render_node_ref (reader.nodes[reader.n_nodes - 1]);
+
+out:
+  for (i = 0; i < reader.n_nodes; i++)
+    g_clear_pointer (&reader.nodes[i], gsk_render_node_unref);
+  g_free (reader.nodes);
+  for (i = 0; i < reader.n_textures; i++)
+    g_clear_object (&reader.textures[i]);
+  g_free (reader.textures);
+
+  return result;
+}
@@ -0,0 +1,17 @@
+#ifndef __GSK_RENDER_NODE_BINARY_PRIVATE_H__
+#define __GSK_RENDER_NODE_BINARY_PRIVATE_H__
+
+#include "gskrendernode.h"
+
+G_BEGIN_DECLS
+
+gboolean        gsk_render_node_binary_check            (GBytes            *bytes);
+
+GBytes *        gsk_render_node_binary_serialize        (GskRenderNode     *node);
+GskRenderNode * gsk_render_node_binary_deserialize      (GBytes            *bytes,
+                                                         GskParseErrorFunc  error_func,
+                                                         gpointer           user_data);
+
+G_END_DECLS
+
+#endif /* __GSK_RENDER_NODE_BINARY_PRIVATE_H__ */
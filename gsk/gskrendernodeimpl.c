@@ -29,6 +29,7 @@
 
 #include "gdk/gdktextureprivate.h"
 #include <cairo-ft.h>
+#include <stdlib.h>
 
 static inline void
 gsk_cairo_rectangle (cairo_t               *cr,
@@ -1752,12 +1753,28 @@ gsk_cairo_node_get_draw_context (GskRenderNode *node)
 
 /**** GSK_CONTAINER_NODE ***/
 
+/* Containers with at least this many children get a spatial
+ * index the first time they are drawn, so that partial repaints
+ * don't have to look at every child.
+ */
+#define GSK_CONTAINER_NODE_INDEX_THRESHOLD 64
+
+typedef struct
+{
+  float top;
+  float max_bottom;
+  guint idx;
+} GskContainerIndexEntry;
+
 struct _GskContainerNode
 {
   GskRenderNode render_node;
 
   guint n_children;
   GskRenderNode **children;
+
+  /* Lazily created, see gsk_container_node_get_index() */
+  GskContainerIndexEntry *index;
 };
 
 static void
@@ -1770,21 +1787,163 @@ gsk_container_node_finalize (GskRenderNode *node)
     gsk_render_node_unref (container->children[i]);
 
   g_free (container->children);
+  g_free (container->index);
 
   parent_class->finalize (node);
 }
 
+static int
+gsk_container_index_entry_compare (gconstpointer a,
+                                   gconstpointer b)
+{
+  const GskContainerIndexEntry *ea = a;
+  const GskContainerIndexEntry *eb = b;
+
+  if (ea->top < eb->top)
+    return -1;
+  else if (ea->top > eb->top)
+    return 1;
+
+  return (int) ea->idx - (int) eb->idx;
+}
+
+/* The index is the list of children sorted by their top edge.
+ * Each entry also records the largest bottom edge of itself and
+ * all entries before it, which is monotonic, so both ends of the
+ * range of children that can intersect a horizontal band can be
+ * found with a binary search.
+ */
+static const GskContainerIndexEntry *
+gsk_container_node_get_index (GskContainerNode *self)
+{
+  if (g_once_init_enter (&self->index))
+    {
+      GskContainerIndexEntry *entries;
+      float max_bottom;
+      guint i;
+
+      entries = g_new (GskContainerIndexEntry, self->n_children);
+      for (i = 0; i < self->n_children; i++)
+        {
+          const graphene_rect_t *bounds = &self->children[i]->bounds;
+
+          entries[i].top = bounds->origin.y;
+          entries[i].max_bottom = bounds->origin.y + bounds->size.height;
+          entries[i].idx = i;
+        }
+
+      qsort (entries, self->n_children, sizeof (GskContainerIndexEntry), gsk_container_index_entry_compare);
+
+      max_bottom = -G_MAXFLOAT;
+      for (i = 0; i < self->n_children; i++)
+        {
+          max_bottom = MAX (max_bottom, entries[i].max_bottom);
+          entries[i].max_bottom = max_bottom;
+        }
+
+      g_once_init_leave (&self->index, entries);
+    }
+
+  return self->index;
+}
+
+static inline gboolean
+gsk_container_node_child_is_visible (const GskRenderNode *child,
+                                     double               x1,
+                                     double               y1,
+                                     double               x2,
+                                     double               y2)
+{
+  const graphene_rect_t *bounds = &child->bounds;
+
+  return bounds->origin.x < x2 &&
+         bounds->origin.x + bounds->size.width > x1 &&
+         bounds->origin.y < y2 &&
+         bounds->origin.y + bounds->size.height > y1;
+}
+
+static int
+guint_compare (gconstpointer a,
+               gconstpointer b)
+{
+  guint ua = *(const guint *) a;
+  guint ub = *(const guint *) b;
+
+  return ua < ub ? -1 : (ua > ub ? 1 : 0);
+}
+
 static void
 gsk_container_node_draw (GskRenderNode *node,
                          cairo_t       *cr)
 {
   GskContainerNode *container = (GskContainerNode *) node;
+  const GskContainerIndexEntry *entries;
+  double x1, y1, x2, y2;
+  guint start, end, lo, hi, n_visible;
+  guint *visible;
   guint i;
 
-  for (i = 0; i < container->n_children; i++)
+  cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+  if (x1 >= x2 || y1 >= y2)
+    return;
+
+  if (container->n_children < GSK_CONTAINER_NODE_INDEX_THRESHOLD)
+    {
+      for (i = 0; i < container->n_children; i++)
+        {
+          if (gsk_container_node_child_is_visible (container->children[i], x1, y1, x2, y2))
+            gsk_render_node_draw (container->children[i], cr);
+        }
+      return;
+    }
+
+  entries = gsk_container_node_get_index (container);
+
+  /* First entry that may reach below the top of the clip */
+  lo = 0;
+  hi = container->n_children;
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (entries[mid].max_bottom > y1)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+  start = lo;
+
+  /* First entry that starts below the bottom of the clip */
+  hi = container->n_children;
+  while (lo < hi)
     {
-      gsk_render_node_draw (container->children[i], cr);
+      guint mid = lo + (hi - lo) / 2;
+
+      if (entries[mid].top >= y2)
+        hi = mid;
+      else
+        lo = mid + 1;
     }
+  end = lo;
+
+  if (start >= end)
+    return;
+
+  visible = g_new (guint, end - start);
+  n_visible = 0;
+  for (i = start; i < end; i++)
+    {
+      if (gsk_container_node_child_is_visible (container->children[entries[i].idx], x1, y1, x2, y2))
+        visible[n_visible++] = entries[i].idx;
+    }
+
+  /* Children must still be drawn in their original stacking order */
+  qsort (visible, n_visible, sizeof (guint), guint_compare);
+
+  for (i = 0; i < n_visible; i++)
+    gsk_render_node_draw (container->children[visible[i]], cr);
+
+  g_free (visible);
 }
 
 static void
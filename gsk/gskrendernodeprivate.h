@@ -7,6 +7,7 @@
 G_BEGIN_DECLS
 
 typedef struct _GskRenderNodeClass GskRenderNodeClass;
+typedef struct _GskRenderNodeArena GskRenderNodeArena;
 
 /* Keep this in sync with the GskRenderNodeType enumeration.
  *
@@ -26,6 +27,9 @@ struct _GskRenderNode
 
   gatomicrefcount ref_count;
 
+  /* The arena the node was allocated from, or %NULL */
+  GskRenderNodeArena *arena;
+
   graphene_rect_t bounds;
 };
 
@@ -85,6 +89,12 @@ GType           gsk_render_node_type_register_static    (const char
 
 gpointer        gsk_render_node_alloc                   (GskRenderNodeType            node_type);
 
+GskRenderNodeArena *
+                gsk_render_node_arena_begin             (gsize                        size_hint);
+gsize           gsk_render_node_arena_end               (GskRenderNodeArena          *arena);
+void            gsk_render_node_arena_collect_stats     (guint                       *n_nodes,
+                                                         guint                       *n_bytes);
+
 gboolean        gsk_render_node_can_diff                (const GskRenderNode         *node1,
                                                          const GskRenderNode         *node2) G_GNUC_PURE;
 void            gsk_render_node_diff                    (GskRenderNode               *node1,
@@ -34,6 +34,7 @@ typedef struct {
 } ProfileCounters;
 
 typedef struct {
+  GQuark ops_time;
   GQuark cpu_time;
   GQuark gpu_time;
 } ProfileTimers;
@@ -174,7 +175,7 @@ gsk_vulkan_renderer_render_texture (GskRenderer           *renderer,
   GdkTexture *texture;
 #ifdef G_ENABLE_DEBUG
   GskProfiler *profiler;
-  gint64 cpu_time, start_time;
+  gint64 cpu_time, ops_time, start_time;
 #endif
 
 #ifdef G_ENABLE_DEBUG
@@ -193,8 +194,17 @@ gsk_vulkan_renderer_render_texture (GskRenderer           *renderer,
 
   gsk_vulkan_render_reset (render, image, viewport, NULL);
 
+#ifdef G_ENABLE_DEBUG
+  gsk_profiler_timer_begin (profiler, self->profile_timers.ops_time);
+#endif
+
   gsk_vulkan_render_add_node (render, root);
 
+#ifdef G_ENABLE_DEBUG
+  ops_time = gsk_profiler_timer_end (profiler, self->profile_timers.ops_time);
+  gsk_profiler_timer_set (profiler, self->profile_timers.ops_time, ops_time);
+#endif
+
   gsk_vulkan_render_upload (render);
 
   gsk_vulkan_render_draw (render);
@@ -236,7 +246,7 @@ gsk_vulkan_renderer_render (GskRenderer          *renderer,
   const cairo_region_t *clip;
 #ifdef G_ENABLE_DEBUG
   GskProfiler *profiler;
-  gint64 cpu_time;
+  gint64 cpu_time, ops_time;
 #endif
 
 #ifdef G_ENABLE_DEBUG
@@ -253,8 +263,17 @@ gsk_vulkan_renderer_render (GskRenderer          *renderer,
   clip = gdk_draw_context_get_frame_region (GDK_DRAW_CONTEXT (self->vulkan));
   gsk_vulkan_render_reset (render, self->targets[gdk_vulkan_context_get_draw_index (self->vulkan)], NULL, clip);
 
+#ifdef G_ENABLE_DEBUG
+  gsk_profiler_timer_begin (profiler, self->profile_timers.ops_time);
+#endif
+
   gsk_vulkan_render_add_node (render, root);
 
+#ifdef G_ENABLE_DEBUG
+  ops_time = gsk_profiler_timer_end (profiler, self->profile_timers.ops_time);
+  gsk_profiler_timer_set (profiler, self->profile_timers.ops_time, ops_time);
+#endif
+
   gsk_vulkan_render_upload (render);
 
   gsk_vulkan_render_draw (render);
@@ -297,6 +316,7 @@ gsk_vulkan_renderer_init (GskVulkanRenderer *self)
   self->profile_counters.fallback_pixels = gsk_profiler_add_counter (profiler, "fallback-pixels", "Fallback pixels", TRUE);
   self->profile_counters.texture_pixels = gsk_profiler_add_counter (profiler, "texture-pixels", "Texture pixels", TRUE);
 
+  self->profile_timers.ops_time = gsk_profiler_add_timer (profiler, "ops-time", "Op building time", FALSE, TRUE);
   self->profile_timers.cpu_time = gsk_profiler_add_timer (profiler, "cpu-time", "CPU time", FALSE, TRUE);
   if (GSK_RENDERER_DEBUG_CHECK (GSK_RENDERER (self), SYNC))
     self->profile_timers.gpu_time = gsk_profiler_add_timer (profiler, "gpu-time", "GPU time", FALSE, TRUE);
@@ -52,7 +52,7 @@ struct _GtkCssParserBlock
   GtkCssTokenType alternative_token;
 };
 
-static GtkCssParser *
+GtkCssParser *
 gtk_css_parser_new (GtkCssTokenizer       *tokenizer,
                     GFile                 *file,
                     GFile                 *base_directory,
@@ -49,6 +49,12 @@ typedef void            (* GtkCssParserErrorFunc)               (GtkCssParser
                                                                  const GError                   *error,
                                                                  gpointer                        user_data);
 
+GtkCssParser *          gtk_css_parser_new                      (GtkCssTokenizer                *tokenizer,
+                                                                 GFile                          *file,
+                                                                 GFile                          *base_directory,
+                                                                 GtkCssParserErrorFunc           error_func,
+                                                                 gpointer                        user_data,
+                                                                 GDestroyNotify                  user_destroy);
 GtkCssParser *          gtk_css_parser_new_for_file             (GFile                          *file,
                                                                  GtkCssParserErrorFunc           error_func,
                                                                  gpointer                        user_data,
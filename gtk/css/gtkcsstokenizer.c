@@ -35,62 +35,51 @@ struct _GtkCssTokenizer
   const char            *end;
 
   GtkCssLocation         position;
+
+  /* Holds the string of the last token read, see gtk_css_token_clear() */
+  GString               *buffer;
+
+  /* Only set for precompiled token streams */
+  const char            *strings;
+  gsize                  strings_size;
 };
 
+/* Precompiled token streams, see gtk_css_tokenizer_precompile().
+ *
+ * The header is followed by a string table of NUL-terminated strings
+ * and the tokens. Every token is stored as its type, with
+ * PRECOMPILED_ERROR_FLAG set if reading it produced an error, the
+ * location after the token relative to the one after the previous
+ * token and the token's payload. Strings are stored as offsets into
+ * the string table, all other numbers as unsigned LEB128, except for
+ * doubles, which are stored as little-endian 64bit values.
+ */
+#define PRECOMPILED_MAGIC "GTKCSS\0\0"
+#define PRECOMPILED_VERSION 1
+#define PRECOMPILED_ERROR_FLAG 0x80
+
+typedef struct {
+  char magic[8];
+  guint32 version;
+  guint32 strings_size;
+  guint32 tokens_size;
+  guint32 reserved;
+} PrecompiledHeader;
+
+/*
+ * gtk_css_token_clear:
+ * @token: a #GtkCssToken
+ *
+ * Resets @token to an EOF token.
+ *
+ * Tokens do not own their strings. They point into the precompiled
+ * string table or into a buffer of the tokenizer that is reused for
+ * every token, so they are only valid until the next token is read
+ * from the same tokenizer. Use g_strdup() to keep them around.
+ */
 void
 gtk_css_token_clear (GtkCssToken *token)
 {
-  switch (token->type)
-    {
-    case GTK_CSS_TOKEN_STRING:
-    case GTK_CSS_TOKEN_IDENT:
-    case GTK_CSS_TOKEN_FUNCTION:
-    case GTK_CSS_TOKEN_AT_KEYWORD:
-    case GTK_CSS_TOKEN_HASH_UNRESTRICTED:
-    case GTK_CSS_TOKEN_HASH_ID:
-    case GTK_CSS_TOKEN_URL:
-      g_free (token->string.string);
-      break;
-
-    case GTK_CSS_TOKEN_SIGNED_INTEGER_DIMENSION:
-    case GTK_CSS_TOKEN_SIGNLESS_INTEGER_DIMENSION:
-    case GTK_CSS_TOKEN_DIMENSION:
-      g_free (token->dimension.dimension);
-      break;
-
-    default:
-      g_assert_not_reached ();
-    case GTK_CSS_TOKEN_EOF:
-    case GTK_CSS_TOKEN_WHITESPACE:
-    case GTK_CSS_TOKEN_OPEN_PARENS:
-    case GTK_CSS_TOKEN_CLOSE_PARENS:
-    case GTK_CSS_TOKEN_OPEN_SQUARE:
-    case GTK_CSS_TOKEN_CLOSE_SQUARE:
-    case GTK_CSS_TOKEN_OPEN_CURLY:
-    case GTK_CSS_TOKEN_CLOSE_CURLY:
-    case GTK_CSS_TOKEN_COMMA:
-    case GTK_CSS_TOKEN_COLON:
-    case GTK_CSS_TOKEN_SEMICOLON:
-    case GTK_CSS_TOKEN_CDC:
-    case GTK_CSS_TOKEN_CDO:
-    case GTK_CSS_TOKEN_DELIM:
-    case GTK_CSS_TOKEN_SIGNED_INTEGER:
-    case GTK_CSS_TOKEN_SIGNLESS_INTEGER:
-    case GTK_CSS_TOKEN_SIGNED_NUMBER:
-    case GTK_CSS_TOKEN_SIGNLESS_NUMBER:
-    case GTK_CSS_TOKEN_PERCENTAGE:
-    case GTK_CSS_TOKEN_INCLUDE_MATCH:
-    case GTK_CSS_TOKEN_DASH_MATCH:
-    case GTK_CSS_TOKEN_PREFIX_MATCH:
-    case GTK_CSS_TOKEN_SUFFIX_MATCH:
-    case GTK_CSS_TOKEN_SUBSTRING_MATCH:
-    case GTK_CSS_TOKEN_COLUMN:
-    case GTK_CSS_TOKEN_BAD_STRING:
-    case GTK_CSS_TOKEN_BAD_URL:
-    case GTK_CSS_TOKEN_COMMENT:
-      break;
-    }
-
   token->type = GTK_CSS_TOKEN_EOF;
 }
 
@@ -110,7 +99,7 @@ gtk_css_token_initv (GtkCssToken     *token,
     case GTK_CSS_TOKEN_HASH_UNRESTRICTED:
     case GTK_CSS_TOKEN_HASH_ID:
     case GTK_CSS_TOKEN_URL:
-      token->string.string = va_arg (args, char *);
+      token->string.string = va_arg (args, const char *);
       break;
 
     case GTK_CSS_TOKEN_DELIM:
@@ -129,7 +118,7 @@ gtk_css_token_initv (GtkCssToken     *token,
     case GTK_CSS_TOKEN_SIGNLESS_INTEGER_DIMENSION:
     case GTK_CSS_TOKEN_DIMENSION:
       token->dimension.value = va_arg (args, double);
-      token->dimension.dimension = va_arg (args, char *);
+      token->dimension.dimension = va_arg (args, const char *);
       break;
 
     default:
@@ -526,23 +515,101 @@ gtk_css_token_init (GtkCssToken     *token,
   va_end (args);
 }
 
+static gboolean
+gtk_css_tokenizer_data_is_precompiled (const char *data,
+                                       gsize       size)
+{
+  PrecompiledHeader header;
+
+  if (size < sizeof (PrecompiledHeader))
+    return FALSE;
+
+  memcpy (&header, data, sizeof (PrecompiledHeader));
+
+  if (memcmp (header.magic, PRECOMPILED_MAGIC, sizeof (header.magic)) != 0 ||
+      GUINT32_FROM_LE (header.version) != PRECOMPILED_VERSION)
+    return FALSE;
+
+  /* The string table must be terminated, so that any offset
+   * into it yields a valid string.
+   */
+  if (header.strings_size == 0 ||
+      sizeof (PrecompiledHeader) + (gsize) GUINT32_FROM_LE (header.strings_size)
+                                 + GUINT32_FROM_LE (header.tokens_size) != size ||
+      data[sizeof (PrecompiledHeader) + GUINT32_FROM_LE (header.strings_size) - 1] != '\0')
+    return FALSE;
+
+  return TRUE;
+}
+
+/*
+ * gtk_css_tokenizer_is_precompiled:
+ * @bytes: the data to check
+ *
+ * Checks if @bytes contains a token stream created with
+ * gtk_css_tokenizer_precompile() in the current format.
+ *
+ * Returns: %TRUE if @bytes is precompiled
+ */
+gboolean
+gtk_css_tokenizer_is_precompiled (GBytes *bytes)
+{
+  gsize size;
+  const char *data = g_bytes_get_data (bytes, &size);
+
+  return gtk_css_tokenizer_data_is_precompiled (data, size);
+}
+
 GtkCssTokenizer *
 gtk_css_tokenizer_new (GBytes *bytes)
 {
   GtkCssTokenizer *tokenizer;
+  gsize size;
 
   tokenizer = g_slice_new0 (GtkCssTokenizer);
   tokenizer->ref_count = 1;
   tokenizer->bytes = g_bytes_ref (bytes);
+  tokenizer->buffer = g_string_sized_new (64);
 
-  tokenizer->data = g_bytes_get_data (bytes, NULL);
-  tokenizer->end = tokenizer->data + g_bytes_get_size (bytes);
+  tokenizer->data = g_bytes_get_data (bytes, &size);
+  tokenizer->end = tokenizer->data + size;
 
   gtk_css_location_init (&tokenizer->position);
 
   return tokenizer;
 }
 
+/*
+ * gtk_css_tokenizer_new_precompiled:
+ * @bytes: a token stream created with gtk_css_tokenizer_precompile()
+ *
+ * Creates a tokenizer that replays @bytes. gtk_css_tokenizer_new()
+ * never looks for precompiled data, so this must only be used for
+ * data from a trusted source, like GTK's own cache.
+ *
+ * Returns: (nullable): a new tokenizer or %NULL if @bytes is not
+ *   a precompiled token stream in the current format
+ */
+GtkCssTokenizer *
+gtk_css_tokenizer_new_precompiled (GBytes *bytes)
+{
+  GtkCssTokenizer *tokenizer;
+  PrecompiledHeader header;
+
+  if (!gtk_css_tokenizer_is_precompiled (bytes))
+    return NULL;
+
+  tokenizer = gtk_css_tokenizer_new (bytes);
+
+  memcpy (&header, tokenizer->data, sizeof (PrecompiledHeader));
+
+  tokenizer->strings = tokenizer->data + sizeof (PrecompiledHeader);
+  tokenizer->strings_size = GUINT32_FROM_LE (header.strings_size);
+  tokenizer->data = tokenizer->strings + tokenizer->strings_size;
+
+  return tokenizer;
+}
+
 GtkCssTokenizer *
 gtk_css_tokenizer_ref (GtkCssTokenizer *tokenizer)
 {
@@ -559,6 +626,7 @@ gtk_css_tokenizer_unref (GtkCssTokenizer *tokenizer)
     return;
 
   g_bytes_unref (tokenizer->bytes);
+  g_string_free (tokenizer->buffer, TRUE);
   g_slice_free (GtkCssTokenizer, tokenizer);
 }
 
@@ -790,12 +858,102 @@ gtk_css_tokenizer_consume_char (GtkCssTokenizer *tokenizer,
     }
 }
 
+/* The functions below consume runs of characters that need no special
+ * treatment in one go instead of character by character, which is
+ * what makes up most of a stylesheet. The runs never contain newlines,
+ * so a single location update is enough.
+ */
+
+static inline gsize
+gtk_css_tokenizer_scan_blanks (GtkCssTokenizer *tokenizer)
+{
+  const char *data;
+
+  for (data = tokenizer->data; data < tokenizer->end; data++)
+    {
+      if (*data != ' ' && *data != '\t')
+        break;
+    }
+
+  return data - tokenizer->data;
+}
+
+/* Stops at '*' or non-ASCII, the caller has to handle those */
+static inline gsize
+gtk_css_tokenizer_scan_comment_text (GtkCssTokenizer *tokenizer)
+{
+  const char *data;
+
+  for (data = tokenizer->data; data < tokenizer->end; data++)
+    {
+      if (*data == '*' || is_newline (*data) || is_multibyte (*data))
+        break;
+    }
+
+  return data - tokenizer->data;
+}
+
+static void
+gtk_css_tokenizer_consume_run (GtkCssTokenizer *tokenizer,
+                               GString         *string,
+                               const char      *run_end,
+                               gsize            n_characters)
+{
+  gsize n_bytes = run_end - tokenizer->data;
+
+  if (string)
+    g_string_append_len (string, tokenizer->data, n_bytes);
+  gtk_css_tokenizer_consume (tokenizer, n_bytes, n_characters);
+}
+
+static void
+gtk_css_tokenizer_consume_name_run (GtkCssTokenizer *tokenizer,
+                                    GString         *string)
+{
+  const char *data = tokenizer->data;
+  gsize n_characters = 0;
+
+  while (data < tokenizer->end && is_name (*data))
+    {
+      data = g_utf8_next_char (data);
+      n_characters++;
+    }
+
+  /* Don't read past the end for truncated UTF-8 */
+  gtk_css_tokenizer_consume_run (tokenizer, string, MIN (data, tokenizer->end), n_characters);
+}
+
+static void
+gtk_css_tokenizer_consume_string_run (GtkCssTokenizer *tokenizer,
+                                      GString         *string,
+                                      char             quote)
+{
+  const char *data = tokenizer->data;
+  gsize n_characters = 0;
+
+  while (data < tokenizer->end &&
+         *data != quote &&
+         *data != '\\' &&
+         !is_newline (*data))
+    {
+      data = g_utf8_next_char (data);
+      n_characters++;
+    }
+
+  gtk_css_tokenizer_consume_run (tokenizer, string, MIN (data, tokenizer->end), n_characters);
+}
+
 static void
 gtk_css_tokenizer_read_whitespace (GtkCssTokenizer *tokenizer,
                                    GtkCssToken     *token)
 {
   do {
-    gtk_css_tokenizer_consume_whitespace (tokenizer);
+    gsize n = gtk_css_tokenizer_scan_blanks (tokenizer);
+
+    if (n > 0)
+      gtk_css_tokenizer_consume (tokenizer, n, n);
+    else
+      gtk_css_tokenizer_consume_newline (tokenizer);
   } while (tokenizer->data != tokenizer->end &&
            is_whitespace (*tokenizer->data));
 
@@ -840,10 +998,12 @@ gtk_css_tokenizer_read_escape (GtkCssTokenizer *tokenizer)
   return value;
 }
 
-static char *
+static const char *
 gtk_css_tokenizer_read_name (GtkCssTokenizer *tokenizer)
 {
-  GString *string = g_string_new (NULL);
+  GString *string = tokenizer->buffer;
+
+  g_string_truncate (string, 0);
 
   do {
       if (*tokenizer->data == '\\')
@@ -868,7 +1028,7 @@ gtk_css_tokenizer_read_name (GtkCssTokenizer *tokenizer)
         }
       else if (is_name (*tokenizer->data))
         {
-          gtk_css_tokenizer_consume_char (tokenizer, string);
+          gtk_css_tokenizer_consume_name_run (tokenizer, string);
         }
       else
         {
@@ -877,7 +1037,7 @@ gtk_css_tokenizer_read_name (GtkCssTokenizer *tokenizer)
     }
   while (tokenizer->data != tokenizer->end);
 
-  return g_string_free (string, FALSE);
+  return string->str;
 }
 
 static void
@@ -903,7 +1063,9 @@ gtk_css_tokenizer_read_url (GtkCssTokenizer  *tokenizer,
                             GtkCssToken      *token,
                             GError          **error)
 {
-  GString *url = g_string_new (NULL);
+  GString *url = tokenizer->buffer;
+
+  g_string_truncate (url, 0);
 
   while (tokenizer->data < tokenizer->end && is_whitespace (*tokenizer->data))
     gtk_css_tokenizer_consume_whitespace (tokenizer);
@@ -940,7 +1102,6 @@ gtk_css_tokenizer_read_url (GtkCssTokenizer  *tokenizer,
       else if (is_non_printable (*tokenizer->data))
         {
           gtk_css_tokenizer_read_bad_url (tokenizer, token);
-          g_string_free (url, TRUE);
           gtk_css_tokenizer_parse_error (error, "Nonprintable character 0x%02X in url", *tokenizer->data);
           return FALSE;
         }
@@ -950,7 +1111,6 @@ gtk_css_tokenizer_read_url (GtkCssTokenizer  *tokenizer,
         {
           gtk_css_tokenizer_read_bad_url (tokenizer, token);
           gtk_css_tokenizer_parse_error (error, "Invalid character %c in url", *tokenizer->data);
-          g_string_free (url, TRUE);
           return FALSE;
         }
       else if (gtk_css_tokenizer_has_valid_escape (tokenizer))
@@ -961,7 +1121,6 @@ gtk_css_tokenizer_read_url (GtkCssTokenizer  *tokenizer,
         {
           gtk_css_tokenizer_read_bad_url (tokenizer, token);
           gtk_css_tokenizer_parse_error (error, "Newline may not follow '\' escape character");
-          g_string_free (url, TRUE);
           return FALSE;
         }
       else
@@ -970,7 +1129,7 @@ gtk_css_tokenizer_read_url (GtkCssTokenizer  *tokenizer,
         }
     }
 
-  gtk_css_token_init (token, GTK_CSS_TOKEN_URL, g_string_free (url, FALSE));
+  gtk_css_token_init (token, GTK_CSS_TOKEN_URL, url->str);
 
   return TRUE;
 }
@@ -980,7 +1139,7 @@ gtk_css_tokenizer_read_ident_like (GtkCssTokenizer  *tokenizer,
                                    GtkCssToken      *token,
                                    GError          **error)
 {
-  char *name = gtk_css_tokenizer_read_name (tokenizer);
+  const char *name = gtk_css_tokenizer_read_name (tokenizer);
 
   if (*tokenizer->data == '(')
     {
@@ -993,10 +1152,7 @@ gtk_css_tokenizer_read_ident_like (GtkCssTokenizer  *tokenizer,
             data++;
 
           if (*data != '"' && *data != '\'')
-            {
-              g_free (name);
-              return gtk_css_tokenizer_read_url (tokenizer, token, error);
-            }
+            return gtk_css_tokenizer_read_url (tokenizer, token, error);
         }
 
       gtk_css_token_init (token, GTK_CSS_TOKEN_FUNCTION, name);
@@ -1154,9 +1310,10 @@ gtk_css_tokenizer_read_string (GtkCssTokenizer  *tokenizer,
                                GtkCssToken      *token,
                                GError          **error)
 {
-  GString *string = g_string_new (NULL);
+  GString *string = tokenizer->buffer;
   char end = *tokenizer->data;
 
+  g_string_truncate (string, 0);
   gtk_css_tokenizer_consume_ascii (tokenizer);
 
   while (tokenizer->data < tokenizer->end)
@@ -1185,18 +1342,17 @@ gtk_css_tokenizer_read_string (GtkCssTokenizer  *tokenizer,
         }
       else if (is_newline (*tokenizer->data))
         {
-          g_string_free (string, TRUE);
           gtk_css_token_init (token, GTK_CSS_TOKEN_BAD_STRING);
           gtk_css_tokenizer_parse_error (error, "Newlines inside strings must be escaped");
           return FALSE;
         }
       else
         {
-          gtk_css_tokenizer_consume_char (tokenizer, string);
+          gtk_css_tokenizer_consume_string_run (tokenizer, string, end);
         }
     }
   
-  gtk_css_token_init (token, GTK_CSS_TOKEN_STRING, g_string_free (string, FALSE));
+  gtk_css_token_init (token, GTK_CSS_TOKEN_STRING, string->str);
 
   return TRUE;
 }
@@ -1210,6 +1366,14 @@ gtk_css_tokenizer_read_comment (GtkCssTokenizer  *tokenizer,
 
   while (tokenizer->data < tokenizer->end)
     {
+      gsize n = gtk_css_tokenizer_scan_comment_text (tokenizer);
+
+      if (n > 0)
+        {
+          gtk_css_tokenizer_consume (tokenizer, n, n);
+          continue;
+        }
+
       if (gtk_css_tokenizer_remaining (tokenizer) > 1 &&
           tokenizer->data[0] == '*' && tokenizer->data[1] == '/')
         {
@@ -1241,6 +1405,10 @@ gtk_css_tokenizer_read_match (GtkCssTokenizer *tokenizer,
     }
 }
 
+static gboolean gtk_css_tokenizer_read_precompiled_token (GtkCssTokenizer  *tokenizer,
+                                                          GtkCssToken      *token,
+                                                          GError          **error);
+
 gboolean
 gtk_css_tokenizer_read_token (GtkCssTokenizer  *tokenizer,
                               GtkCssToken      *token,
@@ -1252,6 +1420,9 @@ gtk_css_tokenizer_read_token (GtkCssTokenizer  *tokenizer,
       return TRUE;
     }
 
+  if (tokenizer->strings)
+    return gtk_css_tokenizer_read_precompiled_token (tokenizer, token, error);
+
   if (tokenizer->data[0] == '/' && gtk_css_tokenizer_remaining (tokenizer) > 1 &&
       tokenizer->data[1] == '*')
     return gtk_css_tokenizer_read_comment (tokenizer, token, error);
@@ -1443,3 +1614,368 @@ gtk_css_tokenizer_read_token (GtkCssTokenizer  *tokenizer,
     }
 }
 
+/*** PRECOMPILED TOKEN STREAMS ***/
+
+static void
+precompile_varint (GByteArray *array,
+                   guint64     value)
+{
+  do
+    {
+      guint8 byte = value & 0x7F;
+
+      value >>= 7;
+      if (value)
+        byte |= 0x80;
+
+      g_byte_array_append (array, &byte, 1);
+    }
+  while (value);
+}
+
+static void
+precompile_double (GByteArray *array,
+                   double      value)
+{
+  guint64 bits;
+
+  memcpy (&bits, &value, sizeof (bits));
+  bits = GUINT64_TO_LE (bits);
+  g_byte_array_append (array, (const guint8 *) &bits, sizeof (bits));
+}
+
+static void
+precompile_string (GByteArray *array,
+                   GHashTable *strings,
+                   GString    *string_table,
+                   const char *string)
+{
+  gpointer offset;
+
+  if (!g_hash_table_lookup_extended (strings, string, NULL, &offset))
+    {
+      offset = GSIZE_TO_POINTER (string_table->len);
+      g_string_append_len (string_table, string, strlen (string) + 1);
+      g_hash_table_insert (strings, g_strdup (string), offset);
+    }
+
+  precompile_varint (array, GPOINTER_TO_SIZE (offset));
+}
+
+/*
+ * gtk_css_tokenizer_precompile:
+ * @bytes: CSS text
+ *
+ * Tokenizes all of @bytes and returns the result in a binary form
+ * that gtk_css_tokenizer_new_precompiled() can replay without looking
+ * at the text again. The replayed tokenizer produces the same tokens, errors
+ * and locations as one created for @bytes.
+ *
+ * Returns: the precompiled token stream
+ */
+GBytes *
+gtk_css_tokenizer_precompile (GBytes *bytes)
+{
+  GtkCssTokenizer *tokenizer;
+  GtkCssLocation previous;
+  PrecompiledHeader header;
+  GByteArray *tokens;
+  GHashTable *strings;
+  GString *result;
+
+  tokenizer = gtk_css_tokenizer_new (bytes);
+  tokens = g_byte_array_new ();
+  strings = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  /* The string table, the header is prepended at the end.
+   * Offset 0 is the empty string.
+   */
+  result = g_string_new (NULL);
+  g_string_append_len (result, "", 1);
+  g_hash_table_insert (strings, g_strdup (""), GSIZE_TO_POINTER (0));
+
+  previous = tokenizer->position;
+
+  while (TRUE)
+    {
+      GtkCssToken token;
+      GError *error = NULL;
+      const GtkCssLocation *location;
+      guint8 type;
+
+      if (!gtk_css_tokenizer_read_token (tokenizer, &token, &error))
+        type = token.type | PRECOMPILED_ERROR_FLAG;
+      else
+        type = token.type;
+
+      if (token.type == GTK_CSS_TOKEN_EOF && error == NULL)
+        {
+          gtk_css_token_clear (&token);
+          break;
+        }
+
+      g_byte_array_append (tokens, &type, 1);
+
+      location = gtk_css_tokenizer_get_location (tokenizer);
+      precompile_varint (tokens, location->bytes - previous.bytes);
+      precompile_varint (tokens, location->chars - previous.chars);
+      precompile_varint (tokens, location->lines - previous.lines);
+      precompile_varint (tokens, location->line_bytes);
+      precompile_varint (tokens, location->line_chars);
+      previous = *location;
+
+      switch (token.type)
+        {
+        case GTK_CSS_TOKEN_STRING:
+        case GTK_CSS_TOKEN_IDENT:
+        case GTK_CSS_TOKEN_FUNCTION:
+        case GTK_CSS_TOKEN_AT_KEYWORD:
+        case GTK_CSS_TOKEN_HASH_UNRESTRICTED:
+        case GTK_CSS_TOKEN_HASH_ID:
+        case GTK_CSS_TOKEN_URL:
+          precompile_string (tokens, strings, result, token.string.string);
+          break;
+
+        case GTK_CSS_TOKEN_DELIM:
+          precompile_varint (tokens, token.delim.delim);
+          break;
+
+        case GTK_CSS_TOKEN_SIGNED_INTEGER:
+        case GTK_CSS_TOKEN_SIGNLESS_INTEGER:
+        case GTK_CSS_TOKEN_SIGNED_NUMBER:
+        case GTK_CSS_TOKEN_SIGNLESS_NUMBER:
+        case GTK_CSS_TOKEN_PERCENTAGE:
+          precompile_double (tokens, token.number.number);
+          break;
+
+        case GTK_CSS_TOKEN_SIGNED_INTEGER_DIMENSION:
+        case GTK_CSS_TOKEN_SIGNLESS_INTEGER_DIMENSION:
+        case GTK_CSS_TOKEN_DIMENSION:
+          precompile_double (tokens, token.dimension.value);
+          precompile_string (tokens, strings, result, token.dimension.dimension);
+          break;
+
+        default:
+          g_assert_not_reached ();
+        case GTK_CSS_TOKEN_EOF:
+        case GTK_CSS_TOKEN_WHITESPACE:
+        case GTK_CSS_TOKEN_OPEN_PARENS:
+        case GTK_CSS_TOKEN_CLOSE_PARENS:
+        case GTK_CSS_TOKEN_OPEN_SQUARE:
+        case GTK_CSS_TOKEN_CLOSE_SQUARE:
+        case GTK_CSS_TOKEN_OPEN_CURLY:
+        case GTK_CSS_TOKEN_CLOSE_CURLY:
+        case GTK_CSS_TOKEN_COMMA:
+        case GTK_CSS_TOKEN_COLON:
+        case GTK_CSS_TOKEN_SEMICOLON:
+        case GTK_CSS_TOKEN_CDC:
+        case GTK_CSS_TOKEN_CDO:
+        case GTK_CSS_TOKEN_INCLUDE_MATCH:
+        case GTK_CSS_TOKEN_DASH_MATCH:
+        case GTK_CSS_TOKEN_PREFIX_MATCH:
+        case GTK_CSS_TOKEN_SUFFIX_MATCH:
+        case GTK_CSS_TOKEN_SUBSTRING_MATCH:
+        case GTK_CSS_TOKEN_COLUMN:
+        case GTK_CSS_TOKEN_BAD_STRING:
+        case GTK_CSS_TOKEN_BAD_URL:
+        case GTK_CSS_TOKEN_COMMENT:
+          break;
+        }
+
+      if (error)
+        {
+          precompile_string (tokens, strings, result, error->message);
+          g_error_free (error);
+        }
+
+      gtk_css_token_clear (&token);
+    }
+
+  memset (&header, 0, sizeof (PrecompiledHeader));
+  memcpy (header.magic, PRECOMPILED_MAGIC, sizeof (header.magic));
+  header.version = GUINT32_TO_LE (PRECOMPILED_VERSION);
+  header.strings_size = GUINT32_TO_LE (result->len);
+  header.tokens_size = GUINT32_TO_LE (tokens->len);
+
+  g_string_prepend_len (result, (const char *) &header, sizeof (PrecompiledHeader));
+  g_string_append_len (result, (const char *) tokens->data, tokens->len);
+
+  g_byte_array_unref (tokens);
+  g_hash_table_unref (strings);
+  gtk_css_tokenizer_unref (tokenizer);
+
+  return g_string_free_to_bytes (result);
+}
+
+static gboolean
+read_varint (GtkCssTokenizer *tokenizer,
+             guint64         *value)
+{
+  guint shift = 0;
+
+  *value = 0;
+
+  while (tokenizer->data < tokenizer->end && shift < 64)
+    {
+      guint8 byte = *tokenizer->data++;
+
+      *value |= ((guint64) (byte & 0x7F)) << shift;
+      if ((byte & 0x80) == 0)
+        return TRUE;
+
+      shift += 7;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+read_double (GtkCssTokenizer *tokenizer,
+             double          *value)
+{
+  guint64 bits;
+
+  if (tokenizer->end - tokenizer->data < (gssize) sizeof (bits))
+    return FALSE;
+
+  memcpy (&bits, tokenizer->data, sizeof (bits));
+  bits = GUINT64_FROM_LE (bits);
+  memcpy (value, &bits, sizeof (bits));
+  tokenizer->data += sizeof (bits);
+
+  return TRUE;
+}
+
+static const char *
+read_string (GtkCssTokenizer *tokenizer)
+{
+  guint64 offset;
+
+  if (!read_varint (tokenizer, &offset) || offset >= tokenizer->strings_size)
+    return NULL;
+
+  return tokenizer->strings + offset;
+}
+
+static gboolean
+gtk_css_tokenizer_read_precompiled_token (GtkCssTokenizer  *tokenizer,
+                                          GtkCssToken      *token,
+                                          GError          **error)
+{
+  guint64 bytes, chars, lines, line_bytes, line_chars;
+  GtkCssTokenType type;
+  const char *string;
+  gboolean has_error;
+  guint64 delim;
+  double number;
+  guint8 byte;
+
+  byte = (guint8) *tokenizer->data++;
+  has_error = (byte & PRECOMPILED_ERROR_FLAG) != 0;
+  type = byte & ~PRECOMPILED_ERROR_FLAG;
+
+  if (type > GTK_CSS_TOKEN_DIMENSION ||
+      !read_varint (tokenizer, &bytes) ||
+      !read_varint (tokenizer, &chars) ||
+      !read_varint (tokenizer, &lines) ||
+      !read_varint (tokenizer, &line_bytes) ||
+      !read_varint (tokenizer, &line_chars))
+    goto corrupt;
+
+  switch (type)
+    {
+    case GTK_CSS_TOKEN_STRING:
+    case GTK_CSS_TOKEN_IDENT:
+    case GTK_CSS_TOKEN_FUNCTION:
+    case GTK_CSS_TOKEN_AT_KEYWORD:
+    case GTK_CSS_TOKEN_HASH_UNRESTRICTED:
+    case GTK_CSS_TOKEN_HASH_ID:
+    case GTK_CSS_TOKEN_URL:
+      string = read_string (tokenizer);
+      if (string == NULL)
+        goto corrupt;
+      gtk_css_token_init (token, type, string);
+      break;
+
+    case GTK_CSS_TOKEN_DELIM:
+      if (!read_varint (tokenizer, &delim) || delim > G_MAXUINT32)
+        goto corrupt;
+      gtk_css_token_init (token, type, (gunichar) delim);
+      break;
+
+    case GTK_CSS_TOKEN_SIGNED_INTEGER:
+    case GTK_CSS_TOKEN_SIGNLESS_INTEGER:
+    case GTK_CSS_TOKEN_SIGNED_NUMBER:
+    case GTK_CSS_TOKEN_SIGNLESS_NUMBER:
+    case GTK_CSS_TOKEN_PERCENTAGE:
+      if (!read_double (tokenizer, &number))
+        goto corrupt;
+      gtk_css_token_init (token, type, number);
+      break;
+
+    case GTK_CSS_TOKEN_SIGNED_INTEGER_DIMENSION:
+    case GTK_CSS_TOKEN_SIGNLESS_INTEGER_DIMENSION:
+    case GTK_CSS_TOKEN_DIMENSION:
+      if (!read_double (tokenizer, &number))
+        goto corrupt;
+      string = read_string (tokenizer);
+      if (string == NULL)
+        goto corrupt;
+      gtk_css_token_init (token, type, number, string);
+      break;
+
+    default:
+    case GTK_CSS_TOKEN_EOF:
+    case GTK_CSS_TOKEN_WHITESPACE:
+    case GTK_CSS_TOKEN_OPEN_PARENS:
+    case GTK_CSS_TOKEN_CLOSE_PARENS:
+    case GTK_CSS_TOKEN_OPEN_SQUARE:
+    case GTK_CSS_TOKEN_CLOSE_SQUARE:
+    case GTK_CSS_TOKEN_OPEN_CURLY:
+    case GTK_CSS_TOKEN_CLOSE_CURLY:
+    case GTK_CSS_TOKEN_COMMA:
+    case GTK_CSS_TOKEN_COLON:
+    case GTK_CSS_TOKEN_SEMICOLON:
+    case GTK_CSS_TOKEN_CDC:
+    case GTK_CSS_TOKEN_CDO:
+    case GTK_CSS_TOKEN_INCLUDE_MATCH:
+    case GTK_CSS_TOKEN_DASH_MATCH:
+    case GTK_CSS_TOKEN_PREFIX_MATCH:
+    case GTK_CSS_TOKEN_SUFFIX_MATCH:
+    case GTK_CSS_TOKEN_SUBSTRING_MATCH:
+    case GTK_CSS_TOKEN_COLUMN:
+    case GTK_CSS_TOKEN_BAD_STRING:
+    case GTK_CSS_TOKEN_BAD_URL:
+    case GTK_CSS_TOKEN_COMMENT:
+      gtk_css_token_init (token, type);
+      break;
+    }
+
+  tokenizer->position.bytes += bytes;
+  tokenizer->position.chars += chars;
+  tokenizer->position.lines += lines;
+  tokenizer->position.line_bytes = line_bytes;
+  tokenizer->position.line_chars = line_chars;
+
+  if (has_error)
+    {
+      string = read_string (tokenizer);
+      if (string == NULL)
+        {
+          gtk_css_token_clear (token);
+          goto corrupt;
+        }
+
+      g_set_error_literal (error, GTK_CSS_PARSER_ERROR, GTK_CSS_PARSER_ERROR_SYNTAX, string);
+      return FALSE;
+    }
+
+  return TRUE;
+
+corrupt:
+  tokenizer->data = tokenizer->end;
+  gtk_css_token_init (token, GTK_CSS_TOKEN_EOF);
+  g_set_error_literal (error, GTK_CSS_PARSER_ERROR, GTK_CSS_PARSER_ERROR_SYNTAX,
+                       "Precompiled CSS data is corrupt");
+  return FALSE;
+}
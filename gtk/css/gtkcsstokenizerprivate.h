@@ -80,7 +80,7 @@ typedef struct _GtkCssDimensionToken GtkCssDimensionToken;
 
 struct _GtkCssStringToken {
   GtkCssTokenType  type;
-  char            *string;
+  const char      *string;
 };
 
 struct _GtkCssDelimToken {
@@ -96,7 +96,7 @@ struct _GtkCssNumberToken {
 struct _GtkCssDimensionToken {
   GtkCssTokenType  type;
   double           value;
-  char            *dimension;
+  const char      *dimension;
 };
 
 union _GtkCssToken {
@@ -125,6 +125,10 @@ void                    gtk_css_token_print                     (const GtkCssTok
 char *                  gtk_css_token_to_string                 (const GtkCssToken      *token);
 
 GtkCssTokenizer *       gtk_css_tokenizer_new                   (GBytes                 *bytes);
+GtkCssTokenizer *       gtk_css_tokenizer_new_precompiled       (GBytes                 *bytes);
+
+GBytes *                gtk_css_tokenizer_precompile            (GBytes                 *bytes);
+gboolean                gtk_css_tokenizer_is_precompiled        (GBytes                 *bytes);
 
 GtkCssTokenizer *       gtk_css_tokenizer_ref                   (GtkCssTokenizer        *tokenizer);
 void                    gtk_css_tokenizer_unref                 (GtkCssTokenizer        *tokenizer);
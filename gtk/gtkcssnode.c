@@ -21,6 +21,9 @@
 
 #include "gtkcssstaticstyleprivate.h"
 #include "gtkcssanimatedstyleprivate.h"
+#include "gtkcsslookupprivate.h"
+#include "gtkcssproviderprivate.h"
+#include "gtkcssstatsprivate.h"
 #include "gtkcssstylepropertyprivate.h"
 #include "gtkintl.h"
 #include "gtkmarshalers.h"
@@ -28,6 +31,9 @@
 #include "gtktypebuiltins.h"
 #include "gtkprivate.h"
 #include "gdkprofilerprivate.h"
+#include "gdk/gdkparalleltaskprivate.h"
+
+#include <string.h>
 
 /*
  * CSS nodes are the backbone of the GtkStyleContext implementation and
@@ -124,10 +130,48 @@ gtk_css_node_get_style_provider_or_null (GtkCssNode *cssnode)
   return GTK_CSS_NODE_GET_CLASS (cssnode)->get_style_provider (cssnode);
 }
 
-static int invalidated_nodes;
-static int created_styles;
-static guint invalidated_nodes_counter;
-static guint created_styles_counter;
+/* Parallel validation
+ *
+ * Finding the declarations that apply to a node only depends on the
+ * node tree and the style providers, not on any computed styles. So
+ * when a lot of nodes need new styles, like after a theme change, we
+ * do all these lookups on a thread pool before validating.
+ * Computing the values and emitting ::style-changed still happens in
+ * order on the main thread, using the results of the lookups.
+ *
+ * This is opt-in via GTK_CSS_PARALLEL=1.
+ */
+#define PARALLEL_VALIDATION_MIN_NODES 512
+#define PARALLEL_VALIDATION_CHUNK_SIZE 64
+
+typedef struct {
+  guint id;
+  GtkCssSection *section;
+  GtkCssValue *value;
+} PrecomputedValue;
+
+typedef struct {
+  GtkCssNode *node;
+  GtkStyleProvider *provider;
+  GtkCssChange change;
+  guint has_change : 1;
+  guint n_values;
+  PrecomputedValue *values;
+} PrecomputedLookup;
+
+typedef struct {
+  GArray *lookups;
+  int next_chunk;
+} PrecomputeTask;
+
+/* node => PrecomputedLookup, while validating in parallel mode */
+static GHashTable *precomputed_lookups;
+
+/* Incremented whenever something changes that may affect selector
+ * matching, which makes all precomputed lookups stale.
+ */
+static guint tree_serial;
+static guint precomputed_serial;
 
 static void
 gtk_css_node_set_invalid (GtkCssNode *node,
@@ -139,7 +183,7 @@ gtk_css_node_set_invalid (GtkCssNode *node,
   node->invalid = invalid;
 
   if (invalid)
-    invalidated_nodes++;
+    gtk_css_stats_add (GTK_CSS_STAT_INVALIDATED_NODES, 1);
 
   if (node->visible)
     {
@@ -325,7 +369,12 @@ lookup_in_global_parent_cache (GtkCssNode                  *node,
                                                  gtk_css_node_is_first_child (node),
                                                  gtk_css_node_is_last_child (node));
   if (node->cache == NULL)
-    return NULL;
+    {
+      gtk_css_stats_add (GTK_CSS_STAT_STYLE_CACHE_MISSES, 1);
+      return NULL;
+    }
+
+  gtk_css_stats_add (GTK_CSS_STAT_STYLE_CACHE_HITS, 1);
 
   return gtk_css_node_style_cache_get_style (node->cache);
 }
@@ -355,14 +404,41 @@ store_in_global_parent_cache (GtkCssNode                  *node,
                                                  style);
 }
 
+static const PrecomputedLookup *
+gtk_css_node_get_precomputed_lookup (GtkCssNode       *cssnode,
+                                     GtkStyleProvider *provider,
+                                     GtkCssChange      style_change)
+{
+  const PrecomputedLookup *precomputed;
+
+  if (precomputed_lookups == NULL ||
+      precomputed_serial != tree_serial)
+    return NULL;
+
+  precomputed = g_hash_table_lookup (precomputed_lookups, cssnode);
+  if (precomputed == NULL ||
+      precomputed->provider != provider ||
+      (style_change == 0 && !precomputed->has_change))
+    return NULL;
+
+  return precomputed;
+}
+
 static GtkCssStyle *
 gtk_css_node_create_style (GtkCssNode                   *cssnode,
                            const GtkCountingBloomFilter *filter,
                            GtkCssChange                  change)
 {
   const GtkCssNodeDeclaration *decl;
+  const PrecomputedLookup *precomputed;
+  GtkStyleProvider *provider;
+  GtkCssStaticStyle *previous;
   GtkCssStyle *style;
   GtkCssChange style_change;
+  GtkCssValueGroups changed_groups;
+  GtkCssLookup lookup;
+  gint64 before = 0;
+  gboolean timing;
 
   decl = gtk_css_node_get_declaration (cssnode);
 
@@ -370,22 +446,86 @@ gtk_css_node_create_style (GtkCssNode                   *cssnode,
   if (style)
     return g_object_ref (style);
 
-  created_styles++;
+  gtk_css_stats_add (GTK_CSS_STAT_CREATED_STYLES, 1);
+
+  provider = gtk_css_node_get_style_provider (cssnode);
 
   if (change & GTK_CSS_CHANGE_NEEDS_RECOMPUTE)
     {
       /* Need to recompute the change flags */
       style_change = 0;
+      previous = NULL;
+      changed_groups = GTK_CSS_VALUE_GROUPS_ALL;
+    }
+  else
+    {
+      previous = gtk_css_style_get_static_style (cssnode->style);
+      style_change = gtk_css_static_style_get_change (previous);
+
+      if (GTK_CSS_STYLE (previous) == gtk_css_static_style_get_default ())
+        {
+          /* Not computed for this node */
+          previous = NULL;
+          changed_groups = GTK_CSS_VALUE_GROUPS_ALL;
+        }
+      else
+        {
+          /* Only values set by rules whose matching depends on what
+           * changed can be different, and inherited values when the
+           * parent changed */
+          changed_groups = gtk_style_provider_get_change_groups (provider, change);
+          if (change & GTK_CSS_CHANGE_PARENT_STYLE)
+            changed_groups |= GTK_CSS_VALUE_GROUPS_INHERITED;
+        }
+    }
+
+  timing = gtk_css_stats_get_timing ();
+  if (timing)
+    before = g_get_monotonic_time ();
+
+  _gtk_css_lookup_init (&lookup);
+
+  precomputed = gtk_css_node_get_precomputed_lookup (cssnode, provider, style_change);
+  if (precomputed)
+    {
+      guint i;
+
+      for (i = 0; i < precomputed->n_values; i++)
+        _gtk_css_lookup_set (&lookup,
+                             precomputed->values[i].id,
+                             precomputed->values[i].section,
+                             precomputed->values[i].value);
+
+      if (style_change == 0)
+        style_change = precomputed->change;
     }
   else
     {
-      style_change = gtk_css_static_style_get_change (gtk_css_style_get_static_style (cssnode->style));
+      gtk_style_provider_lookup (provider,
+                                 filter,
+                                 cssnode,
+                                 &lookup,
+                                 style_change == 0 ? &style_change : NULL);
+    }
+
+  if (timing)
+    {
+      gint64 after = g_get_monotonic_time ();
+      gtk_css_stats_add (GTK_CSS_STAT_LOOKUP_TIME, after - before);
+      before = after;
     }
 
-  style = gtk_css_static_style_new_compute (gtk_css_node_get_style_provider (cssnode),
-                                            filter,
-                                            cssnode,
-                                            style_change);
+  style = gtk_css_static_style_new_compute_for_lookup (provider,
+                                                       &lookup,
+                                                       cssnode,
+                                                       style_change,
+                                                       previous,
+                                                       changed_groups);
+
+  _gtk_css_lookup_destroy (&lookup);
+
+  if (timing)
+    gtk_css_stats_add (GTK_CSS_STAT_COMPUTE_TIME, g_get_monotonic_time () - before);
 
   store_in_global_parent_cache (cssnode, decl, style);
 
@@ -422,6 +562,8 @@ gtk_css_node_real_update_style (GtkCssNode                   *cssnode,
                                 GtkCssStyle                  *style)
 {
   GtkCssStyle *static_style, *new_static_style, *new_style;
+  gint64 before = 0;
+  gboolean timing;
 
   static_style = GTK_CSS_STYLE (gtk_css_style_get_static_style (style));
 
@@ -430,6 +572,10 @@ gtk_css_node_real_update_style (GtkCssNode                   *cssnode,
   else
     new_static_style = g_object_ref (static_style);
 
+  timing = gtk_css_stats_get_timing ();
+  if (timing)
+    before = g_get_monotonic_time ();
+
   if (new_static_style != static_style || (change & GTK_CSS_CHANGE_ANIMATIONS))
     {
       GtkCssNode *parent = gtk_css_node_get_parent (cssnode);
@@ -452,10 +598,18 @@ gtk_css_node_real_update_style (GtkCssNode                   *cssnode,
   else
     {
       new_style = g_object_ref (style);
+      timing = FALSE;
     }
 
+  if (timing)
+    gtk_css_stats_add (GTK_CSS_STAT_ANIMATION_TIME, g_get_monotonic_time () - before);
+
   if (!gtk_css_style_is_static (new_style))
-    gtk_css_node_set_invalid (cssnode, TRUE);
+    {
+      if (new_style != style)
+        gtk_css_stats_add (GTK_CSS_STAT_ANIMATED_STYLES, 1);
+      gtk_css_node_set_invalid (cssnode, TRUE);
+    }
 
   g_object_unref (new_static_style);
 
@@ -626,12 +780,6 @@ gtk_css_node_class_init (GtkCssNodeClass *klass)
                           | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
 
   g_object_class_install_properties (object_class, NUM_PROPERTIES, cssnode_properties);
-
-  if (invalidated_nodes_counter == 0)
-    {
-      invalidated_nodes_counter = gdk_profiler_define_int_counter ("invalidated-nodes", "CSS Node Invalidations");
-      created_styles_counter = gdk_profiler_define_int_counter ("created-styles", "CSS Style Creations");
-    }
 }
 
 static void
@@ -721,6 +869,8 @@ gtk_css_node_reposition (GtkCssNode *node,
   /* Take a reference here so the whole function has a reference */
   g_object_ref (node);
 
+  tree_serial++;
+
   if (node->visible)
     {
       if (node->next_sibling)
@@ -1036,6 +1186,8 @@ gtk_css_node_set_visible (GtkCssNode *cssnode,
   cssnode->visible = visible;
   g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_VISIBLE]);
 
+  tree_serial++;
+
   if (cssnode->invalid)
     {
       if (cssnode->visible)
@@ -1097,6 +1249,7 @@ gtk_css_node_set_name (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_set_name (&cssnode->decl, name))
     {
+      tree_serial++;
       gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_NAME);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_NAME]);
     }
@@ -1114,6 +1267,7 @@ gtk_css_node_set_id (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_set_id (&cssnode->decl, id))
     {
+      tree_serial++;
       gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_ID);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_ID]);
     }
@@ -1135,6 +1289,7 @@ gtk_css_node_set_state (GtkCssNode    *cssnode,
 
   if (gtk_css_node_declaration_set_state (&cssnode->decl, state_flags))
     {
+      tree_serial++;
       GtkStateFlags states = old_state ^ state_flags;
       GtkCssChange change = 0;
 
@@ -1168,6 +1323,7 @@ gtk_css_node_clear_classes (GtkCssNode *cssnode)
 {
   if (gtk_css_node_declaration_clear_classes (&cssnode->decl))
     {
+      tree_serial++;
       gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
@@ -1219,6 +1375,7 @@ gtk_css_node_add_class (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_add_class (&cssnode->decl, style_class))
     {
+      tree_serial++;
       gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
@@ -1230,6 +1387,7 @@ gtk_css_node_remove_class (GtkCssNode *cssnode,
 {
   if (gtk_css_node_declaration_remove_class (&cssnode->decl, style_class))
     {
+      tree_serial++;
       gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_CLASS);
       g_object_notify_by_pspec (G_OBJECT (cssnode), cssnode_properties[PROP_CLASSES]);
     }
@@ -1260,6 +1418,7 @@ gtk_css_node_invalidate_style_provider (GtkCssNode *cssnode)
 {
   GtkCssNode *child;
 
+  tree_serial++;
   gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_SOURCE);
 
   for (child = cssnode->first_child;
@@ -1359,10 +1518,212 @@ gtk_css_node_validate_internal (GtkCssNode             *cssnode,
     gtk_css_node_declaration_remove_bloom_hashes (cssnode->decl, filter);
 }
 
+static gboolean
+gtk_css_node_use_parallel_validation (void)
+{
+  static int use_parallel = -1;
+
+  if (use_parallel < 0)
+    use_parallel = g_strcmp0 (g_getenv ("GTK_CSS_PARALLEL"), "1") == 0;
+
+  return use_parallel;
+}
+
+/* Collects the nodes that gtk_css_node_validate_internal() will most
+ * likely create a new style for.
+ */
+static void
+gtk_css_node_collect_lookups (GtkCssNode *cssnode,
+                              GArray     *lookups)
+{
+  GtkCssNode *child;
+
+  if (!cssnode->invalid)
+    return;
+
+  if (cssnode->style_is_invalid &&
+      gtk_css_style_needs_recreation (GTK_CSS_STYLE (gtk_css_style_get_static_style (cssnode->style)),
+                                      cssnode->pending_changes))
+    {
+      PrecomputedLookup *precomputed;
+
+      g_array_set_size (lookups, lookups->len + 1);
+      precomputed = &g_array_index (lookups, PrecomputedLookup, lookups->len - 1);
+      precomputed->node = cssnode;
+      precomputed->provider = gtk_css_node_get_style_provider (cssnode);
+      precomputed->has_change = (cssnode->pending_changes & GTK_CSS_CHANGE_NEEDS_RECOMPUTE) != 0;
+    }
+
+  for (child = gtk_css_node_get_first_child (cssnode);
+       child;
+       child = gtk_css_node_get_next_sibling (child))
+    {
+      if (child->visible)
+        gtk_css_node_collect_lookups (child, lookups);
+    }
+}
+
+/* Runs in a worker thread, so it must only read the node tree */
+static void
+gtk_css_node_precompute_lookup (PrecomputedLookup            *precomputed,
+                                const GtkCountingBloomFilter *filter)
+{
+  GtkCssLookup lookup;
+  guint id, n;
+
+  _gtk_css_lookup_init (&lookup);
+
+  gtk_style_provider_lookup (precomputed->provider,
+                             filter,
+                             precomputed->node,
+                             &lookup,
+                             precomputed->has_change ? &precomputed->change : NULL);
+
+  precomputed->values = g_new (PrecomputedValue, GTK_CSS_PROPERTY_N_PROPERTIES);
+
+  for (id = 0, n = 0; id < GTK_CSS_PROPERTY_N_PROPERTIES; id++)
+    {
+      if (lookup.values[id].value == NULL)
+        continue;
+
+      precomputed->values[n].id = id;
+      precomputed->values[n].section = lookup.values[id].section;
+      precomputed->values[n].value = lookup.values[id].value;
+      n++;
+    }
+
+  precomputed->n_values = n;
+  precomputed->values = g_renew (PrecomputedValue, precomputed->values, n);
+
+  _gtk_css_lookup_destroy (&lookup);
+}
+
+static void
+gtk_css_node_precompute_task (gpointer data)
+{
+  PrecomputeTask *task = data;
+  GtkCountingBloomFilter filter;
+  GtkCssNode *filter_parent = NULL;
+  gboolean have_filter = FALSE;
+  guint i, start, end;
+
+  for (;;)
+    {
+      start = g_atomic_int_add (&task->next_chunk, 1) * PARALLEL_VALIDATION_CHUNK_SIZE;
+      if (start >= task->lookups->len)
+        break;
+
+      end = MIN (start + PARALLEL_VALIDATION_CHUNK_SIZE, task->lookups->len);
+
+      for (i = start; i < end; i++)
+        {
+          PrecomputedLookup *precomputed = &g_array_index (task->lookups, PrecomputedLookup, i);
+
+          /* The filter contains all the ancestors, just like when
+           * validating. Siblings are next to each other, so we can
+           * usually reuse it.
+           */
+          if (!have_filter || precomputed->node->parent != filter_parent)
+            {
+              GtkCssNode *ancestor;
+
+              memset (&filter, 0, sizeof (GtkCountingBloomFilter));
+              filter_parent = precomputed->node->parent;
+              for (ancestor = filter_parent; ancestor; ancestor = ancestor->parent)
+                gtk_css_node_declaration_add_bloom_hashes (ancestor->decl, &filter);
+              have_filter = TRUE;
+            }
+
+          gtk_css_node_precompute_lookup (precomputed, &filter);
+        }
+    }
+}
+
+static GArray *
+gtk_css_node_precompute_lookups (GtkCssNode *cssnode)
+{
+  PrecomputeTask task;
+  GArray *lookups;
+  guint i, j;
+  gint64 before = g_get_monotonic_time ();
+
+  lookups = g_array_new (FALSE, TRUE, sizeof (PrecomputedLookup));
+
+  gtk_css_node_collect_lookups (cssnode, lookups);
+
+  if (lookups->len < PARALLEL_VALIDATION_MIN_NODES)
+    {
+      g_array_free (lookups, TRUE);
+      return NULL;
+    }
+
+  task.lookups = lookups;
+  task.next_chunk = 0;
+
+  gtk_css_provider_begin_parallel_lookups ();
+  gdk_parallel_task_run (gtk_css_node_precompute_task,
+                         &task,
+                         (lookups->len + PARALLEL_VALIDATION_CHUNK_SIZE - 1) / PARALLEL_VALIDATION_CHUNK_SIZE);
+  gtk_css_provider_end_parallel_lookups ();
+
+  /* Keep the values alive even if a ::style-changed handler
+   * modifies the providers while we validate.
+   */
+  precomputed_lookups = g_hash_table_new (NULL, NULL);
+  for (i = 0; i < lookups->len; i++)
+    {
+      PrecomputedLookup *precomputed = &g_array_index (lookups, PrecomputedLookup, i);
+
+      for (j = 0; j < precomputed->n_values; j++)
+        {
+          gtk_css_value_ref (precomputed->values[j].value);
+          if (precomputed->values[j].section)
+            gtk_css_section_ref (precomputed->values[j].section);
+        }
+
+      g_hash_table_insert (precomputed_lookups, precomputed->node, precomputed);
+    }
+
+  precomputed_serial = tree_serial;
+
+  if (gtk_css_stats_get_timing ())
+    gtk_css_stats_add (GTK_CSS_STAT_LOOKUP_TIME, g_get_monotonic_time () - before);
+
+  if (GDK_PROFILER_IS_RUNNING)
+    gdk_profiler_end_mark (before, "css lookups", NULL);
+
+  return lookups;
+}
+
+static void
+gtk_css_node_clear_precomputed_lookups (GArray *lookups)
+{
+  guint i, j;
+
+  g_clear_pointer (&precomputed_lookups, g_hash_table_unref);
+
+  for (i = 0; i < lookups->len; i++)
+    {
+      PrecomputedLookup *precomputed = &g_array_index (lookups, PrecomputedLookup, i);
+
+      for (j = 0; j < precomputed->n_values; j++)
+        {
+          gtk_css_value_unref (precomputed->values[j].value);
+          if (precomputed->values[j].section)
+            gtk_css_section_unref (precomputed->values[j].section);
+        }
+
+      g_free (precomputed->values);
+    }
+
+  g_array_free (lookups, TRUE);
+}
+
 void
 gtk_css_node_validate (GtkCssNode *cssnode)
 {
   GtkCountingBloomFilter filter = GTK_COUNTING_BLOOM_FILTER_INIT;
+  GArray *lookups = NULL;
   gint64 timestamp;
   gint64 before = g_get_monotonic_time ();
 
@@ -1370,16 +1731,22 @@ gtk_css_node_validate (GtkCssNode *cssnode)
 
   timestamp = gtk_css_node_get_timestamp (cssnode);
 
+  /* Validating other trees from ::style-changed handlers just
+   * does it the normal way.
+   */
+  if (precomputed_lookups == NULL &&
+      gtk_css_node_use_parallel_validation ())
+    lookups = gtk_css_node_precompute_lookups (cssnode);
+
   gtk_css_node_validate_internal (cssnode, &filter, timestamp);
 
+  if (lookups)
+    gtk_css_node_clear_precomputed_lookups (lookups);
+
   if (GDK_PROFILER_IS_RUNNING)
     {
       gint64 after = g_get_monotonic_time ();
       gdk_profiler_add_mark (before, (after - before), "css validation", "");
-      gdk_profiler_set_int_counter (invalidated_nodes_counter, after, invalidated_nodes);
-      gdk_profiler_set_int_counter (created_styles_counter, after, created_styles);
-      invalidated_nodes = 0;
-      created_styles = 0;
     }
 }
 
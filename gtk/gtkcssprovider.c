@@ -26,6 +26,7 @@
 #include "gtkcssparserprivate.h"
 #include "gtkcssselectorprivate.h"
 #include "gtkcssshorthandpropertyprivate.h"
+#include "gtkcssstaticstyleprivate.h"
 #include "gtksettingsprivate.h"
 #include "gtkstyleprovider.h"
 #include "gtkstylecontextprivate.h"
@@ -38,6 +39,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <glib/gstdio.h>
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include "gdk/gdkprofilerprivate.h"
@@ -121,6 +123,10 @@ struct _GtkCssProviderPrivate
 
   GArray *rulesets;
   GtkCssSelectorTree *tree;
+  GHashTable *lookup_cache;
+  /* For each bit of GtkCssChange, the value groups set by
+   * rulesets whose matching depends on it */
+  GtkCssValueGroups change_groups[64];
   GResource *resource;
   char *path;
 };
@@ -132,6 +138,9 @@ enum {
 
 static gboolean gtk_keep_css_sections = FALSE;
 
+static guint64 lookup_cache_hits;
+static guint64 lookup_cache_misses;
+
 static guint css_provider_signals[LAST_SIGNAL] = { 0 };
 
 static void gtk_css_provider_finalize (GObject *object);
@@ -336,10 +345,10 @@ gtk_css_scanner_parser_error (GtkCssParser         *parser,
 }
 
 static GtkCssScanner *
-gtk_css_scanner_new (GtkCssProvider *provider,
-                     GtkCssScanner  *parent,
-                     GFile          *file,
-                     GBytes         *bytes)
+gtk_css_scanner_new (GtkCssProvider  *provider,
+                     GtkCssScanner   *parent,
+                     GFile           *file,
+                     GtkCssTokenizer *tokenizer)
 {
   GtkCssScanner *scanner;
 
@@ -349,12 +358,12 @@ gtk_css_scanner_new (GtkCssProvider *provider,
   scanner->provider = provider;
   scanner->parent = parent;
 
-  scanner->parser = gtk_css_parser_new_for_bytes (bytes,
-                                                  file,
-                                                  NULL,
-                                                  gtk_css_scanner_parser_error,
-                                                  scanner,
-                                                  NULL);
+  scanner->parser = gtk_css_parser_new (tokenizer,
+                                        file,
+                                        NULL,
+                                        gtk_css_scanner_parser_error,
+                                        scanner,
+                                        NULL);
 
   return scanner;
 }
@@ -375,6 +384,223 @@ gtk_css_scanner_would_recurse (GtkCssScanner *scanner,
   return FALSE;
 }
 
+/* Caches the declarations that win for a given set of matched
+ * rulesets, so that nodes matching the same rules - like the rows
+ * of a list - don't need to walk all the declarations again.
+ *
+ * The entries point into the rulesets, so the cache must be
+ * cleared whenever the rulesets change.
+ */
+#define LOOKUP_CACHE_MAX_ENTRIES 1024
+
+typedef struct {
+  guint id;
+  GtkCssSection *section;
+  GtkCssValue *value;
+} LookupCacheValue;
+
+typedef struct {
+  guint hash;
+  guint n_rulesets;
+  gpointer *rulesets;
+  guint n_values;
+  LookupCacheValue *values;
+} LookupCacheEntry;
+
+static guint
+lookup_cache_hash_rulesets (gpointer *rulesets,
+                            guint     n_rulesets)
+{
+  guint i, hash = 0;
+
+  for (i = 0; i < n_rulesets; i++)
+    hash = (hash << 5) - hash + GPOINTER_TO_UINT (rulesets[i]);
+
+  return hash;
+}
+
+static guint
+lookup_cache_entry_hash (gconstpointer data)
+{
+  const LookupCacheEntry *entry = data;
+
+  return entry->hash;
+}
+
+static gboolean
+lookup_cache_entry_equal (gconstpointer a,
+                          gconstpointer b)
+{
+  const LookupCacheEntry *ea = a;
+  const LookupCacheEntry *eb = b;
+
+  return ea->n_rulesets == eb->n_rulesets &&
+         memcmp (ea->rulesets, eb->rulesets, sizeof (gpointer) * ea->n_rulesets) == 0;
+}
+
+static void
+lookup_cache_entry_free (gpointer data)
+{
+  LookupCacheEntry *entry = data;
+
+  g_free (entry->rulesets);
+  g_free (entry->values);
+  g_slice_free (LookupCacheEntry, entry);
+}
+
+/* The matches are sorted, so the same set of rulesets always
+ * produces the same key.
+ */
+static LookupCacheEntry *
+lookup_cache_entry_new (GtkCssSelectorMatches *matches,
+                        guint                  hash)
+{
+  GtkBitmask *seen;
+  LookupCacheEntry *entry;
+  GArray *values;
+  int i;
+  guint j;
+
+  entry = g_slice_new (LookupCacheEntry);
+  entry->hash = hash;
+  entry->n_rulesets = gtk_css_selector_matches_get_size (matches);
+  entry->rulesets = g_memdup (gtk_css_selector_matches_get_data (matches),
+                              sizeof (gpointer) * entry->n_rulesets);
+
+  seen = _gtk_bitmask_new ();
+  values = g_array_new (FALSE, FALSE, sizeof (LookupCacheValue));
+
+  for (i = entry->n_rulesets - 1; i >= 0; i--)
+    {
+      GtkCssRuleset *ruleset = entry->rulesets[i];
+
+      if (ruleset->styles == NULL)
+        continue;
+
+      for (j = 0; j < ruleset->n_styles; j++)
+        {
+          LookupCacheValue value;
+
+          value.id = _gtk_css_style_property_get_id (ruleset->styles[j].property);
+
+          if (_gtk_bitmask_get (seen, value.id))
+            continue;
+
+          seen = _gtk_bitmask_set (seen, value.id, TRUE);
+          value.section = ruleset->styles[j].section;
+          value.value = ruleset->styles[j].value;
+          g_array_append_val (values, value);
+        }
+    }
+
+  _gtk_bitmask_free (seen);
+
+  entry->n_values = values->len;
+  entry->values = (LookupCacheValue *) g_array_free (values, FALSE);
+
+  return entry;
+}
+
+/* Lookups may happen from multiple threads during parallel
+ * style validation, see gtk_css_node_validate(). The lock is
+ * only taken while that is going on, so the common case of
+ * lookups on the main thread doesn't pay for it.
+ */
+G_LOCK_DEFINE_STATIC (lookup_cache);
+static guint parallel_lookups;
+
+/*< private >
+ * gtk_css_provider_begin_parallel_lookups:
+ *
+ * Must be called on the main thread before style lookups
+ * are started on other threads.
+ */
+void
+gtk_css_provider_begin_parallel_lookups (void)
+{
+  parallel_lookups++;
+}
+
+/*< private >
+ * gtk_css_provider_end_parallel_lookups:
+ *
+ * Must be called on the main thread after all style lookups
+ * started after gtk_css_provider_begin_parallel_lookups() have
+ * finished.
+ */
+void
+gtk_css_provider_end_parallel_lookups (void)
+{
+  g_return_if_fail (parallel_lookups > 0);
+
+  parallel_lookups--;
+}
+
+static void
+gtk_css_provider_lookup_cached (GtkCssProvider        *css_provider,
+                                GtkCssSelectorMatches *matches,
+                                GtkCssLookup          *lookup)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+  LookupCacheEntry key, *entry;
+  gboolean locked;
+  guint i;
+
+  key.n_rulesets = gtk_css_selector_matches_get_size (matches);
+  key.rulesets = gtk_css_selector_matches_get_data (matches);
+  key.hash = lookup_cache_hash_rulesets (key.rulesets, key.n_rulesets);
+
+  locked = parallel_lookups > 0;
+  if (locked)
+    G_LOCK (lookup_cache);
+
+  entry = g_hash_table_lookup (priv->lookup_cache, &key);
+  if (entry)
+    {
+      lookup_cache_hits++;
+    }
+  else
+    {
+      lookup_cache_misses++;
+
+      if (g_hash_table_size (priv->lookup_cache) >= LOOKUP_CACHE_MAX_ENTRIES)
+        g_hash_table_remove_all (priv->lookup_cache);
+
+      entry = lookup_cache_entry_new (matches, key.hash);
+      g_hash_table_add (priv->lookup_cache, entry);
+    }
+
+  for (i = 0; i < entry->n_values; i++)
+    {
+      const LookupCacheValue *value = &entry->values[i];
+
+      if (!_gtk_css_lookup_is_missing (lookup, value->id))
+        continue;
+
+      _gtk_css_lookup_set (lookup, value->id, value->section, value->value);
+    }
+
+  if (locked)
+    G_UNLOCK (lookup_cache);
+}
+
+/*< private >
+ * gtk_css_provider_get_lookup_cache_stats:
+ * @hits: (out): return location for the number of cache hits
+ * @misses: (out): return location for the number of cache misses
+ *
+ * Returns how often style lookups of all #GtkCssProviders could
+ * reuse the declarations resolved for an earlier lookup that
+ * matched the same rulesets.
+ */
+void
+gtk_css_provider_get_lookup_cache_stats (guint64 *hits,
+                                         guint64 *misses)
+{
+  *hits = lookup_cache_hits;
+  *misses = lookup_cache_misses;
+}
+
 static void
 gtk_css_provider_init (GtkCssProvider *css_provider)
 {
@@ -388,6 +614,10 @@ gtk_css_provider_init (GtkCssProvider *css_provider)
   priv->keyframes = g_hash_table_new_full (g_str_hash, g_str_equal,
                                            (GDestroyNotify) g_free,
                                            (GDestroyNotify) _gtk_css_keyframes_unref);
+  priv->lookup_cache = g_hash_table_new_full (lookup_cache_entry_hash,
+                                              lookup_cache_entry_equal,
+                                              lookup_cache_entry_free,
+                                              NULL);
 }
 
 static void
@@ -456,9 +686,6 @@ gtk_css_style_provider_lookup (GtkStyleProvider             *provider,
 {
   GtkCssProvider *css_provider = GTK_CSS_PROVIDER (provider);
   GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
-  GtkCssRuleset *ruleset;
-  guint j;
-  int i;
   GtkCssSelectorMatches tree_rules;
 
   if (_gtk_css_selector_tree_is_empty (priv->tree))
@@ -471,27 +698,7 @@ gtk_css_style_provider_lookup (GtkStyleProvider             *provider,
     {
       verify_tree_match_results (css_provider, node, &tree_rules);
 
-      for (i = gtk_css_selector_matches_get_size (&tree_rules) - 1; i >= 0; i--)
-        {
-          ruleset = gtk_css_selector_matches_get (&tree_rules, i);
-
-          if (ruleset->styles == NULL)
-            continue;
-
-          for (j = 0; j < ruleset->n_styles; j++)
-            {
-              GtkCssStyleProperty *prop = ruleset->styles[j].property;
-              guint id = _gtk_css_style_property_get_id (prop);
-
-              if (!_gtk_css_lookup_is_missing (lookup, id))
-                continue;
-
-              _gtk_css_lookup_set (lookup,
-                                   id,
-                                   ruleset->styles[j].section,
-                                   ruleset->styles[j].value);
-            }
-        }
+      gtk_css_provider_lookup_cached (css_provider, &tree_rules, lookup);
     }
   gtk_css_selector_matches_clear (&tree_rules);
 
@@ -499,12 +706,31 @@ gtk_css_style_provider_lookup (GtkStyleProvider             *provider,
     *change = gtk_css_selector_tree_get_change_all (priv->tree, filter, node);
 }
 
+static GtkCssValueGroups
+gtk_css_style_provider_get_change_groups (GtkStyleProvider *provider,
+                                          GtkCssChange      change)
+{
+  GtkCssProvider *css_provider = GTK_CSS_PROVIDER (provider);
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+  GtkCssValueGroups groups = 0;
+  guint i;
+
+  for (i = 0; change != 0; i++, change >>= 1)
+    {
+      if (change & 1)
+        groups |= priv->change_groups[i];
+    }
+
+  return groups;
+}
+
 static void
 gtk_css_style_provider_iface_init (GtkStyleProviderInterface *iface)
 {
   iface->get_color = gtk_css_style_provider_get_color;
   iface->get_keyframes = gtk_css_style_provider_get_keyframes;
   iface->lookup = gtk_css_style_provider_lookup;
+  iface->get_change_groups = gtk_css_style_provider_get_change_groups;
   iface->emit_error = gtk_css_style_provider_emit_error;
 }
 
@@ -518,6 +744,7 @@ gtk_css_provider_finalize (GObject *object)
   for (i = 0; i < priv->rulesets->len; i++)
     gtk_css_ruleset_clear (&g_array_index (priv->rulesets, GtkCssRuleset, i));
 
+  g_hash_table_destroy (priv->lookup_cache);
   g_array_free (priv->rulesets, TRUE);
   _gtk_css_selector_tree_free (priv->tree);
 
@@ -597,12 +824,14 @@ gtk_css_provider_reset (GtkCssProvider *css_provider)
 
   g_hash_table_remove_all (priv->symbolic_colors);
   g_hash_table_remove_all (priv->keyframes);
+  g_hash_table_remove_all (priv->lookup_cache);
 
   for (i = 0; i < priv->rulesets->len; i++)
     gtk_css_ruleset_clear (&g_array_index (priv->rulesets, GtkCssRuleset, i));
   g_array_set_size (priv->rulesets, 0);
   _gtk_css_selector_tree_free (priv->tree);
   priv->tree = NULL;
+  memset (priv->change_groups, 0, sizeof (priv->change_groups));
 }
 
 static gboolean
@@ -998,6 +1227,26 @@ gtk_css_provider_postprocess (GtkCssProvider *css_provider)
   priv->tree = _gtk_css_selector_tree_builder_build (builder);
   _gtk_css_selector_tree_builder_free (builder);
 
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset;
+      GtkCssValueGroups groups = 0;
+      GtkCssChange change;
+      guint j;
+
+      ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+
+      for (j = 0; j < ruleset->n_styles; j++)
+        groups |= gtk_css_static_style_get_value_group (_gtk_css_style_property_get_id (ruleset->styles[j].property));
+
+      change = _gtk_css_selector_get_change (ruleset->selector);
+      for (j = 0; change != 0; j++, change >>= 1)
+        {
+          if (change & 1)
+            priv->change_groups[j] |= groups;
+        }
+    }
+
 #ifndef VERIFY_TREE
   for (i = 0; i < priv->rulesets->len; i++)
     {
@@ -1014,6 +1263,234 @@ gtk_css_provider_postprocess (GtkCssProvider *css_provider)
     gdk_profiler_end_mark (before, "create selector tree", NULL);
 }
 
+/* Files smaller than this are tokenized faster than we can look
+ * up and map their cache file.
+ */
+#define PRECOMPILE_MIN_SIZE (16 * 1024)
+
+/* Limits for the cache directory. The least recently used
+ * entries are removed when a new entry would exceed them.
+ */
+#define PRECOMPILE_CACHE_MAX_ENTRIES 32
+#define PRECOMPILE_CACHE_MAX_SIZE (8 * 1024 * 1024)
+
+/* Only installed themes are cached. They are loaded by many
+ * processes and don't change, whereas caching the user's own
+ * style sheets would just fill the cache with edits.
+ */
+static gboolean
+gtk_css_provider_is_installed_file (GFile *file)
+{
+  const char * const *dirs;
+  gboolean result = FALSE;
+  char *theme_dir;
+  GFile *dir;
+  int i;
+
+  if (file == NULL)
+    return FALSE;
+
+  if (g_file_has_uri_scheme (file, "resource"))
+    return TRUE;
+
+  dirs = g_get_system_data_dirs ();
+  for (i = 0; dirs[i] && !result; i++)
+    {
+      char *path = g_build_filename (dirs[i], "themes", NULL);
+
+      dir = g_file_new_for_path (path);
+      result = g_file_has_prefix (file, dir);
+      g_object_unref (dir);
+      g_free (path);
+    }
+
+  if (!result)
+    {
+      theme_dir = _gtk_get_theme_dir ();
+      dir = g_file_new_for_path (theme_dir);
+      result = g_file_has_prefix (file, dir);
+      g_object_unref (dir);
+      g_free (theme_dir);
+    }
+
+  return result;
+}
+
+typedef struct {
+  char *path;
+  gint64 mtime;
+  goffset size;
+} CacheEntry;
+
+static int
+compare_cache_entries (gconstpointer a,
+                       gconstpointer b)
+{
+  const CacheEntry *entry_a = a;
+  const CacheEntry *entry_b = b;
+
+  /* Most recently used first */
+  if (entry_a->mtime > entry_b->mtime)
+    return -1;
+  else if (entry_a->mtime < entry_b->mtime)
+    return 1;
+  else
+    return 0;
+}
+
+static void
+gtk_css_provider_trim_cache (const char *dir)
+{
+  GArray *entries;
+  const char *name;
+  goffset total;
+  GDir *gdir;
+  guint i;
+
+  gdir = g_dir_open (dir, 0, NULL);
+  if (gdir == NULL)
+    return;
+
+  entries = g_array_new (FALSE, FALSE, sizeof (CacheEntry));
+  while ((name = g_dir_read_name (gdir)) != NULL)
+    {
+      CacheEntry entry;
+      GStatBuf buf;
+
+      entry.path = g_build_filename (dir, name, NULL);
+      if (g_stat (entry.path, &buf) != 0)
+        {
+          g_free (entry.path);
+          continue;
+        }
+
+      entry.mtime = buf.st_mtime;
+      entry.size = buf.st_size;
+      g_array_append_val (entries, entry);
+    }
+  g_dir_close (gdir);
+
+  g_array_sort (entries, compare_cache_entries);
+
+  total = 0;
+  for (i = 0; i < entries->len; i++)
+    {
+      CacheEntry *entry = &g_array_index (entries, CacheEntry, i);
+
+      total += entry->size;
+      if (i >= PRECOMPILE_CACHE_MAX_ENTRIES || total > PRECOMPILE_CACHE_MAX_SIZE)
+        g_remove (entry->path);
+
+      g_free (entry->path);
+    }
+
+  g_array_free (entries, TRUE);
+}
+
+typedef struct {
+  GBytes *bytes;
+  char *dir;
+  char *filename;
+} PrecompileData;
+
+static void
+precompile_data_free (gpointer data)
+{
+  PrecompileData *pd = data;
+
+  g_bytes_unref (pd->bytes);
+  g_free (pd->dir);
+  g_free (pd->filename);
+  g_slice_free (PrecompileData, pd);
+}
+
+static void
+precompile_thread (GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+  PrecompileData *pd = task_data;
+  GBytes *precompiled;
+
+  precompiled = gtk_css_tokenizer_precompile (pd->bytes);
+
+  /* g_file_set_contents() writes to a temporary file and renames it,
+   * so other processes never map a partially written entry. Failing
+   * to write the cache is not a problem, we'll try again next time.
+   */
+  if (g_mkdir_with_parents (pd->dir, 0700) == 0 &&
+      g_file_set_contents (pd->filename,
+                           g_bytes_get_data (precompiled, NULL),
+                           g_bytes_get_size (precompiled),
+                           NULL))
+    gtk_css_provider_trim_cache (pd->dir);
+
+  g_bytes_unref (precompiled);
+}
+
+/* Returns the precompiled token stream for @bytes from the user's
+ * cache, or %NULL if there is no usable entry or @file should not be
+ * cached. The cache entries are named after the hash of the CSS text,
+ * so they never need to be invalidated; entries from other GTK
+ * versions fail gtk_css_tokenizer_is_precompiled() and are replaced.
+ *
+ * On a miss, the caller parses @bytes directly. Precompiling means
+ * tokenizing the whole sheet once more, so the entry is created and
+ * the cache trimmed in a thread, and only later loads use it.
+ */
+static GBytes *
+gtk_css_provider_get_precompiled (GFile  *file,
+                                  GBytes *bytes)
+{
+  GMappedFile *mapped;
+  GBytes *precompiled;
+  PrecompileData *pd;
+  GTask *task;
+  char *checksum, *dir, *filename;
+
+  if (g_bytes_get_size (bytes) < PRECOMPILE_MIN_SIZE ||
+      !gtk_css_provider_is_installed_file (file))
+    return NULL;
+
+  checksum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, bytes);
+  dir = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "css", NULL);
+  filename = g_build_filename (dir, checksum, NULL);
+  g_free (checksum);
+
+  mapped = g_mapped_file_new (filename, FALSE, NULL);
+  if (mapped)
+    {
+      precompiled = g_mapped_file_get_bytes (mapped);
+      g_mapped_file_unref (mapped);
+
+      if (gtk_css_tokenizer_is_precompiled (precompiled))
+        {
+          /* Mark as recently used for gtk_css_provider_trim_cache() */
+          g_utime (filename, NULL);
+          g_free (filename);
+          g_free (dir);
+
+          return precompiled;
+        }
+
+      g_bytes_unref (precompiled);
+    }
+
+  pd = g_slice_new (PrecompileData);
+  pd->bytes = g_bytes_ref (bytes);
+  pd->dir = dir;
+  pd->filename = filename;
+
+  task = g_task_new (NULL, NULL, NULL, NULL);
+  g_task_set_source_tag (task, gtk_css_provider_get_precompiled);
+  g_task_set_task_data (task, pd, precompile_data_free);
+  g_task_run_in_thread (task, precompile_thread);
+  g_object_unref (task);
+
+  return NULL;
+}
+
 static void
 gtk_css_provider_load_internal (GtkCssProvider *self,
                                 GtkCssScanner  *parent,
@@ -1021,6 +1498,7 @@ gtk_css_provider_load_internal (GtkCssProvider *self,
                                 GBytes         *bytes)
 {
   gint64 before = g_get_monotonic_time ();
+  gboolean used_precompiled = FALSE;
 
   if (bytes == NULL)
     {
@@ -1052,12 +1530,25 @@ gtk_css_provider_load_internal (GtkCssProvider *self,
 
   if (bytes)
     {
+      GtkCssTokenizer *tokenizer = NULL;
       GtkCssScanner *scanner;
+      GBytes *precompiled;
+
+      precompiled = gtk_css_provider_get_precompiled (file, bytes);
+      if (precompiled)
+        {
+          tokenizer = gtk_css_tokenizer_new_precompiled (precompiled);
+          used_precompiled = tokenizer != NULL;
+          g_bytes_unref (precompiled);
+        }
+      if (tokenizer == NULL)
+        tokenizer = gtk_css_tokenizer_new (bytes);
 
       scanner = gtk_css_scanner_new (self,
                                      parent,
                                      file,
-                                     bytes);
+                                     tokenizer);
+      gtk_css_tokenizer_unref (tokenizer);
 
       parse_stylesheet (scanner);
 
@@ -1072,7 +1563,10 @@ gtk_css_provider_load_internal (GtkCssProvider *self,
   if (GDK_PROFILER_IS_RUNNING)
     {
       char *uri = g_file_get_uri (file);
-      gdk_profiler_end_mark (before, "theme load", uri);
+      /* Separate marks, to compare loads with and without the cache */
+      gdk_profiler_end_mark (before,
+                             used_precompiled ? "theme load (precompiled)" : "theme load",
+                             uri);
       g_free (uri);
     }
 }
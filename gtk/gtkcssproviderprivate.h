@@ -28,6 +28,12 @@ const char *_gtk_css_provider_get_theme_dir (GtkCssProvider *provider);
 
 void   gtk_css_provider_set_keep_css_sections (void);
 
+void   gtk_css_provider_get_lookup_cache_stats (guint64 *hits,
+                                                guint64 *misses);
+
+void   gtk_css_provider_begin_parallel_lookups (void);
+void   gtk_css_provider_end_parallel_lookups   (void);
+
 G_END_DECLS
 
 #endif /* __GTK_CSS_PROVIDER_PRIVATE_H__ */
@@ -23,6 +23,7 @@
 #include <string.h>
 
 #include "gtkcssprovider.h"
+#include "gtkcssstatsprivate.h"
 #include "gtkstylecontextprivate.h"
 
 #include <errno.h>
@@ -1889,19 +1890,30 @@ gtk_css_selector_tree_found_match (const GtkCssSelectorTree  *tree,
     gtk_css_selector_matches_insert_sorted (results, matches[i]);
 }
 
+typedef struct {
+  gsize visited;
+  gsize rejected;
+} MatchStats;
+
 static gboolean
 gtk_css_selector_tree_match (const GtkCssSelectorTree      *tree,
                              const GtkCountingBloomFilter  *filter,
                              gboolean                       match_filter,
                              GtkCssNode                    *node,
-                             GtkCssSelectorMatches         *results)
+                             GtkCssSelectorMatches         *results,
+                             MatchStats                    *stats)
 {
   const GtkCssSelectorTree *prev;
   GtkCssNode *child;
 
+  stats->visited++;
+
   if (match_filter && tree->selector.class->category == GTK_CSS_SELECTOR_CATEGORY_SIMPLE_RADICAL &&
       !gtk_counting_bloom_filter_may_contain (filter, gtk_css_selector_hash_one (&tree->selector)))
-    return FALSE;
+    {
+      stats->rejected++;
+      return FALSE;
+    }
 
   if (!gtk_css_selector_match_one (&tree->selector, node))
     return TRUE;
@@ -1919,7 +1931,7 @@ gtk_css_selector_tree_match (const GtkCssSelectorTree      *tree,
            child;
            child = gtk_css_selector_iterator (&tree->selector, node, child))
         {
-          if (!gtk_css_selector_tree_match (prev, filter, match_filter, child, results))
+          if (!gtk_css_selector_tree_match (prev, filter, match_filter, child, results, stats))
             break;
         }
     }
@@ -1934,13 +1946,17 @@ _gtk_css_selector_tree_match_all (const GtkCssSelectorTree     *tree,
                                   GtkCssSelectorMatches        *out_tree_rules)
 {
   const GtkCssSelectorTree *iter;
+  MatchStats stats = { 0, 0 };
 
   for (iter = tree;
        iter != NULL;
        iter = gtk_css_selector_tree_get_sibling (iter))
     {
-      gtk_css_selector_tree_match (iter, filter, FALSE, node, out_tree_rules);
+      gtk_css_selector_tree_match (iter, filter, FALSE, node, out_tree_rules, &stats);
     }
+
+  gtk_css_stats_add (GTK_CSS_STAT_SELECTORS_VISITED, stats.visited);
+  gtk_css_stats_add (GTK_CSS_STAT_BLOOM_REJECTIONS, stats.rejected);
 }
 
 gboolean
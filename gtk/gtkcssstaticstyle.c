@@ -45,6 +45,10 @@ static void gtk_css_static_style_compute_value (GtkCssStaticStyle *style,
                                                 guint              id,
                                                 GtkCssValue       *specified,
                                                 GtkCssSection     *section);
+static void gtk_css_static_style_copy_sections (GtkCssStaticStyle *style,
+                                                GtkCssStaticStyle *previous,
+                                                const int         *props,
+                                                guint              n_props);
 
 static const int core_props[] = {
   GTK_CSS_PROPERTY_COLOR,
@@ -213,6 +217,8 @@ gtk_css_ ## NAME ## _values_new_compute (GtkCssStaticStyle *sstyle, \
                                           lookup->values[id].value, \
                                           lookup->values[id].section); \
     } \
+\
+  style->NAME = (GtkCss ## TYPE ## Values *)gtk_css_values_intern ((GtkCssValues *)style->NAME); \
 } \
 static GtkBitmask * gtk_css_ ## NAME ## _values_mask; \
 static GtkCssValues * gtk_css_ ## NAME ## _initial_values; \
@@ -231,6 +237,8 @@ gtk_css_ ## NAME ## _values_init (void) \
     } \
 \
   gtk_css_ ## NAME ## _initial_values = gtk_css_ ## NAME ## _create_initial_values (); \
+  if (gtk_css_ ## NAME ## _initial_values) \
+    gtk_css_ ## NAME ## _initial_values = gtk_css_values_intern (gtk_css_ ## NAME ## _initial_values); \
 } \
 \
 static inline gboolean \
@@ -238,6 +246,36 @@ gtk_css_ ## NAME ## _values_unset (const GtkCssLookup *lookup) \
 { \
   const GtkBitmask *set_values = _gtk_css_lookup_get_set_values (lookup); \
   return !_gtk_bitmask_intersects (set_values, gtk_css_ ## NAME ## _values_mask); \
+} \
+\
+static inline gboolean \
+gtk_css_ ## NAME ## _values_reuse (GtkCssStaticStyle  *sstyle, \
+                                   GtkCssStaticStyle  *previous, \
+                                   GtkCssValueGroups   changed_groups, \
+                                   const GtkCssLookup *lookup) \
+{ \
+  GtkCssStyle *style = (GtkCssStyle *)sstyle; \
+  int i; \
+\
+  if (previous == NULL || (changed_groups & GTK_CSS_VALUE_GROUP_ ## ENUM)) \
+    return FALSE; \
+\
+  /* Values may refer to the core values, ie currentColor or em */ \
+  if (GTK_CSS_VALUE_GROUP_ ## ENUM != GTK_CSS_VALUE_GROUP_CORE && \
+      style->core != ((GtkCssStyle *)previous)->core) \
+    return FALSE; \
+\
+  /* We don't know if the parent values changed */ \
+  for (i = 0; i < G_N_ELEMENTS (NAME ## _props); i++) \
+    { \
+      if (lookup->values[NAME ## _props[i]].value == _gtk_css_inherit_value_get ()) \
+        return FALSE; \
+    } \
+\
+  style->NAME = (GtkCss ## TYPE ## Values *)gtk_css_values_ref ((GtkCssValues *)((GtkCssStyle *)previous)->NAME); \
+  gtk_css_static_style_copy_sections (sstyle, previous, NAME ## _props, G_N_ELEMENTS (NAME ## _props)); \
+\
+  return TRUE; \
 }
 
 DEFINE_VALUES (CORE, Core, core)
@@ -252,6 +290,48 @@ DEFINE_VALUES (TRANSITION, Transition, transition)
 DEFINE_VALUES (SIZE, Size, size)
 DEFINE_VALUES (OTHER, Other, other)
 
+#define SET_VALUE_GROUP(ENUM, NAME) \
+  for (i = 0; i < G_N_ELEMENTS (NAME ## _props); i++) \
+    value_groups[NAME ## _props[i]] = GTK_CSS_VALUE_GROUP_ ## ENUM;
+
+/*< private >
+ * gtk_css_static_style_get_value_group:
+ * @id: the id of a style property
+ *
+ * Returns: the group of values that the property is stored in
+ */
+GtkCssValueGroups
+gtk_css_static_style_get_value_group (guint id)
+{
+  static guint16 value_groups[GTK_CSS_PROPERTY_N_PROPERTIES];
+  static gsize initialized = 0;
+
+  gtk_internal_return_val_if_fail (id < GTK_CSS_PROPERTY_N_PROPERTIES, GTK_CSS_VALUE_GROUPS_ALL);
+
+  if (g_once_init_enter (&initialized))
+    {
+      int i;
+
+      SET_VALUE_GROUP (CORE, core);
+      SET_VALUE_GROUP (BACKGROUND, background);
+      SET_VALUE_GROUP (BORDER, border);
+      SET_VALUE_GROUP (ICON, icon);
+      SET_VALUE_GROUP (OUTLINE, outline);
+      SET_VALUE_GROUP (FONT, font);
+      SET_VALUE_GROUP (FONT_VARIANT, font_variant);
+      SET_VALUE_GROUP (ANIMATION, animation);
+      SET_VALUE_GROUP (TRANSITION, transition);
+      SET_VALUE_GROUP (SIZE, size);
+      SET_VALUE_GROUP (OTHER, other);
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return value_groups[id];
+}
+
+#undef SET_VALUE_GROUP
+
 #define VERIFY_MASK(NAME) \
   { \
     GtkBitmask *copy; \
@@ -675,6 +755,37 @@ gtk_css_static_style_set_value (GtkCssStaticStyle *sstyle,
     }
 }
 
+static void
+gtk_css_static_style_copy_sections (GtkCssStaticStyle *sstyle,
+                                    GtkCssStaticStyle *previous,
+                                    const int         *props,
+                                    guint              n_props)
+{
+  guint i;
+
+  if (previous->sections == NULL)
+    return;
+
+  for (i = 0; i < n_props; i++)
+    {
+      guint id = props[i];
+      GtkCssSection *section;
+
+      if (id >= previous->sections->len)
+        continue;
+
+      section = g_ptr_array_index (previous->sections, id);
+      if (section == NULL)
+        continue;
+
+      if (sstyle->sections == NULL)
+        sstyle->sections = g_ptr_array_new_with_free_func (maybe_unref_section);
+      if (sstyle->sections->len <= id)
+        g_ptr_array_set_size (sstyle->sections, id + 1);
+      g_ptr_array_index (sstyle->sections, id) = gtk_css_section_ref (section);
+    }
+}
+
 static GtkCssStyle *default_style;
 
 static void
@@ -886,11 +997,34 @@ gtk_css_other_create_initial_values (void)
   return (GtkCssValues *)values;
 }
 
+static gboolean
+gtk_css_core_values_equal (GtkCssStyle *style1,
+                           GtkCssStyle *style2)
+{
+  GtkCssValue **g1 = GET_VALUES (style1->core);
+  GtkCssValue **g2 = GET_VALUES (style2->core);
+  int i;
+
+  for (i = 0; i < G_N_ELEMENTS (core_props); i++)
+    {
+      if (!_gtk_css_value_equal (g1[i], g2[i]))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* If @previous is given, it must be an earlier style for the same
+ * node and provider, and @changed_groups the groups that may have
+ * different values since. All other groups are taken from @previous.
+ */
 static void
 gtk_css_lookup_resolve (GtkCssLookup      *lookup,
                         GtkStyleProvider  *provider,
                         GtkCssStaticStyle *sstyle,
-                        GtkCssStyle       *parent_style)
+                        GtkCssStyle       *parent_style,
+                        GtkCssStaticStyle *previous,
+                        GtkCssValueGroups  changed_groups)
 {
   GtkCssStyle *style = (GtkCssStyle *)sstyle;
 
@@ -928,57 +1062,66 @@ gtk_css_lookup_resolve (GtkCssLookup      *lookup,
 
   if (parent_style && gtk_css_core_values_unset (lookup))
     style->core = (GtkCssCoreValues *)gtk_css_values_ref ((GtkCssValues *)parent_style->core);
-  else
+  else if (!gtk_css_core_values_reuse (sstyle, previous, changed_groups, lookup))
     gtk_css_core_values_new_compute (sstyle, provider, parent_style, lookup);
 
+  /* Keep sharing the core values if they didn't change, so
+   * the other groups can be reused */
+  if (previous && style->core != ((GtkCssStyle *)previous)->core &&
+      gtk_css_core_values_equal (style, (GtkCssStyle *)previous))
+    {
+      gtk_css_values_unref ((GtkCssValues *)style->core);
+      style->core = (GtkCssCoreValues *)gtk_css_values_ref ((GtkCssValues *)((GtkCssStyle *)previous)->core);
+    }
+
   if (gtk_css_background_values_unset (lookup))
     style->background = (GtkCssBackgroundValues *)gtk_css_values_ref (gtk_css_background_initial_values);
-  else
+  else if (!gtk_css_background_values_reuse (sstyle, previous, changed_groups, lookup))
     gtk_css_background_values_new_compute (sstyle, provider, parent_style, lookup);
 
   if (gtk_css_border_values_unset (lookup))
     style->border = (GtkCssBorderValues *)gtk_css_values_ref (gtk_css_border_initial_values);
-  else
+  else if (!gtk_css_border_values_reuse (sstyle, previous, changed_groups, lookup))
     gtk_css_border_values_new_compute (sstyle, provider, parent_style, lookup);
 
   if (parent_style && gtk_css_icon_values_unset (lookup))
     style->icon = (GtkCssIconValues *)gtk_css_values_ref ((GtkCssValues *)parent_style->icon);
-  else
+  else if (!gtk_css_icon_values_reuse (sstyle, previous, changed_groups, lookup))
     gtk_css_icon_values_new_compute (sstyle, provider, parent_style, lookup);
 
   if (gtk_css_outline_values_unset (lookup))
     style->outline = (GtkCssOutlineValues *)gtk_css_values_ref (gtk_css_outline_initial_values);
-  else
+  else if (!gtk_css_outline_values_reuse (sstyle, previous, changed_groups, lookup))
     gtk_css_outline_values_new_compute (sstyle, provider, parent_style, lookup);
 
   if (parent_style && gtk_css_font_values_unset (lookup))
     style->font = (GtkCssFontValues *)gtk_css_values_ref ((GtkCssValues *)parent_style->font);
-  else
+  else if (!gtk_css_font_values_reuse (sstyle, previous, changed_groups, lookup))
     gtk_css_font_values_new_compute (sstyle, provider, parent_style, lookup);
 
   if (gtk_css_font_variant_values_unset (lookup))
     style->font_variant = (GtkCssFontVariantValues *)gtk_css_values_ref (gtk_css_font_variant_initial_values);
-  else
+  else if (!gtk_css_font_variant_values_reuse (sstyle, previous, changed_groups, lookup))
     gtk_css_font_variant_values_new_compute (sstyle, provider, parent_style, lookup);
 
   if (gtk_css_animation_values_unset (lookup))
     style->animation = (GtkCssAnimationValues *)gtk_css_values_ref (gtk_css_animation_initial_values);
-  else
+  else if (!gtk_css_animation_values_reuse (sstyle, previous, changed_groups, lookup))
     gtk_css_animation_values_new_compute (sstyle, provider, parent_style, lookup);
 
   if (gtk_css_transition_values_unset (lookup))
     style->transition = (GtkCssTransitionValues *)gtk_css_values_ref (gtk_css_transition_initial_values);
-  else
+  else if (!gtk_css_transition_values_reuse (sstyle, previous, changed_groups, lookup))
     gtk_css_transition_values_new_compute (sstyle, provider, parent_style, lookup);
 
   if (gtk_css_size_values_unset (lookup))
     style->size = (GtkCssSizeValues *)gtk_css_values_ref (gtk_css_size_initial_values);
-  else
+  else if (!gtk_css_size_values_reuse (sstyle, previous, changed_groups, lookup))
     gtk_css_size_values_new_compute (sstyle, provider, parent_style, lookup);
 
   if (gtk_css_other_values_unset (lookup))
     style->other = (GtkCssOtherValues *)gtk_css_values_ref (gtk_css_other_initial_values);
-  else
+  else if (!gtk_css_other_values_reuse (sstyle, previous, changed_groups, lookup))
     gtk_css_other_values_new_compute (sstyle, provider, parent_style, lookup);
 }
 
@@ -988,9 +1131,8 @@ gtk_css_static_style_new_compute (GtkStyleProvider             *provider,
                                   GtkCssNode                   *node,
                                   GtkCssChange                  change)
 {
-  GtkCssStaticStyle *result;
+  GtkCssStyle *result;
   GtkCssLookup lookup;
-  GtkCssNode *parent;
 
   _gtk_css_lookup_init (&lookup);
 
@@ -1001,6 +1143,43 @@ gtk_css_static_style_new_compute (GtkStyleProvider             *provider,
                                &lookup,
                                change == 0 ? &change : NULL);
 
+  result = gtk_css_static_style_new_compute_for_lookup (provider, &lookup, node, change,
+                                                        NULL, GTK_CSS_VALUE_GROUPS_ALL);
+
+  _gtk_css_lookup_destroy (&lookup);
+
+  return result;
+}
+
+/*< private >
+ * gtk_css_static_style_new_compute_for_lookup:
+ * @provider: the provider the lookup was done with
+ * @lookup: the result of looking up @node in @provider
+ * @node: (nullable): the node to compute the style for
+ * @change: the change flags for the new style
+ * @previous: (nullable): the previous static style of @node
+ * @changed_groups: the groups of values that may differ from @previous
+ *
+ * Like gtk_css_static_style_new_compute(), but uses the
+ * results of an earlier lookup instead of doing it.
+ *
+ * If @previous is given, only the value groups in @changed_groups,
+ * and the ones depending on them, are computed. The others are
+ * shared with @previous.
+ *
+ * Returns: (transfer full): the new style
+ */
+GtkCssStyle *
+gtk_css_static_style_new_compute_for_lookup (GtkStyleProvider  *provider,
+                                             GtkCssLookup      *lookup,
+                                             GtkCssNode        *node,
+                                             GtkCssChange       change,
+                                             GtkCssStaticStyle *previous,
+                                             GtkCssValueGroups  changed_groups)
+{
+  GtkCssStaticStyle *result;
+  GtkCssNode *parent;
+
   result = g_object_new (GTK_TYPE_CSS_STATIC_STYLE, NULL);
 
   result->change = change;
@@ -1010,12 +1189,12 @@ gtk_css_static_style_new_compute (GtkStyleProvider             *provider,
   else
     parent = NULL;
 
-  gtk_css_lookup_resolve (&lookup,
+  gtk_css_lookup_resolve (lookup,
                           provider,
                           result,
-                          parent ? gtk_css_node_get_style (parent) : NULL);
-
-  _gtk_css_lookup_destroy (&lookup);
+                          parent ? gtk_css_node_get_style (parent) : NULL,
+                          previous,
+                          changed_groups);
 
   return GTK_CSS_STYLE (result);
 }
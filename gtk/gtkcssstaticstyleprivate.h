@@ -57,8 +57,17 @@ GtkCssStyle *           gtk_css_static_style_new_compute        (GtkStyleProvide
                                                                  const GtkCountingBloomFilter   *filter,
                                                                  GtkCssNode                     *node,
                                                                  GtkCssChange                    change);
+GtkCssStyle *           gtk_css_static_style_new_compute_for_lookup
+                                                                (GtkStyleProvider               *provider,
+                                                                 struct _GtkCssLookup           *lookup,
+                                                                 GtkCssNode                     *node,
+                                                                 GtkCssChange                    change,
+                                                                 GtkCssStaticStyle              *previous,
+                                                                 GtkCssValueGroups               changed_groups);
 GtkCssChange            gtk_css_static_style_get_change         (GtkCssStaticStyle              *style);
 
+GtkCssValueGroups       gtk_css_static_style_get_value_group    (guint                           id);
+
 G_END_DECLS
 
 #endif /* __GTK_CSS_STATIC_STYLE_PRIVATE_H__ */
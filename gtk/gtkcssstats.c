@@ -0,0 +1,143 @@
+/*
+ * Copyright © 2020 GNOME Foundation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gtkcssstatsprivate.h"
+
+#include "gdk/gdkprofilerprivate.h"
+
+/* Statistics about the work done by the style machinery.
+ *
+ * Values are accumulated per frame, ie between two calls to
+ * gtk_css_stats_end_frame(), which windows do after painting a
+ * frame. At that point they are reported to the profiler, if it
+ * is running, and added to the totals shown by the inspector.
+ *
+ * Counting is cheap and always done. Measuring times is only done
+ * while the profiler is running or someone asked for it with
+ * gtk_css_stats_set_timing().
+ *
+ * Selector matching can happen in worker threads, so the per-frame
+ * values are updated atomically, and only what has been read is
+ * taken out of them when a frame ends. Everything else only happens
+ * on the main thread.
+ */
+
+static const struct {
+  const char *name;
+  const char *description;
+} stat_info[GTK_CSS_N_STATS] = {
+  { "invalidated-nodes", "CSS Node Invalidations" },
+  { "created-styles", "CSS Style Creations" },
+  { "animated-styles", "CSS Animated Style Creations" },
+  { "selectors-visited", "CSS Selectors Visited" },
+  { "bloom-rejections", "CSS Bloom Filter Rejections" },
+  { "style-cache-hits", "CSS Style Cache Hits" },
+  { "style-cache-misses", "CSS Style Cache Misses" },
+  { "lookup-time", "CSS Lookup Time (µs)" },
+  { "compute-time", "CSS Compute Time (µs)" },
+  { "animation-time", "CSS Animation Time (µs)" },
+};
+
+static gssize frame_values[GTK_CSS_N_STATS];
+static gint64 last_frame_values[GTK_CSS_N_STATS];
+static gint64 total_values[GTK_CSS_N_STATS];
+static guint counters[GTK_CSS_N_STATS];
+static int timing_users;
+
+void
+gtk_css_stats_add (GtkCssStat stat,
+                   gssize     value)
+{
+  g_atomic_pointer_add (&frame_values[stat], value);
+}
+
+/*< private >
+ * gtk_css_stats_get_timing:
+ *
+ * Returns: %TRUE if the time spent in the style machinery
+ *   should be measured
+ */
+gboolean
+gtk_css_stats_get_timing (void)
+{
+  return timing_users > 0 || GDK_PROFILER_IS_RUNNING;
+}
+
+void
+gtk_css_stats_set_timing (gboolean timing)
+{
+  if (timing)
+    timing_users++;
+  else
+    {
+      g_return_if_fail (timing_users > 0);
+      timing_users--;
+    }
+}
+
+void
+gtk_css_stats_end_frame (gint64 time)
+{
+  guint i;
+
+  if (GDK_PROFILER_IS_RUNNING && counters[0] == 0)
+    {
+      for (i = 0; i < GTK_CSS_N_STATS; i++)
+        counters[i] = gdk_profiler_define_int_counter (stat_info[i].name, stat_info[i].description);
+    }
+
+  for (i = 0; i < GTK_CSS_N_STATS; i++)
+    {
+      gssize value = (gssize) GPOINTER_TO_SIZE (g_atomic_pointer_get (&frame_values[i]));
+
+      /* Don't lose what was added since reading it */
+      g_atomic_pointer_add (&frame_values[i], -value);
+
+      if (GDK_PROFILER_IS_RUNNING)
+        gdk_profiler_set_int_counter (counters[i], time, value);
+
+      last_frame_values[i] = value;
+      total_values[i] += value;
+    }
+}
+
+void
+gtk_css_stats_get (GtkCssStat  stat,
+                   gint64     *last_frame,
+                   gint64     *total)
+{
+  g_return_if_fail (stat < GTK_CSS_N_STATS);
+
+  if (last_frame)
+    *last_frame = last_frame_values[stat];
+  if (total)
+    *total = total_values[stat];
+}
+
+void
+gtk_css_stats_reset (void)
+{
+  guint i;
+
+  for (i = 0; i < GTK_CSS_N_STATS; i++)
+    {
+      last_frame_values[i] = 0;
+      total_values[i] = 0;
+    }
+}
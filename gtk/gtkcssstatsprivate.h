@@ -0,0 +1,55 @@
+/*
+ * Copyright © 2020 GNOME Foundation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTK_CSS_STATS_PRIVATE_H__
+#define __GTK_CSS_STATS_PRIVATE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  GTK_CSS_STAT_INVALIDATED_NODES,
+  GTK_CSS_STAT_CREATED_STYLES,
+  GTK_CSS_STAT_ANIMATED_STYLES,
+  GTK_CSS_STAT_SELECTORS_VISITED,
+  GTK_CSS_STAT_BLOOM_REJECTIONS,
+  GTK_CSS_STAT_STYLE_CACHE_HITS,
+  GTK_CSS_STAT_STYLE_CACHE_MISSES,
+  /* times, in microseconds */
+  GTK_CSS_STAT_LOOKUP_TIME,
+  GTK_CSS_STAT_COMPUTE_TIME,
+  GTK_CSS_STAT_ANIMATION_TIME,
+  GTK_CSS_N_STATS
+} GtkCssStat;
+
+void                    gtk_css_stats_add                       (GtkCssStat      stat,
+                                                                 gssize          value);
+
+gboolean                gtk_css_stats_get_timing                (void);
+void                    gtk_css_stats_set_timing                (gboolean        timing);
+
+void                    gtk_css_stats_end_frame                 (gint64          time);
+
+void                    gtk_css_stats_get                       (GtkCssStat      stat,
+                                                                 gint64         *last_frame,
+                                                                 gint64         *total);
+void                    gtk_css_stats_reset                     (void);
+
+G_END_DECLS
+
+#endif /* __GTK_CSS_STATS_PRIVATE_H__ */
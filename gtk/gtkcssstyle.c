@@ -39,6 +39,8 @@
 #include "gtkstylepropertyprivate.h"
 #include "gtkstyleproviderprivate.h"
 
+#include <string.h>
+
 G_DEFINE_ABSTRACT_TYPE (GtkCssStyle, gtk_css_style, G_TYPE_OBJECT)
 
 static GtkCssSection *
@@ -712,12 +714,50 @@ GtkCssValues *gtk_css_values_ref (GtkCssValues *values)
   return values;
 }
 
+/* Interned value structs, so that the many nodes that end up with
+ * identical groups share them. The table does not hold a reference,
+ * values remove themselves when they are freed.
+ */
+static GHashTable *interned_values;
+
+static guint
+gtk_css_values_hash (gconstpointer data)
+{
+  const GtkCssValues *values = data;
+  GtkCssValue **v = GET_VALUES (values);
+  guint hash = TYPE_INDEX (values->type);
+  int i;
+
+  for (i = 0; i < N_VALUES (values->type); i++)
+    hash = (hash << 5) - hash + GPOINTER_TO_UINT (v[i]);
+
+  return hash;
+}
+
+static gboolean
+gtk_css_values_equal (gconstpointer data1,
+                      gconstpointer data2)
+{
+  const GtkCssValues *values1 = data1;
+  const GtkCssValues *values2 = data2;
+
+  if (TYPE_INDEX (values1->type) != TYPE_INDEX (values2->type))
+    return FALSE;
+
+  return memcmp (GET_VALUES (values1),
+                 GET_VALUES (values2),
+                 N_VALUES (values1->type) * sizeof (GtkCssValue *)) == 0;
+}
+
 static void
 gtk_css_values_free (GtkCssValues *values)
 {
   int i;
   GtkCssValue **v = GET_VALUES (values);
 
+  if (values->interned)
+    g_hash_table_remove (interned_values, values);
+
   for (i = 0; i < N_VALUES (values->type); i++)
     {
       if (v[i])
@@ -759,6 +799,47 @@ gtk_css_values_copy (GtkCssValues *values)
   return copy;
 }
 
+/*< private >
+ * gtk_css_values_intern:
+ * @values: (transfer full): the values to intern
+ *
+ * Looks for a value struct of the same type that holds the same
+ * values and returns it in place of @values, so that styles that
+ * computed the same values share them and comparing them is a
+ * pointer comparison in the common case.
+ *
+ * Values are compared by identity, which is cheap and catches the
+ * common case of values taken unchanged from the same declarations.
+ *
+ * Values must not be modified once they have been interned.
+ *
+ * Returns: (transfer full): the interned values
+ */
+GtkCssValues *
+gtk_css_values_intern (GtkCssValues *values)
+{
+  GtkCssValues *interned;
+
+  if (values->interned)
+    return values;
+
+  if (G_UNLIKELY (interned_values == NULL))
+    interned_values = g_hash_table_new (gtk_css_values_hash, gtk_css_values_equal);
+
+  interned = g_hash_table_lookup (interned_values, values);
+  if (interned)
+    {
+      gtk_css_values_ref (interned);
+      gtk_css_values_unref (values);
+      return interned;
+    }
+
+  values->interned = TRUE;
+  g_hash_table_add (interned_values, values);
+
+  return values;
+}
+
 GtkCssValues *
 gtk_css_values_new (GtkCssValuesType type)
 {
@@ -183,6 +183,34 @@ typedef enum {
 #define GTK_CSS_AFFECTS_TEXT (GTK_CSS_AFFECTS_TEXT_SIZE | \
                               GTK_CSS_AFFECTS_TEXT_CONTENT)
 
+/*
+ * GtkCssValueGroups:
+ *
+ * The groups of values that make up a #GtkCssStyle. These are used to
+ * track which parts of a style may differ after a change, so that the
+ * other groups can be taken from the previous style.
+ */
+typedef enum {
+  GTK_CSS_VALUE_GROUP_CORE         = (1 << 0),
+  GTK_CSS_VALUE_GROUP_BACKGROUND   = (1 << 1),
+  GTK_CSS_VALUE_GROUP_BORDER       = (1 << 2),
+  GTK_CSS_VALUE_GROUP_ICON         = (1 << 3),
+  GTK_CSS_VALUE_GROUP_OUTLINE      = (1 << 4),
+  GTK_CSS_VALUE_GROUP_FONT         = (1 << 5),
+  GTK_CSS_VALUE_GROUP_FONT_VARIANT = (1 << 6),
+  GTK_CSS_VALUE_GROUP_ANIMATION    = (1 << 7),
+  GTK_CSS_VALUE_GROUP_TRANSITION   = (1 << 8),
+  GTK_CSS_VALUE_GROUP_SIZE         = (1 << 9),
+  GTK_CSS_VALUE_GROUP_OTHER        = (1 << 10),
+} GtkCssValueGroups;
+
+#define GTK_CSS_VALUE_GROUPS_ALL ((1 << 11) - 1)
+
+/* The groups that contain inherited properties */
+#define GTK_CSS_VALUE_GROUPS_INHERITED (GTK_CSS_VALUE_GROUP_CORE | \
+                                        GTK_CSS_VALUE_GROUP_ICON | \
+                                        GTK_CSS_VALUE_GROUP_FONT)
+
 
 enum { /*< skip >*/
   GTK_CSS_PROPERTY_COLOR,
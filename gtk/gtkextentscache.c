@@ -0,0 +1,342 @@
+/*
+ * Copyright © 2020 GNOME Foundation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gtkextentscacheprivate.h"
+
+#include <string.h>
+
+/* A process-wide cache of layout extents.
+ *
+ * Widgets like GtkLabel measure their layouts for a number of
+ * widths during size negotiation, and a list with many rows shows
+ * the same strings over and over. Shaping is by far the most
+ * expensive part of measuring, so we remember the extents of the
+ * most recently measured layouts, keyed by everything that can
+ * influence them, and share them between all layouts.
+ */
+
+#define MAX_CACHED_EXTENTS 1024
+
+typedef struct
+{
+  GList link; /* in extents_lru, data points to the entry */
+  guint hash;
+
+  char *text;
+  GSList *attrs; /* owned copies, from pango_attr_list_get_attributes() */
+  PangoFontMap *font_map;
+  guint font_map_serial;
+  PangoFontDescription *font_desc;
+  PangoFontDescription *layout_font_desc;
+  PangoLanguage *language;
+  cairo_font_options_t *font_options;
+  double resolution;
+  int width;
+  int height;
+  guint base_dir : 4;
+  guint base_gravity : 3;
+  guint gravity_hint : 2;
+  guint wrap : 3;
+  guint ellipsize : 2;
+  guint alignment : 2;
+  guint justify : 1;
+  guint auto_dir : 1;
+  guint single_paragraph : 1;
+  guint round_glyph_positions : 1;
+
+  PangoRectangle logical_rect;
+  int baseline;
+} ExtentsEntry;
+
+static GHashTable *extents_cache;
+static GQueue extents_lru;
+
+static guint
+extents_entry_hash (gconstpointer data)
+{
+  const ExtentsEntry *entry = data;
+
+  return entry->hash;
+}
+
+static gboolean
+attrs_equal (GSList *attrs1,
+             GSList *attrs2)
+{
+  GSList *l1, *l2;
+
+  for (l1 = attrs1, l2 = attrs2; l1 && l2; l1 = l1->next, l2 = l2->next)
+    {
+      PangoAttribute *attr1 = l1->data;
+      PangoAttribute *attr2 = l2->data;
+
+      if (attr1->start_index != attr2->start_index ||
+          attr1->end_index != attr2->end_index ||
+          !pango_attribute_equal (attr1, attr2))
+        return FALSE;
+    }
+
+  return l1 == NULL && l2 == NULL;
+}
+
+static gboolean
+font_descriptions_equal (const PangoFontDescription *desc1,
+                         const PangoFontDescription *desc2)
+{
+  if (desc1 == desc2)
+    return TRUE;
+
+  if (desc1 == NULL || desc2 == NULL)
+    return FALSE;
+
+  return pango_font_description_equal (desc1, desc2);
+}
+
+static gboolean
+extents_entry_equal (gconstpointer data1,
+                     gconstpointer data2)
+{
+  const ExtentsEntry *entry1 = data1;
+  const ExtentsEntry *entry2 = data2;
+
+  if (entry1->hash != entry2->hash ||
+      entry1->width != entry2->width ||
+      entry1->height != entry2->height ||
+      entry1->font_map != entry2->font_map ||
+      entry1->font_map_serial != entry2->font_map_serial ||
+      entry1->language != entry2->language ||
+      entry1->resolution != entry2->resolution ||
+      entry1->base_dir != entry2->base_dir ||
+      entry1->base_gravity != entry2->base_gravity ||
+      entry1->gravity_hint != entry2->gravity_hint ||
+      entry1->wrap != entry2->wrap ||
+      entry1->ellipsize != entry2->ellipsize ||
+      entry1->alignment != entry2->alignment ||
+      entry1->justify != entry2->justify ||
+      entry1->auto_dir != entry2->auto_dir ||
+      entry1->single_paragraph != entry2->single_paragraph ||
+      entry1->round_glyph_positions != entry2->round_glyph_positions)
+    return FALSE;
+
+  if (strcmp (entry1->text, entry2->text) != 0)
+    return FALSE;
+
+  if (!font_descriptions_equal (entry1->font_desc, entry2->font_desc) ||
+      !font_descriptions_equal (entry1->layout_font_desc, entry2->layout_font_desc))
+    return FALSE;
+
+  if (entry1->font_options != entry2->font_options &&
+      (entry1->font_options == NULL || entry2->font_options == NULL ||
+       !cairo_font_options_equal (entry1->font_options, entry2->font_options)))
+    return FALSE;
+
+  return attrs_equal (entry1->attrs, entry2->attrs);
+}
+
+static void
+extents_entry_free (gpointer data)
+{
+  ExtentsEntry *entry = data;
+
+  g_free (entry->text);
+  g_slist_free_full (entry->attrs, (GDestroyNotify) pango_attribute_destroy);
+  g_clear_object (&entry->font_map);
+  g_clear_pointer (&entry->font_desc, pango_font_description_free);
+  g_clear_pointer (&entry->layout_font_desc, pango_font_description_free);
+  g_clear_pointer (&entry->font_options, cairo_font_options_destroy);
+  g_slice_free (ExtentsEntry, entry);
+}
+
+/* Fills in @key with borrowed pointers from @layout, for a lookup.
+ * The attributes are copied once here, so comparing keys doesn't
+ * need to, and must be freed with extents_entry_clear_key() unless
+ * the key is turned into an entry.
+ * Returns %FALSE if the layout uses features that we don't track.
+ */
+static gboolean
+extents_entry_init_key (ExtentsEntry *key,
+                        PangoLayout  *layout,
+                        int           width)
+{
+  PangoContext *context = pango_layout_get_context (layout);
+  PangoAttrList *attrs;
+  PangoTabArray *tabs;
+  GSList *l;
+
+  if (pango_context_get_matrix (context) != NULL ||
+      pango_layout_get_indent (layout) != 0 ||
+      pango_layout_get_spacing (layout) != 0)
+    return FALSE;
+
+  tabs = pango_layout_get_tabs (layout);
+  if (tabs != NULL)
+    {
+      pango_tab_array_free (tabs);
+      return FALSE;
+    }
+
+  memset (key, 0, sizeof (ExtentsEntry));
+
+  key->text = (char *) pango_layout_get_text (layout);
+  key->font_map = pango_context_get_font_map (context);
+  key->font_map_serial = key->font_map ? pango_font_map_get_serial (key->font_map) : 0;
+  key->font_desc = pango_context_get_font_description (context);
+  key->layout_font_desc = (PangoFontDescription *) pango_layout_get_font_description (layout);
+  key->language = pango_context_get_language (context);
+  key->font_options = (cairo_font_options_t *) pango_cairo_context_get_font_options (context);
+  key->resolution = pango_cairo_context_get_resolution (context);
+  key->width = width;
+  key->height = pango_layout_get_height (layout);
+  key->base_dir = pango_context_get_base_dir (context);
+  key->base_gravity = pango_context_get_base_gravity (context);
+  key->gravity_hint = pango_context_get_gravity_hint (context);
+  key->wrap = pango_layout_get_wrap (layout);
+  key->ellipsize = pango_layout_get_ellipsize (layout);
+  key->alignment = pango_layout_get_alignment (layout);
+  key->justify = pango_layout_get_justify (layout);
+  key->auto_dir = pango_layout_get_auto_dir (layout);
+  key->single_paragraph = pango_layout_get_single_paragraph_mode (layout);
+  key->round_glyph_positions = pango_context_get_round_glyph_positions (context);
+
+  key->hash = g_str_hash (key->text);
+  key->hash = key->hash * 31 + width;
+  if (key->font_desc)
+    key->hash = key->hash * 31 + pango_font_description_hash (key->font_desc);
+  if (key->layout_font_desc)
+    key->hash = key->hash * 31 + pango_font_description_hash (key->layout_font_desc);
+
+  attrs = pango_layout_get_attributes (layout);
+  if (attrs)
+    key->attrs = pango_attr_list_get_attributes (attrs);
+
+  for (l = key->attrs; l; l = l->next)
+    {
+      PangoAttribute *attr = l->data;
+
+      key->hash = key->hash * 31 + attr->klass->type;
+      key->hash = key->hash * 31 + attr->start_index;
+      key->hash = key->hash * 31 + attr->end_index;
+    }
+
+  return TRUE;
+}
+
+static void
+extents_entry_clear_key (ExtentsEntry *key)
+{
+  g_slist_free_full (key->attrs, (GDestroyNotify) pango_attribute_destroy);
+}
+
+/*
+ * gtk_pango_layout_get_cached_extents:
+ * @layout: a `PangoLayout`
+ * @width: the width to measure @layout at, in Pango units, or -1
+ * @logical_rect: (out): return location for the logical extents
+ * @baseline: (out): return location for the baseline, in Pango units
+ *
+ * Looks up the extents that a layout with the same text, attributes
+ * and settings as @layout, but with a width of @width, was measured
+ * to have. Results are stored with gtk_pango_layout_cache_extents().
+ *
+ * Returns: %TRUE if the extents were found
+ */
+gboolean
+gtk_pango_layout_get_cached_extents (PangoLayout    *layout,
+                                     int             width,
+                                     PangoRectangle *logical_rect,
+                                     int            *baseline)
+{
+  ExtentsEntry key;
+  ExtentsEntry *entry;
+
+  if (extents_cache == NULL)
+    return FALSE;
+
+  if (!extents_entry_init_key (&key, layout, width))
+    return FALSE;
+
+  entry = g_hash_table_lookup (extents_cache, &key);
+  extents_entry_clear_key (&key);
+  if (entry == NULL)
+    return FALSE;
+
+  g_queue_unlink (&extents_lru, &entry->link);
+  g_queue_push_head_link (&extents_lru, &entry->link);
+
+  *logical_rect = entry->logical_rect;
+  *baseline = entry->baseline;
+
+  return TRUE;
+}
+
+/*
+ * gtk_pango_layout_cache_extents:
+ * @layout: a `PangoLayout`
+ * @width: the width @layout was measured at, in Pango units, or -1
+ * @logical_rect: the logical extents
+ * @baseline: the baseline, in Pango units
+ *
+ * Remembers the extents of @layout at @width, so that they can be
+ * found with gtk_pango_layout_get_cached_extents() for any layout
+ * with the same contents. The least recently used entries are
+ * dropped once the cache is full.
+ */
+void
+gtk_pango_layout_cache_extents (PangoLayout          *layout,
+                                int                   width,
+                                const PangoRectangle *logical_rect,
+                                int                   baseline)
+{
+  ExtentsEntry key;
+  ExtentsEntry *entry;
+
+  if (!extents_entry_init_key (&key, layout, width))
+    return;
+
+  if (extents_cache == NULL)
+    extents_cache = g_hash_table_new_full (extents_entry_hash, extents_entry_equal,
+                                           extents_entry_free, NULL);
+  else if (g_hash_table_contains (extents_cache, &key))
+    {
+      extents_entry_clear_key (&key);
+      return;
+    }
+
+  /* The entry takes over the attributes of the key */
+  entry = g_slice_dup (ExtentsEntry, &key);
+  entry->link.data = entry;
+  entry->text = g_strdup (key.text);
+  entry->font_map = key.font_map ? g_object_ref (key.font_map) : NULL;
+  entry->font_desc = key.font_desc ? pango_font_description_copy (key.font_desc) : NULL;
+  entry->layout_font_desc = key.layout_font_desc ? pango_font_description_copy (key.layout_font_desc) : NULL;
+  entry->font_options = key.font_options ? cairo_font_options_copy (key.font_options) : NULL;
+  entry->logical_rect = *logical_rect;
+  entry->baseline = baseline;
+
+  g_hash_table_add (extents_cache, entry);
+  g_queue_push_head_link (&extents_lru, &entry->link);
+
+  while (extents_lru.length > MAX_CACHED_EXTENTS)
+    {
+      ExtentsEntry *last = g_queue_peek_tail (&extents_lru);
+
+      g_queue_unlink (&extents_lru, &last->link);
+      g_hash_table_remove (extents_cache, last);
+    }
+}
@@ -31,6 +31,7 @@
 #include "gtkcssnodeprivate.h"
 #include "gtkcssstylepropertyprivate.h"
 #include "gtkeventcontrollermotion.h"
+#include "gtkextentscacheprivate.h"
 #include "gtkgesturedrag.h"
 #include "gtkgestureclick.h"
 #include "gtkgesturesingle.h"
@@ -2768,7 +2769,6 @@ gtk_label_clear_layout (GtkLabel *self)
 /**
  * gtk_label_get_measuring_layout:
  * @self: the label
- * @existing_layout: %NULL or an existing layout already in use.
  * @width: the width to measure with in pango units, or -1 for infinite
  *
  * Gets a layout that can be used for measuring sizes. The returned
@@ -2779,24 +2779,12 @@ gtk_label_clear_layout (GtkLabel *self)
  * Returns: a new reference to a pango layout
  **/
 static PangoLayout *
-gtk_label_get_measuring_layout (GtkLabel    *self,
-                                PangoLayout *existing_layout,
-                                int          width)
+gtk_label_get_measuring_layout (GtkLabel *self,
+                                int       width)
 {
   PangoRectangle rect;
   PangoLayout *copy;
 
-  if (existing_layout != NULL)
-    {
-      if (existing_layout != self->layout)
-        {
-          pango_layout_set_width (existing_layout, width);
-          return existing_layout;
-        }
-
-      g_object_unref (existing_layout);
-    }
-
   gtk_label_ensure_layout (self);
 
   if (pango_layout_get_width (self->layout) == width)
@@ -2835,6 +2823,33 @@ gtk_label_get_measuring_layout (GtkLabel    *self,
   return copy;
 }
 
+/* Measures the label's layout at @width, in pango units.
+ *
+ * Lists often contain many labels with the same text, so the
+ * results are shared between all labels with the same text,
+ * attributes and font settings.
+ */
+static void
+gtk_label_get_layout_extents (GtkLabel       *self,
+                              int             width,
+                              PangoRectangle *logical_rect,
+                              int            *baseline)
+{
+  PangoLayout *layout;
+
+  gtk_label_ensure_layout (self);
+
+  if (gtk_pango_layout_get_cached_extents (self->layout, width, logical_rect, baseline))
+    return;
+
+  layout = gtk_label_get_measuring_layout (self, width);
+  pango_layout_get_extents (layout, NULL, logical_rect);
+  *baseline = pango_layout_get_baseline (layout);
+  g_object_unref (layout);
+
+  gtk_pango_layout_cache_extents (self->layout, width, logical_rect, *baseline);
+}
+
 static void
 gtk_label_update_layout_attributes (GtkLabel      *self,
                                     PangoAttrList *style_attrs)
@@ -2976,21 +2991,20 @@ get_height_for_width (GtkLabel *self,
                       int      *minimum_baseline,
                       int      *natural_baseline)
 {
-  PangoLayout *layout;
+  PangoRectangle logical_rect;
   int text_height, baseline;
 
-  layout = gtk_label_get_measuring_layout (self, NULL, width * PANGO_SCALE);
+  gtk_label_get_layout_extents (self, width * PANGO_SCALE, &logical_rect, &baseline);
 
-  pango_layout_get_pixel_size (layout, NULL, &text_height);
+  pango_extents_to_pixels (&logical_rect, NULL);
+  text_height = logical_rect.height;
 
   *minimum_height = text_height;
   *natural_height = text_height;
 
-  baseline = pango_layout_get_baseline (layout) / PANGO_SCALE;
+  baseline = baseline / PANGO_SCALE;
   *minimum_baseline = baseline;
   *natural_baseline = baseline;
-
-  g_object_unref (layout);
 }
 
 static int
@@ -3019,8 +3033,8 @@ gtk_label_get_preferred_layout_size (GtkLabel *self,
                                      int *smallest_baseline,
                                      int *widest_baseline)
 {
-  PangoLayout *layout;
   int char_pixels;
+  int baseline;
 
   /* "width-chars" Hard-coded minimum width:
    *    - minimum size should be MAX (width-chars, strlen ("..."));
@@ -3038,43 +3052,40 @@ gtk_label_get_preferred_layout_size (GtkLabel *self,
    *    width will default to the wrap guess that gtk_label_ensure_layout() does.
    */
 
-  /* Start off with the pixel extents of an as-wide-as-possible layout */
-  layout = gtk_label_get_measuring_layout (self, NULL, -1);
+  gtk_label_ensure_layout (self);
 
   if (self->width_chars > -1 || self->max_width_chars > -1)
-    char_pixels = get_char_pixels (GTK_WIDGET (self), layout);
+    char_pixels = get_char_pixels (GTK_WIDGET (self), self->layout);
   else
     char_pixels = 0;
 
-  pango_layout_get_extents (layout, NULL, widest);
+  /* Start off with the pixel extents of an as-wide-as-possible layout */
+  gtk_label_get_layout_extents (self, -1, widest, &baseline);
   widest->width = MAX (widest->width, char_pixels * self->width_chars);
   widest->x = widest->y = 0;
-  *widest_baseline = pango_layout_get_baseline (layout) / PANGO_SCALE;
+  *widest_baseline = baseline / PANGO_SCALE;
 
   if (self->ellipsize || self->wrap)
     {
       /* a layout with width 0 will be as small as humanly possible */
-      layout = gtk_label_get_measuring_layout (self,
-                                               layout,
-                                               self->width_chars > -1 ? char_pixels * self->width_chars
-                                                                      : 0);
-
-      pango_layout_get_extents (layout, NULL, smallest);
+      gtk_label_get_layout_extents (self,
+                                    self->width_chars > -1 ? char_pixels * self->width_chars
+                                                           : 0,
+                                    smallest, &baseline);
       smallest->width = MAX (smallest->width, char_pixels * self->width_chars);
       smallest->x = smallest->y = 0;
 
-      *smallest_baseline = pango_layout_get_baseline (layout) / PANGO_SCALE;
+      *smallest_baseline = baseline / PANGO_SCALE;
 
       if (self->max_width_chars > -1 && widest->width > char_pixels * self->max_width_chars)
         {
-          layout = gtk_label_get_measuring_layout (self,
-                                                   layout,
-                                                   MAX (smallest->width, char_pixels * self->max_width_chars));
-          pango_layout_get_extents (layout, NULL, widest);
+          gtk_label_get_layout_extents (self,
+                                        MAX (smallest->width, char_pixels * self->max_width_chars),
+                                        widest, &baseline);
           widest->width = MAX (widest->width, char_pixels * self->width_chars);
           widest->x = widest->y = 0;
 
-          *widest_baseline = pango_layout_get_baseline (layout) / PANGO_SCALE;
+          *widest_baseline = baseline / PANGO_SCALE;
         }
 
       if (widest->width < smallest->width)
@@ -3088,8 +3099,6 @@ gtk_label_get_preferred_layout_size (GtkLabel *self,
       *smallest = *widest;
       *smallest_baseline = *widest_baseline;
     }
-
-  g_object_unref (layout);
 }
 
 static void
@@ -24,6 +24,7 @@
 
 #include "config.h"
 #include "gtkpango.h"
+#include <string.h>
 #include <pango/pangocairo.h>
 #include "gtkintl.h"
 #include "gtkbuilderprivate.h"
@@ -1366,7 +1366,10 @@ create_arrow_render_node (GtkPopover *popover)
   GtkBorder border;
   cairo_t *cr;
   GtkSnapshot *snapshot;
+  GskRenderNodeArena *arena;
 
+  /* The arrow is kept across snapshots, don't keep the popover's arena alive */
+  arena = gsk_render_node_arena_begin (0);
   snapshot = gtk_snapshot_new ();
 
   cr = gtk_snapshot_append_cairo (snapshot,
@@ -1414,6 +1417,7 @@ create_arrow_render_node (GtkPopover *popover)
   gtk_style_context_restore (context);
 
   priv->arrow_render_node = gtk_snapshot_free_to_node (snapshot);
+  gsk_render_node_arena_end (arena);
 }
 
 static void
@@ -202,6 +202,26 @@ gtk_style_cascade_lookup (GtkStyleProvider             *provider,
   gtk_style_cascade_iter_clear (&iter);
 }
 
+static GtkCssValueGroups
+gtk_style_cascade_get_change_groups (GtkStyleProvider *provider,
+                                     GtkCssChange      change)
+{
+  GtkStyleCascade *cascade = GTK_STYLE_CASCADE (provider);
+  GtkStyleCascadeIter iter;
+  GtkStyleProvider *item;
+  GtkCssValueGroups groups = 0;
+
+  for (item = gtk_style_cascade_iter_init (cascade, &iter);
+       item;
+       item = gtk_style_cascade_iter_next (cascade, &iter))
+    {
+      groups |= gtk_style_provider_get_change_groups (item, change);
+    }
+  gtk_style_cascade_iter_clear (&iter);
+
+  return groups;
+}
+
 static void
 gtk_style_cascade_provider_iface_init (GtkStyleProviderInterface *iface)
 {
@@ -210,6 +230,7 @@ gtk_style_cascade_provider_iface_init (GtkStyleProviderInterface *iface)
   iface->get_scale = gtk_style_cascade_get_scale;
   iface->get_keyframes = gtk_style_cascade_get_keyframes;
   iface->lookup = gtk_style_cascade_lookup;
+  iface->get_change_groups = gtk_style_cascade_get_change_groups;
 }
 
 G_DEFINE_TYPE_EXTENDED (GtkStyleCascade, _gtk_style_cascade, G_TYPE_OBJECT, 0,
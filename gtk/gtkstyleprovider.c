@@ -115,6 +115,36 @@ gtk_style_provider_lookup (GtkStyleProvider             *provider,
   iface->lookup (provider, filter, node, lookup, out_change);
 }
 
+/*< private >
+ * gtk_style_provider_get_change_groups:
+ * @provider: the provider
+ * @change: the changes to a node since its style was last looked up
+ *
+ * Determines which groups of values could be different in the
+ * results of a new lookup of the node, because they are set by
+ * rules whose matching depends on @change.
+ *
+ * Returns: the value groups that may have changed
+ */
+GtkCssValueGroups
+gtk_style_provider_get_change_groups (GtkStyleProvider *provider,
+                                      GtkCssChange      change)
+{
+  GtkStyleProviderInterface *iface;
+
+  gtk_internal_return_val_if_fail (GTK_IS_STYLE_PROVIDER (provider), GTK_CSS_VALUE_GROUPS_ALL);
+
+  iface = GTK_STYLE_PROVIDER_GET_INTERFACE (provider);
+
+  if (!iface->lookup)
+    return 0;
+
+  if (!iface->get_change_groups)
+    return GTK_CSS_VALUE_GROUPS_ALL;
+
+  return iface->get_change_groups (provider, change);
+}
+
 void
 gtk_style_provider_changed (GtkStyleProvider *provider)
 {
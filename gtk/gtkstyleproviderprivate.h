@@ -47,6 +47,8 @@ struct _GtkStyleProviderInterface
                                                  GtkCssNode              *node,
                                                  GtkCssLookup            *lookup,
                                                  GtkCssChange            *out_change);
+  GtkCssValueGroups     (* get_change_groups)   (GtkStyleProvider        *provider,
+                                                 GtkCssChange             change);
   void                  (* emit_error)          (GtkStyleProvider        *provider,
                                                  GtkCssSection           *section,
                                                  const GError            *error);
@@ -65,6 +67,8 @@ void                    gtk_style_provider_lookup                (GtkStyleProvid
                                                                   GtkCssNode              *node,
                                                                   GtkCssLookup            *lookup,
                                                                   GtkCssChange            *out_change);
+GtkCssValueGroups       gtk_style_provider_get_change_groups     (GtkStyleProvider        *provider,
+                                                                  GtkCssChange             change);
 
 void                    gtk_style_provider_changed               (GtkStyleProvider        *provider);
 
@@ -246,6 +246,11 @@ struct _GtkTextBTree {
 #define MIN_CHILDREN 3
 #endif
 
+/* Inserting at least this many bytes into an empty buffer builds
+ * the tree bottom-up, see gtk_text_btree_build().
+ */
+#define BULK_INSERT_MIN_LENGTH 4096
+
 /*
  * Prototypes
  */
@@ -255,6 +260,7 @@ static BTreeView        *gtk_text_btree_get_view                 (GtkTextBTree
 static void              gtk_text_btree_rebalance                (GtkTextBTree     *tree,
                                                                   GtkTextBTreeNode *node);
 static GtkTextLine     * get_last_line                           (GtkTextBTree     *tree);
+static void              gtk_text_btree_build                    (GtkTextBTree     *tree);
 static void              post_insert_fixup                       (GtkTextBTree     *tree,
                                                                   GtkTextLine      *insert_line,
                                                                   int               char_count_delta,
@@ -1090,6 +1096,81 @@ _gtk_text_btree_delete (GtkTextIter *start,
   gtk_text_btree_resolve_bidi (start, end);
 }
 
+/* Like pango_find_paragraph_boundary(), but only looks at the bytes
+ * that can start a paragraph separator instead of decoding every
+ * character, which matters when loading large documents.
+ */
+static void
+find_paragraph_boundary (const char *text,
+                         int         len,
+                         int        *delim,
+                         int        *next_start)
+{
+  const char *p, *end;
+
+  end = text + len;
+  for (p = text; p < end; p++)
+    {
+      switch ((guchar) *p)
+        {
+        case '\n':
+          *delim = p - text;
+          *next_start = *delim + 1;
+          return;
+
+        case '\r':
+          *delim = p - text;
+          if (p + 1 < end && p[1] == '\n')
+            *next_start = *delim + 2;
+          else
+            *next_start = *delim + 1;
+          return;
+
+        case 0xe2:
+          /* U+2029 PARAGRAPH SEPARATOR */
+          if (p + 2 < end && (guchar) p[1] == 0x80 && (guchar) p[2] == 0xa9)
+            {
+              *delim = p - text;
+              *next_start = *delim + 3;
+              return;
+            }
+          break;
+
+        default:
+          break;
+        }
+    }
+
+  *delim = len;
+  *next_start = len;
+}
+
+/* Whether the tree holds no text and no tag toggles, so that
+ * it can be rebuilt from scratch by gtk_text_btree_build().
+ */
+static gboolean
+gtk_text_btree_is_empty (GtkTextBTree *tree)
+{
+  GtkTextLine *line;
+  GtkTextLineSegment *seg;
+
+  if (tree->root_node->level != 0 ||
+      tree->root_node->num_chars != 2)
+    return FALSE;
+
+  for (line = tree->root_node->children.line; line; line = line->next)
+    {
+      for (seg = line->segments; seg; seg = seg->next)
+        {
+          if (seg->type == &gtk_text_toggle_on_type ||
+              seg->type == &gtk_text_toggle_off_type)
+            return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
 void
 _gtk_text_btree_insert (GtkTextIter *iter,
                         const char *text,
@@ -1120,6 +1201,7 @@ _gtk_text_btree_insert (GtkTextIter *iter,
   GtkTextBTree *tree;
   int start_byte_index;
   GtkTextLine *start_line;
+  gboolean bulk;
 
   g_return_if_fail (text != NULL);
   g_return_if_fail (iter != NULL);
@@ -1142,6 +1224,14 @@ _gtk_text_btree_insert (GtkTextIter *iter,
   prev_seg = gtk_text_line_segment_split (iter);
   cur_seg = prev_seg;
 
+  /* When loading a document into an empty buffer, don't keep the
+   * tree balanced while adding lines. Splitting the node that
+   * receives all the new lines over and over is most of the cost
+   * of such an insertion, building the tree once at the end is
+   * linear in the number of lines.
+   */
+  bulk = len >= BULK_INSERT_MIN_LENGTH && gtk_text_btree_is_empty (tree);
+
   /* Invalidate all iterators */
   chars_changed (tree);
   segments_changed (tree);
@@ -1160,10 +1250,10 @@ _gtk_text_btree_insert (GtkTextIter *iter,
     {
       sol = eol;
       
-      pango_find_paragraph_boundary (text + sol,
-                                     len - sol,
-                                     &delim,
-                                     &eol);      
+      find_paragraph_boundary (text + sol,
+                               len - sol,
+                               &delim,
+                               &eol);
 
       /* make these relative to the start of the text */
       delim += sol;
@@ -1206,7 +1296,10 @@ _gtk_text_btree_insert (GtkTextIter *iter,
        */
 
       newline = gtk_text_line_new ();
-      gtk_text_line_set_parent (newline, line->parent);
+      if (bulk)
+        newline->parent = line->parent;
+      else
+        gtk_text_line_set_parent (newline, line->parent);
       newline->next = line->next;
       line->next = newline;
       newline->segments = seg->next;
@@ -1227,7 +1320,17 @@ _gtk_text_btree_insert (GtkTextIter *iter,
       cleanup_line (line);
     }
 
-  post_insert_fixup (tree, line, line_count_delta, char_count_delta);
+  if (bulk)
+    {
+      gtk_text_btree_build (tree);
+
+#ifdef G_ENABLE_DEBUG
+      if (GTK_DEBUG_CHECK (TEXT))
+        _gtk_text_btree_check (tree);
+#endif
+    }
+  else
+    post_insert_fixup (tree, line, line_count_delta, char_count_delta);
 
   /* Invalidate our region, and reset the iterator the user
      passed in to point to the end of the inserted text. */
@@ -1764,11 +1867,16 @@ queue_tag_redisplay (GtkTextBTree      *tree,
   /* We don't need to do anything if the tag doesn't affect display */
 }
 
-void
-_gtk_text_btree_tag (const GtkTextIter *start_orig,
-                     const GtkTextIter *end_orig,
-                     GtkTextTag        *tag,
-                     gboolean           add)
+/* Adds or removes tag from the range between start and end, which
+ * must be in order and not empty. Doesn't queue a redisplay.
+ */
+static void
+tag_range (GtkTextBTree      *tree,
+           GtkTextTagInfo    *info,
+           GtkTextTag        *tag,
+           const GtkTextIter *start,
+           const GtkTextIter *end,
+           gboolean           add)
 {
   GtkTextLineSegment *seg, *prev;
   GtkTextLine *cleanupline;
@@ -1776,49 +1884,17 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
   GtkTextLine *start_line;
   GtkTextLine *end_line;
   GtkTextIter iter;
-  GtkTextIter start, end;
-  GtkTextBTree *tree;
   IterStack *stack;
-  GtkTextTagInfo *info;
 
-  g_return_if_fail (start_orig != NULL);
-  g_return_if_fail (end_orig != NULL);
-  g_return_if_fail (GTK_IS_TEXT_TAG (tag));
-  g_return_if_fail (_gtk_text_iter_get_btree (start_orig) ==
-                    _gtk_text_iter_get_btree (end_orig));
-  g_return_if_fail (tag->priv->table == _gtk_text_iter_get_btree (start_orig)->table);
-  
-#if 0
-  printf ("%s tag %s from %d to %d\n",
-          add ? "Adding" : "Removing",
-          tag->name,
-          gtk_text_buffer_get_offset (start_orig),
-          gtk_text_buffer_get_offset (end_orig));
-#endif
-
-  if (gtk_text_iter_equal (start_orig, end_orig))
-    return;
-
-  start = *start_orig;
-  end = *end_orig;
-
-  gtk_text_iter_order (&start, &end);
-
-  tree = _gtk_text_iter_get_btree (&start);
-
-  queue_tag_redisplay (tree, tag, &start, &end);
-
-  info = gtk_text_btree_get_tag_info (tree, tag);
-
-  start_line = _gtk_text_iter_get_text_line (&start);
-  end_line = _gtk_text_iter_get_text_line (&end);
+  start_line = _gtk_text_iter_get_text_line (start);
+  end_line = _gtk_text_iter_get_text_line (end);
 
   /* Find all tag toggles in the region; we are going to delete them.
      We need to find them in advance, because
      forward_find_tag_toggle () won't work once we start playing around
      with the tree. */
   stack = iter_stack_new ();
-  iter = start;
+  iter = *start;
 
   /* forward_to_tag_toggle() skips a toggle at the start iterator,
    * which is deliberate - we don't want to delete a toggle at the
@@ -1826,7 +1902,7 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
    */
   while (gtk_text_iter_forward_to_tag_toggle (&iter, tag))
     {
-      if (gtk_text_iter_compare (&iter, &end) >= 0)
+      if (gtk_text_iter_compare (&iter, end) >= 0)
         break;
       else
         iter_stack_push (stack, &iter);
@@ -1841,7 +1917,7 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
    * there.
    */
 
-  toggled_on = gtk_text_iter_has_tag (&start, tag);
+  toggled_on = gtk_text_iter_has_tag (start, tag);
   if ( (add && !toggled_on) ||
        (!add && toggled_on) )
     {
@@ -1849,7 +1925,7 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
          cleanup_line () will remove it if so. */
       seg = _gtk_toggle_segment_new (info, add);
 
-      prev = gtk_text_line_segment_split (&start);
+      prev = gtk_text_line_segment_split (start);
       if (prev == NULL)
         {
           seg->next = start_line->segments;
@@ -1984,7 +2060,7 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
 
       seg = _gtk_toggle_segment_new (info, !add);
 
-      prev = gtk_text_line_segment_split (&end);
+      prev = gtk_text_line_segment_split (end);
       if (prev == NULL)
         {
           seg->next = end_line->segments;
@@ -2014,6 +2090,48 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
     }
 
   segments_changed (tree);
+}
+
+void
+_gtk_text_btree_tag (const GtkTextIter *start_orig,
+                     const GtkTextIter *end_orig,
+                     GtkTextTag        *tag,
+                     gboolean           add)
+{
+  GtkTextIter start, end;
+  GtkTextBTree *tree;
+  GtkTextTagInfo *info;
+
+  g_return_if_fail (start_orig != NULL);
+  g_return_if_fail (end_orig != NULL);
+  g_return_if_fail (GTK_IS_TEXT_TAG (tag));
+  g_return_if_fail (_gtk_text_iter_get_btree (start_orig) ==
+                    _gtk_text_iter_get_btree (end_orig));
+  g_return_if_fail (tag->priv->table == _gtk_text_iter_get_btree (start_orig)->table);
+  
+#if 0
+  printf ("%s tag %s from %d to %d\n",
+          add ? "Adding" : "Removing",
+          tag->name,
+          gtk_text_buffer_get_offset (start_orig),
+          gtk_text_buffer_get_offset (end_orig));
+#endif
+
+  if (gtk_text_iter_equal (start_orig, end_orig))
+    return;
+
+  start = *start_orig;
+  end = *end_orig;
+
+  gtk_text_iter_order (&start, &end);
+
+  tree = _gtk_text_iter_get_btree (&start);
+
+  queue_tag_redisplay (tree, tag, &start, &end);
+
+  info = gtk_text_btree_get_tag_info (tree, tag);
+
+  tag_range (tree, info, tag, &start, &end, add);
 
   queue_tag_redisplay (tree, tag, &start, &end);
 
@@ -2023,6 +2141,70 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
 #endif
 }
 
+/*< private >
+ * _gtk_text_btree_tag_ranges:
+ * @tree: a #GtkTextBTree
+ * @tag: the tag to add or remove
+ * @offsets: start and end character offsets of the ranges, sorted
+ *   and not overlapping
+ * @n_offsets: the number of offsets, twice the number of ranges
+ * @add: whether to add or remove @tag
+ *
+ * Like _gtk_text_btree_tag() for many ranges at once. The ranges
+ * are visited in a single pass, and redisplay is only queued once
+ * for the area they span.
+ */
+void
+_gtk_text_btree_tag_ranges (GtkTextBTree *tree,
+                            GtkTextTag   *tag,
+                            const int    *offsets,
+                            guint         n_offsets,
+                            gboolean      add)
+{
+  GtkTextIter first, last, start, end;
+  GtkTextTagInfo *info;
+  guint i;
+
+  g_return_if_fail (GTK_IS_TEXT_TAG (tag));
+  g_return_if_fail (tag->priv->table == tree->table);
+  g_return_if_fail (n_offsets % 2 == 0);
+
+  if (n_offsets == 0)
+    return;
+
+  _gtk_text_btree_get_iter_at_char (tree, &first, offsets[0]);
+  _gtk_text_btree_get_iter_at_char (tree, &last, offsets[n_offsets - 1]);
+
+  queue_tag_redisplay (tree, tag, &first, &last);
+
+  info = gtk_text_btree_get_tag_info (tree, tag);
+
+  /* Tagging doesn't change character offsets, so the iterators stay
+   * valid and each range can be found by moving forward from the
+   * end of the previous one.
+   */
+  end = first;
+  for (i = 0; i < n_offsets; i += 2)
+    {
+      start = end;
+      if (i > 0)
+        gtk_text_iter_forward_chars (&start, offsets[i] - offsets[i - 1]);
+
+      end = start;
+      gtk_text_iter_forward_chars (&end, offsets[i + 1] - offsets[i]);
+
+      if (!gtk_text_iter_equal (&start, &end))
+        tag_range (tree, info, tag, &start, &end, add);
+    }
+
+  queue_tag_redisplay (tree, tag, &first, &last);
+
+#ifdef G_ENABLE_DEBUG
+  if (GTK_DEBUG_CHECK (TEXT))
+    _gtk_text_btree_check (tree);
+#endif
+}
+
 
 /*
  * "Getters"
@@ -5981,6 +6163,130 @@ gtk_text_btree_rebalance (GtkTextBTree *tree,
     }
 }
 
+/* Distribute n_children over as few nodes as possible while
+ * leaving some room in each of them, so that editing the document
+ * doesn't immediately cause splits.
+ */
+static int
+build_n_nodes (int n_children)
+{
+  int fill, n_nodes;
+
+  fill = (MIN_CHILDREN + MAX_CHILDREN) / 2;
+  n_nodes = (n_children + fill - 1) / fill;
+
+  return MAX (1, MIN (n_nodes, n_children / MIN_CHILDREN));
+}
+
+/* Build one level of the tree above the n_children lines or nodes
+ * starting at first_child, and return the first of the new nodes.
+ */
+static GtkTextBTreeNode *
+build_level (GtkTextBTree *tree,
+             int           level,
+             gpointer      first_child,
+             int           n_children,
+             int          *n_nodes)
+{
+  GtkTextBTreeNode *first, **next_p;
+  gpointer child;
+  int i, j;
+
+  *n_nodes = build_n_nodes (n_children);
+
+  first = NULL;
+  next_p = &first;
+  child = first_child;
+
+  for (i = 0; i < *n_nodes; i++)
+    {
+      GtkTextBTreeNode *node;
+      int count;
+
+      count = n_children / *n_nodes;
+      if (i < n_children % *n_nodes)
+        count++;
+
+      node = gtk_text_btree_node_new ();
+      node->parent = NULL;
+      node->next = NULL;
+      node->summary = NULL;
+      node->level = level;
+
+      if (level == 0)
+        {
+          GtkTextLine *line = child;
+
+          node->children.line = line;
+          for (j = 1; j < count; j++)
+            line = line->next;
+          child = line->next;
+          line->next = NULL;
+        }
+      else
+        {
+          GtkTextBTreeNode *child_node = child;
+
+          node->children.node = child_node;
+          for (j = 1; j < count; j++)
+            child_node = child_node->next;
+          child = child_node->next;
+          child_node->next = NULL;
+        }
+
+      recompute_node_counts (tree, node);
+
+      *next_p = node;
+      next_p = &node->next;
+    }
+
+  return first;
+}
+
+/* Rebuild the tree bottom-up from the lines of its root, which
+ * must be a leaf. The lines may be arbitrarily many, and their
+ * parent pointers may be stale. Tag toggles are not supported,
+ * see gtk_text_btree_is_empty().
+ *
+ * The root node is kept, since views and tags may refer to it.
+ */
+static void
+gtk_text_btree_build (GtkTextBTree *tree)
+{
+  GtkTextBTreeNode *root, *first;
+  GtkTextLine *line;
+  gpointer children;
+  int n_children, level;
+
+  root = tree->root_node;
+
+  g_assert (root->level == 0);
+  g_assert (root->summary == NULL);
+
+  n_children = 0;
+  for (line = root->children.line; line; line = line->next)
+    n_children++;
+
+  children = root->children.line;
+  level = 0;
+
+  while (n_children > MAX_CHILDREN)
+    {
+      first = build_level (tree, level, children, n_children, &n_children);
+
+      children = first;
+      level++;
+    }
+
+  root->level = level;
+  if (level == 0)
+    root->children.line = children;
+  else
+    root->children.node = children;
+
+  recompute_node_counts (tree, root);
+}
+
 static void
 post_insert_fixup (GtkTextBTree *tree,
                    GtkTextLine *line,
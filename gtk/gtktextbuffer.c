@@ -68,6 +68,13 @@ struct _GtkTextBufferPrivate
 
   guint user_action_count;
 
+  /* The ranges of gtk_text_buffer_apply_tag_ranges() and
+   * gtk_text_buffer_remove_tag_ranges(), while the signal for
+   * their span is emitted */
+  GtkTextTag *pending_tag;
+  const int *pending_offsets;
+  guint n_pending_offsets;
+
   /* Whether the buffer has been modified since last save */
   guint modified : 1;
   guint has_selection : 1;
@@ -792,9 +799,14 @@ gtk_text_buffer_class_init (GtkTextBufferClass *klass)
    * 
    * Note that if your handler runs before the default handler it must not 
    * invalidate the @start and @end iters (or has to revalidate them). 
+   *
+   * For gtk_text_buffer_apply_tag_ranges(), the signal is emitted once,
+   * from the start of the first range to the end of the last one. The
+   * default handler then only applies the tag to the ranges.
    * 
    * See also: 
    * gtk_text_buffer_apply_tag(),
+   * gtk_text_buffer_apply_tag_ranges(),
    * gtk_text_buffer_insert_with_tags(),
    * gtk_text_buffer_insert_range().
    */ 
@@ -828,9 +840,14 @@ gtk_text_buffer_class_init (GtkTextBufferClass *klass)
    * 
    * Note that if your handler runs before the default handler it must not 
    * invalidate the @start and @end iters (or has to revalidate them). 
+   *
+   * For gtk_text_buffer_remove_tag_ranges(), the signal is emitted once,
+   * from the start of the first range to the end of the last one. The
+   * default handler then only removes the tag from the ranges.
    * 
    * See also: 
-   * gtk_text_buffer_remove_tag(). 
+   * gtk_text_buffer_remove_tag(),
+   * gtk_text_buffer_remove_tag_ranges(). 
    */ 
   signals[REMOVE_TAG] =
     g_signal_new (I_("remove-tag"),
@@ -1172,6 +1189,12 @@ gtk_text_buffer_get_tag_table (GtkTextBuffer *buffer)
  *
  * Deletes current contents of @buffer, and inserts @text instead. If
  * @len is -1, @text must be nul-terminated. @text must be valid UTF-8.
+ *
+ * This is the most efficient way to load a large document into a
+ * buffer. The time it takes is linear in the size of @text, and
+ * ::insert-text and ::changed are only emitted once. To avoid an
+ * extra copy of a large file, consider mapping it into memory
+ * with g_mapped_file_new() and passing its contents here.
  **/
 void
 gtk_text_buffer_set_text (GtkTextBuffer *buffer,
@@ -2238,6 +2261,398 @@ gtk_text_buffer_get_slice (GtkTextBuffer     *buffer,
     return gtk_text_iter_get_visible_slice (start, end);
 }
 
+/*
+ * Searching
+ */
+
+typedef struct {
+  char *text;
+  gsize length;
+  guint stamp;
+
+  char *needle;
+  GRegex *regex;
+  GRegexMatchFlags match_flags;
+
+  GtkTextBufferMatchFunc match_func;
+  gpointer user_data;
+
+  /* Matches found by the worker thread, as pairs of char offsets,
+   * waiting to be delivered in the main thread.
+   */
+  GMutex lock;
+  GArray *pending;
+  gboolean deliver_queued;
+  guint n_matches;
+
+  int stale;
+} SearchData;
+
+static void
+search_data_free (gpointer data)
+{
+  SearchData *search = data;
+
+  g_free (search->text);
+  g_free (search->needle);
+  g_clear_pointer (&search->regex, g_regex_unref);
+  g_array_unref (search->pending);
+  g_mutex_clear (&search->lock);
+
+  g_slice_free (SearchData, search);
+}
+
+static void
+search_deliver (GTask *task)
+{
+  GtkTextBuffer *buffer = g_task_get_source_object (task);
+  SearchData *search = g_task_get_task_data (task);
+  GArray *matches;
+  guint i;
+
+  g_mutex_lock (&search->lock);
+  matches = search->pending;
+  search->pending = g_array_new (FALSE, FALSE, sizeof (int));
+  search->deliver_queued = FALSE;
+  g_mutex_unlock (&search->lock);
+
+  /* The offsets refer to the snapshot, they are meaningless
+   * once the buffer has been modified.
+   */
+  if (search->stamp != _gtk_text_btree_get_chars_changed_stamp (get_btree (buffer)))
+    g_atomic_int_set (&search->stale, TRUE);
+
+  /* Batches queued before the search was cancelled are dropped too */
+  if (!g_atomic_int_get (&search->stale) &&
+      !g_cancellable_is_cancelled (g_task_get_cancellable (task)))
+    {
+      for (i = 0; i < matches->len; i += 2)
+        {
+          GtkTextIter start, end;
+
+          gtk_text_buffer_get_iter_at_offset (buffer, &start, g_array_index (matches, int, i));
+          gtk_text_buffer_get_iter_at_offset (buffer, &end, g_array_index (matches, int, i + 1));
+
+          search->match_func (buffer, &start, &end, search->user_data);
+        }
+    }
+
+  g_array_unref (matches);
+}
+
+static gboolean
+search_deliver_cb (gpointer data)
+{
+  search_deliver (data);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Runs in the worker thread */
+static void
+search_add_match (GTask      *task,
+                  SearchData *search,
+                  int         start,
+                  int         end)
+{
+  g_mutex_lock (&search->lock);
+
+  g_array_append_val (search->pending, start);
+  g_array_append_val (search->pending, end);
+  search->n_matches++;
+
+  if (!search->deliver_queued)
+    {
+      GSource *source;
+
+      source = g_idle_source_new ();
+      g_source_set_priority (source, G_PRIORITY_DEFAULT);
+      g_source_set_callback (source, search_deliver_cb, g_object_ref (task), g_object_unref);
+      g_source_set_name (source, "[gtk] text buffer search");
+      g_source_attach (source, g_task_get_context (task));
+      g_source_unref (source);
+
+      search->deliver_queued = TRUE;
+    }
+
+  g_mutex_unlock (&search->lock);
+}
+
+static void
+search_thread (GTask        *task,
+               gpointer      source_object,
+               gpointer      task_data,
+               GCancellable *cancellable)
+{
+  SearchData *search = task_data;
+  const char *text = search->text;
+  const char *counted = text;
+  int offset = 0;
+
+  if (search->regex)
+    {
+      GMatchInfo *info;
+      GError *error = NULL;
+
+      g_regex_match_full (search->regex, text, search->length, 0,
+                          search->match_flags, &info, &error);
+
+      while (error == NULL && g_match_info_matches (info))
+        {
+          int start_pos, end_pos, start;
+
+          if (g_task_return_error_if_cancelled (task))
+            {
+              g_match_info_free (info);
+              return;
+            }
+
+          if (g_atomic_int_get (&search->stale))
+            break;
+
+          g_match_info_fetch_pos (info, 0, &start_pos, &end_pos);
+
+          offset += g_utf8_strlen (counted, text + start_pos - counted);
+          start = offset;
+          offset += g_utf8_strlen (text + start_pos, end_pos - start_pos);
+          counted = text + end_pos;
+
+          search_add_match (task, search, start, offset);
+
+          g_match_info_next (info, &error);
+        }
+
+      g_match_info_free (info);
+
+      if (error)
+        {
+          g_task_return_error (task, error);
+          return;
+        }
+    }
+  else
+    {
+      gsize needle_length = strlen (search->needle);
+      int needle_chars = g_utf8_strlen (search->needle, -1);
+      const char *found;
+
+      for (found = _gtk_text_find_bytes (text, search->length, search->needle, needle_length);
+           found != NULL;
+           found = _gtk_text_find_bytes (counted, text + search->length - counted, search->needle, needle_length))
+        {
+          if (g_task_return_error_if_cancelled (task))
+            return;
+
+          if (g_atomic_int_get (&search->stale))
+            break;
+
+          offset += g_utf8_strlen (counted, found - counted);
+          search_add_match (task, search, offset, offset + needle_chars);
+          offset += needle_chars;
+          counted = found + needle_length;
+        }
+    }
+
+  g_task_return_int (task, search->n_matches);
+}
+
+static void
+gtk_text_buffer_search_start (GtkTextBuffer          *buffer,
+                              char                   *needle,
+                              GRegex                 *regex,
+                              GRegexMatchFlags        match_flags,
+                              GtkTextBufferMatchFunc  match_func,
+                              GCancellable           *cancellable,
+                              GAsyncReadyCallback     callback,
+                              gpointer                user_data)
+{
+  SearchData *search;
+  GtkTextIter start, end;
+  GTask *task;
+
+  search = g_slice_new0 (SearchData);
+
+  /* The btree can't be shared with another thread, so search a
+   * copy of the text. A slice keeps char offsets in sync with the
+   * buffer.
+   */
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  search->text = gtk_text_iter_get_slice (&start, &end);
+  search->length = strlen (search->text);
+  search->stamp = _gtk_text_btree_get_chars_changed_stamp (get_btree (buffer));
+
+  search->needle = needle;
+  search->regex = regex;
+  search->match_flags = match_flags;
+  search->match_func = match_func;
+  search->user_data = user_data;
+
+  g_mutex_init (&search->lock);
+  search->pending = g_array_new (FALSE, FALSE, sizeof (int));
+
+  task = g_task_new (buffer, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gtk_text_buffer_search_start);
+  g_task_set_task_data (task, search, search_data_free);
+  g_task_run_in_thread (task, search_thread);
+  g_object_unref (task);
+}
+
+/**
+ * GtkTextBufferMatchFunc:
+ * @buffer: the #GtkTextBuffer that is being searched
+ * @match_start: start of the match
+ * @match_end: end of the match
+ * @user_data: (closure): user data passed to the search function
+ *
+ * The type of the function that is called for every match found
+ * by gtk_text_buffer_search_async() and
+ * gtk_text_buffer_search_regex_async().
+ */
+
+/**
+ * gtk_text_buffer_search_async:
+ * @buffer: a #GtkTextBuffer
+ * @str: the string to search for
+ * @flags: flags affecting the search, only
+ *   %GTK_TEXT_SEARCH_CASE_INSENSITIVE is supported
+ * @match_func: function to call for every match
+ * @cancellable: (nullable): optional #GCancellable object, %NULL to ignore
+ * @callback: (scope async): callback to call when the search is done
+ * @user_data: (closure): data to pass to @match_func and @callback
+ *
+ * Finds all occurrences of @str in @buffer.
+ *
+ * The search runs in a separate thread on a copy of the buffer contents,
+ * so it does not block the user interface even for very large buffers.
+ * As matches are found, @match_func is called for them in order in the
+ * main thread, which allows e.g. highlighting them incrementally.
+ * Matches do not overlap.
+ *
+ * Note that the copy of the buffer contents is made in the calling
+ * thread before this function returns, which takes time proportional
+ * to the size of @buffer.
+ *
+ * Case insensitive searching compares characters using simple case
+ * folding, which does not take canonical decompositions into account
+ * like gtk_text_iter_forward_search() does.
+ *
+ * If @buffer is modified or @cancellable is cancelled before the
+ * search is done, no further matches are reported and the search
+ * fails.
+ *
+ * When the search is done, @callback is called. Call
+ * gtk_text_buffer_search_finish() to get the result.
+ */
+void
+gtk_text_buffer_search_async (GtkTextBuffer          *buffer,
+                              const char             *str,
+                              GtkTextSearchFlags      flags,
+                              GtkTextBufferMatchFunc  match_func,
+                              GCancellable           *cancellable,
+                              GAsyncReadyCallback     callback,
+                              gpointer                user_data)
+{
+  GRegex *regex = NULL;
+  char *needle = NULL;
+
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+  g_return_if_fail (str != NULL && *str != '\0');
+  g_return_if_fail ((flags & ~GTK_TEXT_SEARCH_CASE_INSENSITIVE) == 0);
+  g_return_if_fail (match_func != NULL);
+
+  if (flags & GTK_TEXT_SEARCH_CASE_INSENSITIVE)
+    {
+      char *escaped = g_regex_escape_string (str, -1);
+      regex = g_regex_new (escaped, G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, NULL);
+      g_free (escaped);
+    }
+  else
+    {
+      needle = g_strdup (str);
+    }
+
+  gtk_text_buffer_search_start (buffer, needle, regex, 0, match_func,
+                                cancellable, callback, user_data);
+}
+
+/**
+ * gtk_text_buffer_search_regex_async:
+ * @buffer: a #GtkTextBuffer
+ * @regex: the regular expression to search for
+ * @match_options: match options, or 0
+ * @match_func: function to call for every match
+ * @cancellable: (nullable): optional #GCancellable object, %NULL to ignore
+ * @callback: (scope async): callback to call when the search is done
+ * @user_data: (closure): data to pass to @match_func and @callback
+ *
+ * Finds all matches of @regex in @buffer.
+ *
+ * This works like gtk_text_buffer_search_async(). The text is
+ * matched as a whole, so use %G_REGEX_MULTILINE when creating
+ * @regex if ^ and $ should match at line boundaries.
+ */
+void
+gtk_text_buffer_search_regex_async (GtkTextBuffer          *buffer,
+                                    GRegex                 *regex,
+                                    GRegexMatchFlags        match_options,
+                                    GtkTextBufferMatchFunc  match_func,
+                                    GCancellable           *cancellable,
+                                    GAsyncReadyCallback     callback,
+                                    gpointer                user_data)
+{
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+  g_return_if_fail (regex != NULL);
+  g_return_if_fail (match_func != NULL);
+
+  gtk_text_buffer_search_start (buffer, NULL, g_regex_ref (regex), match_options,
+                                match_func, cancellable, callback, user_data);
+}
+
+/**
+ * gtk_text_buffer_search_finish:
+ * @buffer: a #GtkTextBuffer
+ * @result: a #GAsyncResult
+ * @error: a #GError location to store the error occurring, or %NULL to ignore
+ *
+ * Finishes a search started with gtk_text_buffer_search_async() or
+ * gtk_text_buffer_search_regex_async().
+ *
+ * All matches have been passed to the match function when this
+ * function returns.
+ *
+ * Returns: the number of matches found, or 0 and @error is set
+ *   if the search failed
+ */
+guint
+gtk_text_buffer_search_finish (GtkTextBuffer  *buffer,
+                               GAsyncResult   *result,
+                               GError        **error)
+{
+  SearchData *search;
+  gssize n_matches;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), 0);
+  g_return_val_if_fail (g_task_is_valid (result, buffer), 0);
+  g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == gtk_text_buffer_search_start, 0);
+
+  search = g_task_get_task_data (G_TASK (result));
+
+  search_deliver (G_TASK (result));
+
+  n_matches = g_task_propagate_int (G_TASK (result), error);
+  if (n_matches < 0)
+    return 0;
+
+  if (g_atomic_int_get (&search->stale))
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                           "The buffer was modified during the search");
+      return 0;
+    }
+
+  return n_matches;
+}
+
 /*
  * Pixbufs
  */
@@ -2851,19 +3266,52 @@ gtk_text_buffer_create_tag (GtkTextBuffer *buffer,
   return tag;
 }
 
+/* Returns the ranges of a batch if the signal being handled was
+ * emitted for their span by gtk_text_buffer_emit_tag_ranges() */
+static gboolean
+gtk_text_buffer_take_pending_ranges (GtkTextBuffer      *buffer,
+                                     GtkTextTag         *tag,
+                                     const GtkTextIter  *start,
+                                     const GtkTextIter  *end,
+                                     const int         **offsets,
+                                     guint              *n_offsets)
+{
+  GtkTextBufferPrivate *priv = buffer->priv;
+
+  if (priv->pending_tag != tag ||
+      gtk_text_iter_get_offset (start) != priv->pending_offsets[0] ||
+      gtk_text_iter_get_offset (end) != priv->pending_offsets[priv->n_pending_offsets - 1])
+    return FALSE;
+
+  *offsets = priv->pending_offsets;
+  *n_offsets = priv->n_pending_offsets;
+
+  priv->pending_tag = NULL;
+  priv->pending_offsets = NULL;
+  priv->n_pending_offsets = 0;
+
+  return TRUE;
+}
+
 static void
 gtk_text_buffer_real_apply_tag (GtkTextBuffer     *buffer,
                                 GtkTextTag        *tag,
                                 const GtkTextIter *start,
                                 const GtkTextIter *end)
 {
+  const int *offsets;
+  guint n_offsets;
+
   if (tag->priv->table != buffer->priv->tag_table)
     {
       g_warning ("Can only apply tags that are in the tag table for the buffer");
       return;
     }
   
-  _gtk_text_btree_tag (start, end, tag, TRUE);
+  if (gtk_text_buffer_take_pending_ranges (buffer, tag, start, end, &offsets, &n_offsets))
+    _gtk_text_btree_tag_ranges (get_btree (buffer), tag, offsets, n_offsets, TRUE);
+  else
+    _gtk_text_btree_tag (start, end, tag, TRUE);
 }
 
 static void
@@ -2872,13 +3320,19 @@ gtk_text_buffer_real_remove_tag (GtkTextBuffer     *buffer,
                                  const GtkTextIter *start,
                                  const GtkTextIter *end)
 {
+  const int *offsets;
+  guint n_offsets;
+
   if (tag->priv->table != buffer->priv->tag_table)
     {
       g_warning ("Can only remove tags that are in the tag table for the buffer");
       return;
     }
   
-  _gtk_text_btree_tag (start, end, tag, FALSE);
+  if (gtk_text_buffer_take_pending_ranges (buffer, tag, start, end, &offsets, &n_offsets))
+    _gtk_text_btree_tag_ranges (get_btree (buffer), tag, offsets, n_offsets, FALSE);
+  else
+    _gtk_text_btree_tag (start, end, tag, FALSE);
 }
 
 static void
@@ -2943,6 +3397,43 @@ gtk_text_buffer_emit_tag (GtkTextBuffer     *buffer,
                    tag, &start_tmp, &end_tmp);
 }
 
+/* Emits ::apply-tag or ::remove-tag once for the span of the ranges,
+ * and lets the default handler change only the ranges themselves */
+static void
+gtk_text_buffer_emit_tag_ranges (GtkTextBuffer *buffer,
+                                 GtkTextTag    *tag,
+                                 gboolean       apply,
+                                 const int     *offsets,
+                                 guint          n_offsets)
+{
+  GtkTextBufferPrivate *priv = buffer->priv;
+  GtkTextTag *saved_tag;
+  const int *saved_offsets;
+  guint saved_n_offsets;
+  GtkTextIter start, end;
+
+  if (n_offsets == 0 || offsets[0] == offsets[n_offsets - 1])
+    return;
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, offsets[0]);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, offsets[n_offsets - 1]);
+
+  /* Handlers may apply tag ranges themselves */
+  saved_tag = priv->pending_tag;
+  saved_offsets = priv->pending_offsets;
+  saved_n_offsets = priv->n_pending_offsets;
+
+  priv->pending_tag = tag;
+  priv->pending_offsets = offsets;
+  priv->n_pending_offsets = n_offsets;
+
+  gtk_text_buffer_emit_tag (buffer, tag, apply, &start, &end);
+
+  priv->pending_tag = saved_tag;
+  priv->pending_offsets = saved_offsets;
+  priv->n_pending_offsets = saved_n_offsets;
+}
+
 /**
  * gtk_text_buffer_apply_tag:
  * @buffer: a #GtkTextBuffer
@@ -3000,6 +3491,91 @@ gtk_text_buffer_remove_tag (GtkTextBuffer     *buffer,
   gtk_text_buffer_emit_tag (buffer, tag, FALSE, start, end);
 }
 
+static gboolean
+check_tag_ranges (GtkTextBuffer *buffer,
+                  const int     *offsets,
+                  guint          n_offsets)
+{
+  int char_count;
+  guint i;
+
+  if (n_offsets % 2 != 0)
+    return FALSE;
+
+  char_count = gtk_text_buffer_get_char_count (buffer);
+  for (i = 0; i < n_offsets; i++)
+    {
+      if (offsets[i] < 0 || offsets[i] > char_count)
+        return FALSE;
+      if (i > 0 && offsets[i] < offsets[i - 1])
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * gtk_text_buffer_apply_tag_ranges:
+ * @buffer: a #GtkTextBuffer
+ * @tag: a #GtkTextTag
+ * @offsets: (array length=n_offsets): character offsets of the
+ *   start and end of each range
+ * @n_offsets: the number of offsets, twice the number of ranges
+ *
+ * Applies @tag to many ranges of @buffer at once. This is much faster
+ * than calling gtk_text_buffer_apply_tag() for each of them, which
+ * makes it useful for things like syntax highlighting.
+ *
+ * The ranges must be sorted and must not overlap, so that @offsets
+ * is in ascending order.
+ *
+ * The #GtkTextBuffer::apply-tag signal is emitted once, for the span
+ * from the start of the first range to the end of the last one.
+ */
+void
+gtk_text_buffer_apply_tag_ranges (GtkTextBuffer *buffer,
+                                  GtkTextTag    *tag,
+                                  const int     *offsets,
+                                  guint          n_offsets)
+{
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+  g_return_if_fail (GTK_IS_TEXT_TAG (tag));
+  g_return_if_fail (offsets != NULL || n_offsets == 0);
+  g_return_if_fail (tag->priv->table == buffer->priv->tag_table);
+  g_return_if_fail (check_tag_ranges (buffer, offsets, n_offsets));
+
+  gtk_text_buffer_emit_tag_ranges (buffer, tag, TRUE, offsets, n_offsets);
+}
+
+/**
+ * gtk_text_buffer_remove_tag_ranges:
+ * @buffer: a #GtkTextBuffer
+ * @tag: a #GtkTextTag
+ * @offsets: (array length=n_offsets): character offsets of the
+ *   start and end of each range
+ * @n_offsets: the number of offsets, twice the number of ranges
+ *
+ * Removes @tag from many ranges of @buffer at once. See
+ * gtk_text_buffer_apply_tag_ranges().
+ *
+ * The #GtkTextBuffer::remove-tag signal is emitted once, for the span
+ * from the start of the first range to the end of the last one.
+ */
+void
+gtk_text_buffer_remove_tag_ranges (GtkTextBuffer *buffer,
+                                   GtkTextTag    *tag,
+                                   const int     *offsets,
+                                   guint          n_offsets)
+{
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+  g_return_if_fail (GTK_IS_TEXT_TAG (tag));
+  g_return_if_fail (offsets != NULL || n_offsets == 0);
+  g_return_if_fail (tag->priv->table == buffer->priv->tag_table);
+  g_return_if_fail (check_tag_ranges (buffer, offsets, n_offsets));
+
+  gtk_text_buffer_emit_tag_ranges (buffer, tag, FALSE, offsets, n_offsets);
+}
+
 /**
  * gtk_text_buffer_apply_tag_by_name:
  * @buffer: a #GtkTextBuffer
@@ -5196,3 +5772,43 @@ gtk_text_buffer_set_max_undo_levels (GtkTextBuffer *buffer,
 
   gtk_text_history_set_max_undo_levels (buffer->priv->history, max_undo_levels);
 }
+
+/**
+ * gtk_text_buffer_get_max_undo_bytes:
+ * @buffer: a #GtkTextBuffer
+ *
+ * Gets the maximum amount of text, in bytes, that is kept to be able
+ * to undo changes. If 0, the amount is unlimited.
+ *
+ * Returns: the maximum amount of text kept for undo
+ */
+gsize
+gtk_text_buffer_get_max_undo_bytes (GtkTextBuffer *buffer)
+{
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), 0);
+
+  return gtk_text_history_get_max_undo_bytes (buffer->priv->history);
+}
+
+/**
+ * gtk_text_buffer_set_max_undo_bytes:
+ * @buffer: a #GtkTextBuffer
+ * @max_undo_bytes: the maximum amount of text to keep, in bytes
+ *
+ * Sets the maximum amount of text, in bytes, that is kept to be able
+ * to undo changes. When it is exceeded, the oldest undo actions are
+ * dropped, so a single change that is larger than this can't be
+ * undone. If 0, the amount is unlimited.
+ *
+ * This can be used in addition to gtk_text_buffer_set_max_undo_levels()
+ * to bound the memory used by undo when large parts of the buffer are
+ * changed programmatically.
+ */
+void
+gtk_text_buffer_set_max_undo_bytes (GtkTextBuffer *buffer,
+                                    gsize          max_undo_bytes)
+{
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+
+  gtk_text_history_set_max_undo_bytes (buffer->priv->history, max_undo_bytes);
+}
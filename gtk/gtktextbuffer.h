@@ -354,6 +354,16 @@ GDK_AVAILABLE_IN_ALL
 void gtk_text_buffer_remove_all_tags       (GtkTextBuffer     *buffer,
                                             const GtkTextIter *start,
                                             const GtkTextIter *end);
+GDK_AVAILABLE_IN_ALL
+void gtk_text_buffer_apply_tag_ranges      (GtkTextBuffer     *buffer,
+                                            GtkTextTag        *tag,
+                                            const int         *offsets,
+                                            guint              n_offsets);
+GDK_AVAILABLE_IN_ALL
+void gtk_text_buffer_remove_tag_ranges     (GtkTextBuffer     *buffer,
+                                            GtkTextTag        *tag,
+                                            const int         *offsets,
+                                            guint              n_offsets);
 
 
 /* You can either ignore the return value, or use it to
@@ -472,6 +482,11 @@ GDK_AVAILABLE_IN_ALL
 void            gtk_text_buffer_set_max_undo_levels       (GtkTextBuffer *buffer,
                                                            guint          max_undo_levels);
 GDK_AVAILABLE_IN_ALL
+gsize           gtk_text_buffer_get_max_undo_bytes        (GtkTextBuffer *buffer);
+GDK_AVAILABLE_IN_ALL
+void            gtk_text_buffer_set_max_undo_bytes        (GtkTextBuffer *buffer,
+                                                           gsize          max_undo_bytes);
+GDK_AVAILABLE_IN_ALL
 void            gtk_text_buffer_undo                      (GtkTextBuffer *buffer);
 GDK_AVAILABLE_IN_ALL
 void            gtk_text_buffer_redo                      (GtkTextBuffer *buffer);
@@ -484,6 +499,32 @@ void            gtk_text_buffer_begin_user_action         (GtkTextBuffer *buffer
 GDK_AVAILABLE_IN_ALL
 void            gtk_text_buffer_end_user_action           (GtkTextBuffer *buffer);
 
+typedef void (* GtkTextBufferMatchFunc) (GtkTextBuffer     *buffer,
+                                         const GtkTextIter *match_start,
+                                         const GtkTextIter *match_end,
+                                         gpointer           user_data);
+
+GDK_AVAILABLE_IN_ALL
+void            gtk_text_buffer_search_async              (GtkTextBuffer          *buffer,
+                                                           const char             *str,
+                                                           GtkTextSearchFlags      flags,
+                                                           GtkTextBufferMatchFunc  match_func,
+                                                           GCancellable           *cancellable,
+                                                           GAsyncReadyCallback     callback,
+                                                           gpointer                user_data);
+GDK_AVAILABLE_IN_ALL
+void            gtk_text_buffer_search_regex_async        (GtkTextBuffer          *buffer,
+                                                           GRegex                 *regex,
+                                                           GRegexMatchFlags        match_options,
+                                                           GtkTextBufferMatchFunc  match_func,
+                                                           GCancellable           *cancellable,
+                                                           GAsyncReadyCallback     callback,
+                                                           gpointer                user_data);
+GDK_AVAILABLE_IN_ALL
+guint           gtk_text_buffer_search_finish             (GtkTextBuffer          *buffer,
+                                                           GAsyncResult           *result,
+                                                           GError                **error);
+
 
 G_END_DECLS
 
@@ -36,6 +36,10 @@
  * gtk_text_history_end_irreversible_action() can be used to denote a
  * section of operations that cannot be undone. This will cause all previous
  * changes tracked by the GtkTextHistory to be discared.
+ *
+ * The history can be bounded by the number of actions, and by the number
+ * of bytes of text they keep. When either limit is exceeded, the oldest
+ * actions are dropped.
  */
 
 typedef struct _Action     Action;
@@ -98,6 +102,10 @@ struct _GtkTextHistory
   guint               irreversible;
   guint               in_user;
   guint               max_undo_levels;
+  gsize               max_undo_bytes;
+
+  /* Bytes of text kept by the actions in both queues */
+  gsize               n_bytes;
 
   guint               can_undo : 1;
   guint               can_redo : 1;
@@ -152,6 +160,35 @@ clear_action_queue (GQueue *queue)
     }
 }
 
+static gsize
+action_get_size (const Action *action)
+{
+  const GList *iter;
+  gsize size;
+
+  switch (action->kind)
+    {
+    case ACTION_KIND_INSERT:
+      return action->u.insert.istr.n_bytes;
+
+    case ACTION_KIND_DELETE_BACKSPACE:
+    case ACTION_KIND_DELETE_KEY:
+    case ACTION_KIND_DELETE_PROGRAMMATIC:
+    case ACTION_KIND_DELETE_SELECTION:
+      return action->u.delete.istr.n_bytes;
+
+    case ACTION_KIND_GROUP:
+      size = 0;
+      for (iter = action->u.group.actions.head; iter; iter = iter->next)
+        size += action_get_size (iter->data);
+      return size;
+
+    case ACTION_KIND_BARRIER:
+    default:
+      return 0;
+    }
+}
+
 static Action *
 action_new (ActionKind kind)
 {
@@ -334,6 +371,70 @@ action_chain (Action   *action,
     }
 }
 
+static void
+istring_slice (IString *str,
+               guint    begin,
+               guint    end,
+               guint    n_chars)
+{
+  IString tmp;
+
+  istring_set (&tmp, istring_str (str) + begin, end - begin, n_chars);
+  istring_clear (str);
+  *str = tmp;
+}
+
+/* When text is replaced, usually only parts of it actually change.
+ * Take the common start and end out of a delete and the insert that
+ * follows it at the same position, so the history doesn't keep two
+ * copies of unchanged text.
+ */
+static void
+action_trim_replacement (Action *delete,
+                         Action *insert)
+{
+  IString *old = &delete->u.delete.istr;
+  IString *new = &insert->u.insert.istr;
+  const char *old_str, *new_str;
+  guint max, prefix, suffix;
+  guint prefix_chars, suffix_chars;
+
+  g_assert (delete->u.delete.begin == insert->u.insert.begin);
+
+  old_str = istring_str (old);
+  new_str = istring_str (new);
+  max = MIN (old->n_bytes, new->n_bytes);
+
+  for (prefix = 0; prefix < max && old_str[prefix] == new_str[prefix]; prefix++)
+    ;
+  while (prefix > 0 && (old_str[prefix] & 0xc0) == 0x80)
+    prefix--;
+
+  for (suffix = 0;
+       suffix < max - prefix &&
+       old_str[old->n_bytes - suffix - 1] == new_str[new->n_bytes - suffix - 1];
+       suffix++)
+    ;
+  while (suffix > 0 && (old_str[old->n_bytes - suffix] & 0xc0) == 0x80)
+    suffix--;
+
+  if (prefix == 0 && suffix == 0)
+    return;
+
+  prefix_chars = g_utf8_strlen (old_str, prefix);
+  suffix_chars = g_utf8_strlen (old_str + old->n_bytes - suffix, suffix);
+
+  delete->u.delete.begin += prefix_chars;
+  delete->u.delete.end -= suffix_chars;
+  insert->u.insert.begin += prefix_chars;
+  insert->u.insert.end -= suffix_chars;
+
+  istring_slice (old, prefix, old->n_bytes - suffix,
+                 old->n_chars - prefix_chars - suffix_chars);
+  istring_slice (new, prefix, new->n_bytes - suffix,
+                 new->n_chars - prefix_chars - suffix_chars);
+}
+
 static void
 gtk_text_history_do_change_state (GtkTextHistory *self,
                                   gboolean        is_modified,
@@ -384,25 +485,36 @@ gtk_text_history_do_select (GtkTextHistory *self,
   self->funcs.select (self->funcs_data, selection_insert, selection_bound);
 }
 
+static void
+gtk_text_history_drop (GtkTextHistory *self,
+                       GQueue         *queue,
+                       Action         *action)
+{
+  g_assert (GTK_IS_TEXT_HISTORY (self));
+
+  self->n_bytes -= action_get_size (action);
+
+  g_queue_unlink (queue, &action->link);
+  action_free (action);
+}
+
+static void
+gtk_text_history_drop_queue (GtkTextHistory *self,
+                             GQueue         *queue)
+{
+  while (queue->length > 0)
+    gtk_text_history_drop (self, queue, g_queue_peek_head (queue));
+}
+
 static void
 gtk_text_history_truncate_one (GtkTextHistory *self)
 {
   if (self->undo_queue.length > 0)
-    {
-      Action *action = g_queue_peek_head (&self->undo_queue);
-      g_queue_unlink (&self->undo_queue, &action->link);
-      action_free (action);
-    }
+    gtk_text_history_drop (self, &self->undo_queue, g_queue_peek_head (&self->undo_queue));
   else if (self->redo_queue.length > 0)
-    {
-      Action *action = g_queue_peek_tail (&self->redo_queue);
-      g_queue_unlink (&self->redo_queue, &action->link);
-      action_free (action);
-    }
+    gtk_text_history_drop (self, &self->redo_queue, g_queue_peek_tail (&self->redo_queue));
   else
-    {
-      g_assert_not_reached ();
-    }
+    g_assert_not_reached ();
 }
 
 static void
@@ -410,11 +522,29 @@ gtk_text_history_truncate (GtkTextHistory *self)
 {
   g_assert (GTK_IS_TEXT_HISTORY (self));
 
-  if (self->max_undo_levels == 0)
-    return;
+  if (self->max_undo_levels > 0)
+    {
+      while (self->undo_queue.length + self->redo_queue.length > self->max_undo_levels)
+        gtk_text_history_truncate_one (self);
+    }
+
+  if (self->max_undo_bytes > 0)
+    {
+      while (self->n_bytes > self->max_undo_bytes)
+        {
+          Action *head = g_queue_peek_head (&self->undo_queue);
 
-  while (self->undo_queue.length + self->redo_queue.length > self->max_undo_levels)
-    gtk_text_history_truncate_one (self);
+          /* The group of a user action in progress must stay, it is
+           * truncated when the user action ends if still too large.
+           */
+          if (head != NULL &&
+              head->kind == ACTION_KIND_GROUP &&
+              head->u.group.depth > 0)
+            break;
+
+          gtk_text_history_truncate_one (self);
+        }
+    }
 }
 
 static void
@@ -498,12 +628,9 @@ gtk_text_history_push (GtkTextHistory *self,
   g_assert (self->enabled);
   g_assert (action != NULL);
 
-  while (self->redo_queue.length > 0)
-    {
-      peek = g_queue_peek_head (&self->redo_queue);
-      g_queue_unlink (&self->redo_queue, &peek->link);
-      action_free (peek);
-    }
+  gtk_text_history_drop_queue (self, &self->redo_queue);
+
+  self->n_bytes += action_get_size (action);
 
   peek = g_queue_peek_tail (&self->undo_queue);
   in_user_action = self->in_user > 0;
@@ -791,7 +918,7 @@ gtk_text_history_end_user_action (GtkTextHistory *self)
   return_if_applying (self);
   return_if_irreversible (self);
 
-  clear_action_queue (&self->redo_queue);
+  gtk_text_history_drop_queue (self, &self->redo_queue);
 
   peek = g_queue_peek_tail (&self->undo_queue);
 
@@ -813,8 +940,7 @@ gtk_text_history_end_user_action (GtkTextHistory *self)
   /* Unlikely, but if the group is empty, just remove it */
   if (action_group_is_empty (peek))
     {
-      g_queue_unlink (&self->undo_queue, &peek->link);
-      action_free (peek);
+      gtk_text_history_drop (self, &self->undo_queue, peek);
       goto update_state;
     }
 
@@ -843,8 +969,8 @@ gtk_text_history_begin_irreversible_action (GtkTextHistory *self)
 
   self->irreversible++;
 
-  clear_action_queue (&self->undo_queue);
-  clear_action_queue (&self->redo_queue);
+  gtk_text_history_drop_queue (self, &self->undo_queue);
+  gtk_text_history_drop_queue (self, &self->redo_queue);
 
   gtk_text_history_update_state (self);
 }
@@ -865,8 +991,8 @@ gtk_text_history_end_irreversible_action (GtkTextHistory *self)
 
   self->irreversible--;
 
-  clear_action_queue (&self->undo_queue);
-  clear_action_queue (&self->redo_queue);
+  gtk_text_history_drop_queue (self, &self->undo_queue);
+  gtk_text_history_drop_queue (self, &self->redo_queue);
 
   gtk_text_history_update_state (self);
 }
@@ -951,6 +1077,7 @@ gtk_text_history_text_inserted (GtkTextHistory *self,
                                 int             len)
 {
   Action *action;
+  Action *group;
 
   g_return_if_fail (GTK_IS_TEXT_HISTORY (self));
 
@@ -967,7 +1094,40 @@ gtk_text_history_text_inserted (GtkTextHistory *self,
   istring_set (&action->u.insert.istr,
                text,
                len,
-               action->u.insert.end);
+               action->u.insert.end - position);
+
+  /* Within a user action, an insertion at the start of what was just
+   * deleted is most likely a replacement.
+   */
+  group = g_queue_peek_tail (&self->undo_queue);
+  if (self->in_user > 0 &&
+      group != NULL &&
+      group->kind == ACTION_KIND_GROUP &&
+      group->u.group.actions.tail != NULL)
+    {
+      Action *peek = group->u.group.actions.tail->data;
+
+      if (peek->kind != ACTION_KIND_INSERT &&
+          peek->kind != ACTION_KIND_GROUP &&
+          peek->kind != ACTION_KIND_BARRIER &&
+          peek->u.delete.begin == position)
+        {
+          gsize old_size = action_get_size (peek);
+
+          action_trim_replacement (peek, action);
+          self->n_bytes -= old_size - action_get_size (peek);
+
+          if (istring_empty (&peek->u.delete.istr))
+            gtk_text_history_drop (self, &group->u.group.actions, peek);
+
+          if (istring_empty (&action->u.insert.istr))
+            {
+              action_free (action);
+              gtk_text_history_update_state (self);
+              return;
+            }
+        }
+    }
 
   gtk_text_history_push (self, action);
 }
@@ -1034,8 +1194,8 @@ gtk_text_history_set_enabled (GtkTextHistory *self,
         {
           self->irreversible = 0;
           self->in_user = 0;
-          clear_action_queue (&self->undo_queue);
-          clear_action_queue (&self->redo_queue);
+          gtk_text_history_drop_queue (self, &self->undo_queue);
+          gtk_text_history_drop_queue (self, &self->redo_queue);
         }
     }
 }
@@ -1060,3 +1220,25 @@ gtk_text_history_set_max_undo_levels (GtkTextHistory *self,
       gtk_text_history_truncate (self);
     }
 }
+
+gsize
+gtk_text_history_get_max_undo_bytes (GtkTextHistory *self)
+{
+  g_return_val_if_fail (GTK_IS_TEXT_HISTORY (self), 0);
+
+  return self->max_undo_bytes;
+}
+
+void
+gtk_text_history_set_max_undo_bytes (GtkTextHistory *self,
+                                     gsize           max_undo_bytes)
+{
+  g_return_if_fail (GTK_IS_TEXT_HISTORY (self));
+
+  if (self->max_undo_bytes != max_undo_bytes)
+    {
+      self->max_undo_bytes = max_undo_bytes;
+      gtk_text_history_truncate (self);
+      gtk_text_history_update_state (self);
+    }
+}
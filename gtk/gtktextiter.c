@@ -4761,6 +4761,165 @@ lines_match (const GtkTextIter *start,
   return lines_match (&next, lines, visible_only, slice, case_insensitive, NULL, match_end);
 }
 
+/*< private >
+ * _gtk_text_find_bytes:
+ * @haystack: the text to search
+ * @haystack_len: length of @haystack in bytes
+ * @needle: the text to search for
+ * @needle_len: length of @needle in bytes
+ *
+ * Like memmem(). Candidates are found with memchr(), which is
+ * vectorized in any libc worth its salt, so this is fast for the
+ * typical case of the first byte of @needle being rare-ish.
+ *
+ * If both strings are valid UTF-8, a match always starts at a
+ * character boundary.
+ *
+ * Returns: (nullable): pointer to the first match in @haystack
+ */
+const char *
+_gtk_text_find_bytes (const char *haystack,
+                      gsize       haystack_len,
+                      const char *needle,
+                      gsize       needle_len)
+{
+  const char *p, *last;
+
+  if (needle_len == 0)
+    return haystack;
+
+  if (haystack_len < needle_len)
+    return NULL;
+
+  last = haystack + haystack_len - needle_len;
+
+  for (p = haystack; p <= last; p++)
+    {
+      p = memchr (p, needle[0], last - p + 1);
+      if (p == NULL)
+        return NULL;
+
+      if (memcmp (p + 1, needle + 1, needle_len - 1) == 0)
+        return p;
+    }
+
+  return NULL;
+}
+
+/* Like lines_match() for a single line of @needle, but without
+ * case folding or skipping invisible text. That's simple enough to
+ * search the character segments of the line in place instead of
+ * copying out its text and walking to the match char by char.
+ * Consecutive character segments are only copied into @scratch
+ * when the line has more than one of them.
+ */
+static gboolean
+line_match_fast (const GtkTextIter *start,
+                 const char        *needle,
+                 gboolean           slice,
+                 GString           *scratch,
+                 GtkTextIter       *match_start,
+                 GtkTextIter       *match_end)
+{
+  GtkTextLine *line;
+  GtkTextLineSegment *seg, *run_start;
+  gsize needle_len;
+  int start_index, index, run_index, run_length, n_segs;
+
+  line = _gtk_text_iter_get_text_line (start);
+  start_index = gtk_text_iter_get_line_index (start);
+  needle_len = strlen (needle);
+
+  /* Without @slice, paintables and child anchors are skipped, so
+   * matches can span them. Leave those rare lines to the slow path.
+   */
+  if (!slice)
+    {
+      for (seg = line->segments; seg; seg = seg->next)
+        {
+          if (seg->type != &gtk_text_char_type && seg->byte_count > 0)
+            {
+              const char *lines[2] = { needle, NULL };
+
+              return lines_match (start, lines, FALSE, FALSE, FALSE, match_start, match_end);
+            }
+        }
+    }
+
+  index = 0;
+  seg = line->segments;
+
+  while (seg)
+    {
+      const char *haystack, *found;
+      int offset;
+
+      /* Collect the next run of character segments. Other segments
+       * with content end the run, they are U+FFFC and can't be part
+       * of the match.
+       */
+      while (seg && seg->type != &gtk_text_char_type)
+        {
+          index += seg->byte_count;
+          seg = seg->next;
+        }
+
+      if (seg == NULL)
+        break;
+
+      run_start = seg;
+      run_index = index;
+      run_length = 0;
+      n_segs = 0;
+
+      while (seg && (seg->type == &gtk_text_char_type || seg->byte_count == 0))
+        {
+          if (seg->byte_count > 0)
+            n_segs++;
+          run_length += seg->byte_count;
+          seg = seg->next;
+        }
+
+      index = run_index + run_length;
+
+      if (index - start_index < (int) needle_len)
+        continue;
+
+      if (n_segs == 1)
+        {
+          haystack = run_start->body.chars;
+        }
+      else
+        {
+          GtkTextLineSegment *s;
+
+          g_string_truncate (scratch, 0);
+          for (s = run_start; s != seg; s = s->next)
+            {
+              if (s->type == &gtk_text_char_type)
+                g_string_append_len (scratch, s->body.chars, s->byte_count);
+            }
+          haystack = scratch->str;
+        }
+
+      offset = MAX (start_index - run_index, 0);
+      found = _gtk_text_find_bytes (haystack + offset, run_length - offset,
+                                    needle, needle_len);
+      if (found)
+        {
+          GtkTextBTree *tree = _gtk_text_iter_get_btree (start);
+          int found_index = run_index + (found - haystack);
+
+          _gtk_text_btree_get_iter_at_line (tree, match_start, line, found_index);
+          _gtk_text_btree_get_iter_at_line (tree, match_end, line, found_index + needle_len);
+
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
 /* strsplit() that retains the delimiter as part of the string. */
 static char **
 strbreakup (const char *string,
@@ -4877,6 +5036,7 @@ gtk_text_iter_forward_search (const GtkTextIter *iter,
   gboolean visible_only;
   gboolean slice;
   gboolean case_insensitive;
+  GString *scratch = NULL;
 
   g_return_val_if_fail (iter != NULL, FALSE);
   g_return_val_if_fail (str != NULL, FALSE);
@@ -4914,6 +5074,15 @@ gtk_text_iter_forward_search (const GtkTextIter *iter,
 
   lines = strbreakup (str, "\n", -1, NULL, case_insensitive);
 
+  /* The common case of a plain single line search can look at the
+   * line contents directly. U+FFFC is excluded because it stands in
+   * for paintables and child anchors in a slice.
+   */
+  if (!visible_only && !case_insensitive &&
+      strchr (str, '\n') == NULL &&
+      strstr (str, "\357\277\274") == NULL)
+    scratch = g_string_new (NULL);
+
   search = *iter;
 
   do
@@ -4923,13 +5092,19 @@ gtk_text_iter_forward_search (const GtkTextIter *iter,
        * a single line.
        */
       GtkTextIter end;
+      gboolean found;
 
       if (limit &&
           gtk_text_iter_compare (&search, limit) >= 0)
         break;
-      
-      if (lines_match (&search, (const char **)lines,
-                       visible_only, slice, case_insensitive, &match, &end))
+
+      if (scratch)
+        found = line_match_fast (&search, lines[0], slice, scratch, &match, &end);
+      else
+        found = lines_match (&search, (const char **)lines,
+                             visible_only, slice, case_insensitive, &match, &end);
+
+      if (found)
         {
           if (limit == NULL ||
               (limit &&
@@ -4950,6 +5125,8 @@ gtk_text_iter_forward_search (const GtkTextIter *iter,
   while (gtk_text_iter_forward_line (&search));
 
   g_strfreev ((char **)lines);
+  if (scratch)
+    g_string_free (scratch, TRUE);
 
   return retval;
 }
@@ -44,6 +44,11 @@ int                 _gtk_text_iter_get_segment_char           (const GtkTextIter
 gboolean            _gtk_text_iter_same_line                  (const GtkTextIter *lhs,
                                                                const GtkTextIter *rhs);
 
+const char *        _gtk_text_find_bytes                      (const char        *haystack,
+                                                               gsize              haystack_len,
+                                                               const char        *needle,
+                                                               gsize              needle_len);
+
 gboolean       gtk_text_iter_get_attributes (const GtkTextIter *iter,
                                              GtkTextAttributes *values);
 
@@ -4216,6 +4216,11 @@ gtk_text_layout_snapshot (GtkTextLayout      *layout,
 
           if (line_display->node == NULL)
             {
+              GskRenderNodeArena *arena;
+
+              /* The node outlives this snapshot in the line display
+               * cache, so it must not keep the widget's arena alive */
+              arena = gsk_render_node_arena_begin (0);
               gtk_snapshot_push_collect (snapshot);
 
               render_para (crenderer, 0, line_display,
@@ -4223,6 +4228,7 @@ gtk_text_layout_snapshot (GtkTextLayout      *layout,
                            cursor_alpha);
 
               line_display->node = gtk_snapshot_pop_collect (snapshot);
+              gsk_render_node_arena_end (arena);
             }
 
           if (line_display->node != NULL)
@@ -4273,6 +4279,7 @@ gtk_text_layout_snapshot (GtkTextLayout      *layout,
 
   /* Only update eviction source once per snapshot */
   gtk_text_line_display_cache_delay_eviction (priv->cache);
+  gtk_text_line_display_cache_end_frame (priv->cache, g_slist_length (line_list));
 
   g_slist_free (line_list);
 
@@ -4306,3 +4313,49 @@ gtk_text_layout_set_mru_size (GtkTextLayout *layout,
 
   gtk_text_line_display_cache_set_mru_size (priv->cache, mru_size);
 }
+
+/*< private >
+ * gtk_text_layout_prefetch:
+ * @layout: a `GtkTextLayout`
+ * @y: the y position to start at, in layout coordinates
+ * @height: the amount of lines to prepare, in pixels. If negative,
+ *   the lines above @y are prepared
+ *
+ * Creates the displays for the lines starting at @y ahead of time,
+ * so that they are already cached when they are scrolled into view.
+ */
+void
+gtk_text_layout_prefetch (GtkTextLayout *layout,
+                          int            y,
+                          int            height)
+{
+  GtkTextLine *line;
+  int remaining;
+
+  g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
+
+  if (layout->buffer == NULL || height == 0 || (height < 0 && y <= 0))
+    return;
+
+  line = _gtk_text_btree_find_line_by_y (_gtk_text_buffer_get_btree (layout->buffer),
+                                         layout, MAX (y, 0), NULL);
+  remaining = ABS (height);
+
+  gtk_text_layout_wrap_loop_start (layout);
+
+  while (line != NULL && remaining > 0)
+    {
+      GtkTextLineDisplay *display;
+
+      display = gtk_text_layout_get_line_display (layout, line, FALSE);
+      remaining -= MAX (display->height, 1);
+      gtk_text_line_display_unref (display);
+
+      if (height > 0)
+        line = _gtk_text_line_next_excluding_last (line);
+      else
+        line = _gtk_text_line_previous (line);
+    }
+
+  gtk_text_layout_wrap_loop_end (layout);
+}
@@ -388,6 +388,9 @@ void gtk_text_layout_snapshot (GtkTextLayout        *layout,
 
 void gtk_text_layout_set_mru_size (GtkTextLayout *layout,
                                    guint          mru_size);
+void gtk_text_layout_prefetch     (GtkTextLayout *layout,
+                                   int            y,
+                                   int            height);
 
 G_END_DECLS
 
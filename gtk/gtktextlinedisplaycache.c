@@ -24,7 +24,10 @@
 #include "gtktextiterprivate.h"
 #include "gtktextlinedisplaycacheprivate.h"
 
+#include "gdk/gdkprofilerprivate.h"
+
 #define DEFAULT_MRU_SIZE         250
+#define MRU_SCREENS              3
 #define BLOW_CACHE_TIMEOUT_SEC   20
 #define DEBUG_LINE_DISPLAY_CACHE 0
 
@@ -36,11 +39,14 @@ struct _GtkTextLineDisplayCache
   GQueue       mru;
   GSource     *evict_source;
   guint        mru_size;
+  guint        requested_mru_size;
+  guint        n_visible_lines;
 
 #if DEBUG_LINE_DISPLAY_CACHE
   guint       log_source;
   int         hits;
   int         misses;
+  int         evictions;
   int         inval;
   int         inval_cursors;
   int         inval_by_line;
@@ -49,6 +55,29 @@ struct _GtkTextLineDisplayCache
 #endif
 };
 
+/* Hits, misses and evictions are always counted, for all caches
+ * together, and reported to the profiler once per frame from
+ * gtk_text_line_display_cache_end_frame().
+ */
+enum {
+  FRAME_STAT_HITS,
+  FRAME_STAT_MISSES,
+  FRAME_STAT_EVICTIONS,
+  N_FRAME_STATS
+};
+
+static const struct {
+  const char *name;
+  const char *description;
+} frame_stat_info[N_FRAME_STATS] = {
+  { "linedisplay-hits", "Text Line Display Cache Hits" },
+  { "linedisplay-misses", "Text Line Display Cache Misses" },
+  { "linedisplay-evictions", "Text Line Display Cache Evictions" },
+};
+
+static guint frame_stats[N_FRAME_STATS];
+static guint frame_stat_counters[N_FRAME_STATS];
+
 #if DEBUG_LINE_DISPLAY_CACHE
 # define STAT_ADD(val,n) ((val) += n)
 # define STAT_INC(val)   STAT_ADD(val,1)
@@ -56,11 +85,11 @@ static gboolean
 dump_stats (gpointer data)
 {
   GtkTextLineDisplayCache *cache = data;
-  g_printerr ("%p: size=%u hits=%d misses=%d inval_total=%d "
-              "inval_cursors=%d inval_by_line=%d "
+  g_printerr ("%p: size=%u mru_size=%u hits=%d misses=%d evictions=%d "
+              "inval_total=%d inval_cursors=%d inval_by_line=%d "
               "inval_by_range=%d inval_by_y_range=%d\n",
               cache, g_hash_table_size (cache->line_to_display),
-              cache->hits, cache->misses,
+              cache->mru_size, cache->hits, cache->misses, cache->evictions,
               cache->inval, cache->inval_cursors,
               cache->inval_by_line, cache->inval_by_range,
               cache->inval_by_y_range);
@@ -80,6 +109,7 @@ gtk_text_line_display_cache_new (void)
   ret->sorted_by_line = g_sequence_new ((GDestroyNotify)gtk_text_line_display_unref);
   ret->line_to_display = g_hash_table_new (NULL, NULL);
   ret->mru_size = DEFAULT_MRU_SIZE;
+  ret->requested_mru_size = DEFAULT_MRU_SIZE;
 
 #if DEBUG_LINE_DISPLAY_CACHE
   ret->log_source = g_timeout_add_seconds (1, dump_stats, ret);
@@ -116,6 +146,9 @@ gtk_text_line_display_cache_blow_cb (gpointer data)
 
   cache->evict_source = NULL;
 
+  frame_stats[FRAME_STAT_EVICTIONS] += cache->mru.length;
+  STAT_ADD (cache->evictions, cache->mru.length);
+
   gtk_text_line_display_cache_invalidate (cache);
 
   return G_SOURCE_REMOVE;
@@ -145,6 +178,20 @@ gtk_text_line_display_cache_delay_eviction (GtkTextLineDisplayCache *cache)
     }
 }
 
+static void
+gtk_text_line_display_cache_cull (GtkTextLineDisplayCache *cache)
+{
+  while (cache->mru.length > cache->mru_size)
+    {
+      GtkTextLineDisplay *display = g_queue_peek_tail (&cache->mru);
+
+      gtk_text_line_display_cache_invalidate_display (cache, display, FALSE);
+
+      frame_stats[FRAME_STAT_EVICTIONS]++;
+      STAT_INC (cache->evictions);
+    }
+}
+
 #if DEBUG_LINE_DISPLAY_CACHE
 static void
 check_disposition (GtkTextLineDisplayCache *cache,
@@ -202,12 +249,7 @@ gtk_text_line_display_cache_take_display (GtkTextLineDisplayCache *cache,
   g_queue_push_head_link (&cache->mru, &display->mru_link);
 
   /* Cull the cache if we're at capacity */
-  while (cache->mru.length > cache->mru_size)
-    {
-      display = g_queue_peek_tail (&cache->mru);
-
-      gtk_text_line_display_cache_invalidate_display (cache, display, FALSE);
-    }
+  gtk_text_line_display_cache_cull (cache);
 }
 
 /*
@@ -289,6 +331,7 @@ gtk_text_line_display_cache_get (GtkTextLineDisplayCache *cache,
     {
       if (size_only || !display->size_only)
         {
+          frame_stats[FRAME_STAT_HITS]++;
           STAT_INC (cache->hits);
 
           if (!size_only && display->line == cache->cursor_line)
@@ -308,6 +351,7 @@ gtk_text_line_display_cache_get (GtkTextLineDisplayCache *cache,
       gtk_text_line_display_cache_invalidate_display (cache, display, FALSE);
     }
 
+  frame_stats[FRAME_STAT_MISSES]++;
   STAT_INC (cache->misses);
 
   g_assert (!g_hash_table_lookup (cache->line_to_display, line));
@@ -720,26 +764,73 @@ gtk_text_line_display_cache_set_cursor_line (GtkTextLineDisplayCache *cache,
     gtk_text_line_display_cache_invalidate_display (cache, display, FALSE);
 }
 
+static void
+gtk_text_line_display_cache_update_mru_size (GtkTextLineDisplayCache *cache)
+{
+  guint mru_size;
+
+  /* The requested size is only an estimate based on the default font,
+   * so never go below what is needed to keep a few screens worth of
+   * the lines that were actually drawn.
+   */
+  mru_size = MAX (cache->requested_mru_size, cache->n_visible_lines * MRU_SCREENS);
+
+  if (mru_size != cache->mru_size)
+    {
+      cache->mru_size = mru_size;
+      gtk_text_line_display_cache_cull (cache);
+    }
+}
+
 void
 gtk_text_line_display_cache_set_mru_size (GtkTextLineDisplayCache *cache,
                                           guint                    mru_size)
 {
-  GtkTextLineDisplay *display;
-
   g_assert (cache != NULL);
 
   if (mru_size == 0)
     mru_size = DEFAULT_MRU_SIZE;
 
-  if (mru_size != cache->mru_size)
+  cache->requested_mru_size = mru_size;
+  gtk_text_line_display_cache_update_mru_size (cache);
+}
+
+/*
+ * gtk_text_line_display_cache_end_frame:
+ * @cache: a GtkTextLineDisplayCache
+ * @n_visible_lines: the number of lines that were drawn
+ *
+ * Called after the layout has been drawn. The cache is grown as
+ * needed to hold @n_visible_lines, so that scrolling does not need
+ * to recreate the displays for the lines that were just on screen,
+ * and the statistics are reported to the profiler.
+ */
+void
+gtk_text_line_display_cache_end_frame (GtkTextLineDisplayCache *cache,
+                                       guint                    n_visible_lines)
+{
+  guint i;
+
+  g_assert (cache != NULL);
+
+  cache->n_visible_lines = n_visible_lines;
+  gtk_text_line_display_cache_update_mru_size (cache);
+
+  if (GDK_PROFILER_IS_RUNNING)
     {
-      cache->mru_size = mru_size;
+      gint64 now = g_get_monotonic_time ();
 
-      while (cache->mru.length > cache->mru_size)
+      if (frame_stat_counters[0] == 0)
         {
-          display = g_queue_peek_tail (&cache->mru);
-
-          gtk_text_line_display_cache_invalidate_display (cache, display, FALSE);
+          for (i = 0; i < N_FRAME_STATS; i++)
+            frame_stat_counters[i] = gdk_profiler_define_int_counter (frame_stat_info[i].name,
+                                                                      frame_stat_info[i].description);
         }
+
+      for (i = 0; i < N_FRAME_STATS; i++)
+        gdk_profiler_set_int_counter (frame_stat_counters[i], now, frame_stats[i]);
     }
+
+  for (i = 0; i < N_FRAME_STATS; i++)
+    frame_stats[i] = 0;
 }
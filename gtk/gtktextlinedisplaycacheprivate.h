@@ -55,6 +55,8 @@ void                     gtk_text_line_display_cache_invalidate_y_range (GtkText
                                                                          gboolean                 cursors_only);
 void                     gtk_text_line_display_cache_set_mru_size       (GtkTextLineDisplayCache *cache,
                                                                          guint                    mru_size);
+void                     gtk_text_line_display_cache_end_frame          (GtkTextLineDisplayCache *cache,
+                                                                         guint                    n_visible_lines);
 
 G_END_DECLS
 
@@ -144,6 +144,13 @@
 
 #define SPACE_FOR_CURSOR 1
 
+/* Offscreen lines are validated in steps of this many pixels,
+ * for at most this much time per idle. 3/5 of a frame at 60Hz,
+ * same as GtkTreeView.
+ */
+#define INCREMENTAL_VALIDATE_PIXELS 500
+#define INCREMENTAL_VALIDATE_TIME_USEC 10000
+
 typedef struct _GtkTextWindow GtkTextWindow;
 typedef struct _GtkTextPendingScroll GtkTextPendingScroll;
 
@@ -224,6 +231,8 @@ struct _GtkTextViewPrivate
 
   guint first_validate_idle;        /* Idle to revalidate onscreen portion, runs before resize */
   guint incremental_validate_idle;  /* Idle to revalidate offscreen portions, runs after redraw */
+  guint prefetch_idle;              /* Idle to lay out the lines about to be scrolled into view */
+  int scroll_direction;             /* 1 when the last scroll went down, -1 when it went up */
 
   GtkTextMark *dnd_mark;
 
@@ -3756,6 +3765,8 @@ gtk_text_view_remove_validate_idles (GtkTextView *text_view)
       g_source_remove (priv->incremental_validate_idle);
       priv->incremental_validate_idle = 0;
     }
+
+  g_clear_handle_id (&priv->prefetch_idle, g_source_remove);
 }
 
 static void
@@ -4657,10 +4668,21 @@ incremental_validate_callback (gpointer data)
 {
   GtkTextView *text_view = data;
   gboolean result = TRUE;
+  gint64 deadline;
 
   DV(g_print(G_STRLOC"\n"));
-  
-  gtk_text_layout_validate (text_view->priv->layout, 2000);
+
+  /* Heavily tagged paragraphs can be slow to lay out, so rather than
+   * a fixed amount of pixels, validate as much as fits in a time
+   * slice. That keeps input responsive while the scrollbar converges.
+   */
+  deadline = g_get_monotonic_time () + INCREMENTAL_VALIDATE_TIME_USEC;
+  do
+    {
+      gtk_text_layout_validate (text_view->priv->layout, INCREMENTAL_VALIDATE_PIXELS);
+    }
+  while (!gtk_text_layout_is_valid (text_view->priv->layout) &&
+         g_get_monotonic_time () < deadline);
 
   gtk_text_view_update_adjustments (text_view);
   
@@ -4673,6 +4695,46 @@ incremental_validate_callback (gpointer data)
   return result;
 }
 
+static gboolean
+prefetch_callback (gpointer data)
+{
+  GtkTextView *text_view = data;
+  GtkTextViewPrivate *priv = text_view->priv;
+  int height;
+
+  priv->prefetch_idle = 0;
+
+  if (priv->layout == NULL)
+    return G_SOURCE_REMOVE;
+
+  /* Lay out the screenful of lines beyond the visible area in the
+   * direction we are scrolling, so they come from the line display
+   * cache when they get drawn.
+   */
+  height = SCREEN_HEIGHT (text_view);
+  if (priv->scroll_direction > 0)
+    gtk_text_layout_prefetch (priv->layout, priv->yoffset + height, height);
+  else
+    gtk_text_layout_prefetch (priv->layout, priv->yoffset - 1, -height);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gtk_text_view_queue_prefetch (GtkTextView *text_view,
+                              int          direction)
+{
+  GtkTextViewPrivate *priv = text_view->priv;
+
+  priv->scroll_direction = direction;
+
+  if (priv->prefetch_idle == 0)
+    {
+      priv->prefetch_idle = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, prefetch_callback, text_view, NULL);
+      g_source_set_name_by_id (priv->prefetch_idle, "[gtk] prefetch_callback");
+    }
+}
+
 static void
 gtk_text_view_invalidate (GtkTextView *text_view)
 {
@@ -8080,6 +8142,9 @@ gtk_text_view_value_changed (GtkAdjustment *adjustment,
           if (priv->selection_bubble)
             gtk_widget_hide (priv->selection_bubble);
         }
+
+      if (dy != 0 && priv->layout)
+        gtk_text_view_queue_prefetch (text_view, dy < 0 ? 1 : -1);
     }
 
   /* This could result in invalidation, which would install the
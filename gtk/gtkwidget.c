@@ -81,6 +81,7 @@
 #include "gdk/gdkprofilerprivate.h"
 #include "gsk/gskdebugprivate.h"
 #include "gsk/gskrendererprivate.h"
+#include "gsk/gskrendernodeprivate.h"
 
 #include <cairo-gobject.h>
 #include <gobject/gobjectnotifyqueue.c>
@@ -3424,7 +3425,9 @@ gtk_widget_queue_draw (GtkWidget *widget)
         break;
 
       priv->draw_needed = TRUE;
+      priv->effects_needed = FALSE;
       g_clear_pointer (&priv->render_node, gsk_render_node_unref);
+      g_clear_pointer (&priv->content_node, gsk_render_node_unref);
       if (GTK_IS_NATIVE (widget) && _gtk_widget_get_realized (widget))
         gdk_surface_queue_expose (gtk_native_get_surface (GTK_NATIVE (widget)));
     }
@@ -3763,6 +3766,45 @@ gtk_widget_adjust_size_allocation (GtkWidget     *widget,
                     &allocation->height);
 }
 
+/* Applies the CSS transform of @style to @transform, taking ownership
+ * of it, and returns the transform to the content box of a widget
+ * whose margin box is @box.
+ */
+static GskTransform *
+gtk_widget_apply_css_transform (GtkCssStyle        *style,
+                                GskTransform       *transform,
+                                const GdkRectangle *box,
+                                const GtkBorder    *border,
+                                const GtkBorder    *padding)
+{
+  GskTransform *css_transform;
+  int x, y;
+
+  x = box->x;
+  y = box->y;
+  css_transform = gtk_css_transform_value_get_transform (style->other->transform);
+
+  if (css_transform)
+    {
+      transform = gsk_transform_translate (transform, &GRAPHENE_POINT_INIT (x, y));
+      x = y = 0;
+
+      transform = gsk_transform_translate (transform, &GRAPHENE_POINT_INIT (box->width / 2, box->height / 2));
+      transform = gsk_transform_transform (transform, css_transform);
+      transform = gsk_transform_translate (transform, &GRAPHENE_POINT_INIT (- box->width / 2, - box->height / 2));
+
+      gsk_transform_unref (css_transform);
+    }
+
+  x += border->left + padding->left;
+  y += border->top + padding->top;
+
+  if (x || y)
+    transform = gsk_transform_translate (transform, &GRAPHENE_POINT_INIT (x, y));
+
+  return transform;
+}
+
 /**
  * gtk_widget_allocate:
  * @widget: A #GtkWidget
@@ -3795,7 +3837,6 @@ gtk_widget_allocate (GtkWidget    *widget,
   gboolean transform_changed;
   GtkCssStyle *style;
   GtkBorder margin, border, padding;
-  GskTransform *css_transform;
 
   g_return_if_fail (GTK_IS_WIDGET (widget));
   g_return_if_fail (baseline >= -1);
@@ -3862,30 +3903,13 @@ gtk_widget_allocate (GtkWidget    *widget,
   adjusted.y += margin.top;
   adjusted.width -= margin.left + margin.right;
   adjusted.height -= margin.top + margin.bottom;
-  css_transform = gtk_css_transform_value_get_transform (style->other->transform);
-
-  if (css_transform)
-    {
-      transform = gsk_transform_translate (transform, &GRAPHENE_POINT_INIT (adjusted.x, adjusted.y));
-      adjusted.x = adjusted.y = 0;
-
-      transform = gsk_transform_translate (transform, &GRAPHENE_POINT_INIT (adjusted.width / 2, adjusted.height / 2));
-      transform = gsk_transform_transform (transform, css_transform);
-      transform = gsk_transform_translate (transform, &GRAPHENE_POINT_INIT (- adjusted.width / 2, - adjusted.height / 2));
-
-      gsk_transform_unref (css_transform);
-    }
-
-  adjusted.x += border.left + padding.left;
-  adjusted.y += border.top + padding.top;
+  priv->css_transform_box = adjusted;
 
   if (baseline >= 0)
     baseline -= margin.top + border.top + padding.top;
-  if (adjusted.x || adjusted.y)
-    transform = gsk_transform_translate (transform, &GRAPHENE_POINT_INIT (adjusted.x, adjusted.y));
 
   gsk_transform_unref (priv->transform);
-  priv->transform = transform;
+  priv->transform = gtk_widget_apply_css_transform (style, transform, &adjusted, &border, &padding);
 
   if (priv->surface_transform_data)
     sync_widget_surface_transform (widget);
@@ -4684,6 +4708,77 @@ gtk_widget_real_state_flags_changed (GtkWidget     *widget,
 {
 }
 
+/* Recomputes the transform after a change of the CSS transform
+ * without reallocating, which is possible because the box it is
+ * applied to does not depend on it.
+ */
+static void
+gtk_widget_update_css_transform (GtkWidget *widget)
+{
+  GtkWidgetPrivate *priv = gtk_widget_get_instance_private (widget);
+  GtkCssStyle *style;
+  GtkBorder border, padding;
+  GskTransform *transform;
+
+  if (priv->parent == NULL)
+    return;
+
+  if (priv->alloc_needed)
+    {
+      gtk_widget_queue_allocate (priv->parent);
+      return;
+    }
+
+  style = gtk_css_node_get_style (priv->cssnode);
+  get_box_border (style, &border);
+  get_box_padding (style, &padding);
+
+  transform = gtk_widget_apply_css_transform (style,
+                                              gsk_transform_ref (priv->allocated_transform),
+                                              &priv->css_transform_box,
+                                              &border, &padding);
+
+  if (gsk_transform_equal (transform, priv->transform))
+    {
+      gsk_transform_unref (transform);
+      return;
+    }
+
+  gsk_transform_unref (priv->transform);
+  priv->transform = transform;
+
+  if (priv->surface_transform_data)
+    sync_widget_surface_transform (widget);
+
+  gtk_widget_queue_draw (priv->parent);
+}
+
+/* Like gtk_widget_queue_draw(), but only the opacity and filters
+ * changed, so the existing contents can be reused.
+ */
+static void
+gtk_widget_queue_effects (GtkWidget *widget)
+{
+  GtkWidgetPrivate *priv = gtk_widget_get_instance_private (widget);
+
+  if (!_gtk_widget_get_mapped (widget))
+    return;
+
+  if (priv->draw_needed)
+    return;
+
+  if (priv->content_node == NULL ||
+      priv->parent == NULL ||
+      GTK_IS_NATIVE (widget))
+    {
+      gtk_widget_queue_draw (widget);
+      return;
+    }
+
+  priv->effects_needed = TRUE;
+  gtk_widget_queue_draw (priv->parent);
+}
+
 static void
 gtk_widget_real_css_changed (GtkWidget         *widget,
                              GtkCssStyleChange *change)
@@ -4704,6 +4799,17 @@ gtk_widget_real_css_changed (GtkWidget         *widget,
             {
               gtk_widget_queue_resize (widget);
             }
+          else if (!gtk_css_style_change_affects (change, ~(GTK_CSS_AFFECTS_TRANSFORM |
+                                                            GTK_CSS_AFFECTS_POSTEFFECT)))
+            {
+              /* Only transform, opacity or filters changed. This is what
+               * most animations do, so avoid relayout and reuse the
+               * contents we already have. */
+              if (gtk_css_style_change_affects (change, GTK_CSS_AFFECTS_TRANSFORM))
+                gtk_widget_update_css_transform (widget);
+              if (gtk_css_style_change_affects (change, GTK_CSS_AFFECTS_POSTEFFECT))
+                gtk_widget_queue_effects (widget);
+            }
           else if (gtk_css_style_change_affects (change, GTK_CSS_AFFECTS_TRANSFORM))
             {
               gtk_widget_queue_allocate (priv->parent);
@@ -11349,36 +11455,16 @@ gtk_widget_list_controllers (GtkWidget           *widget,
 }
 
 static GskRenderNode *
-gtk_widget_create_render_node (GtkWidget   *widget,
-                               GtkSnapshot *snapshot)
+gtk_widget_create_content_node (GtkWidget   *widget,
+                                GtkSnapshot *snapshot)
 {
   GtkWidgetClass *klass = GTK_WIDGET_GET_CLASS (widget);
   GtkWidgetPrivate *priv = gtk_widget_get_instance_private (widget);
   GtkCssBoxes boxes;
-  GtkCssValue *filter_value;
-  double css_opacity, opacity;
-  GtkCssStyle *style;
-
-  style = gtk_css_node_get_style (priv->cssnode);
-
-  css_opacity = _gtk_css_number_value_get (style->other->opacity, 100);
-  opacity = CLAMP (css_opacity, 0.0, 1.0) * priv->user_alpha / 255.0;
-
-  if (opacity <= 0.0)
-    return NULL;
 
   gtk_css_boxes_init (&boxes, widget);
 
   gtk_snapshot_push_collect (snapshot);
-  gtk_snapshot_push_debug (snapshot,
-                           "RenderNode for %s %p",
-                           G_OBJECT_TYPE_NAME (widget), widget);
-
-  filter_value = style->other->filter;
-  gtk_css_filter_value_push_snapshot (filter_value, snapshot);
-
-  if (opacity < 1.0)
-    gtk_snapshot_push_opacity (snapshot, opacity);
 
   gtk_css_style_snapshot_background (&boxes, snapshot);
   gtk_css_style_snapshot_border (&boxes, snapshot);
@@ -11396,6 +11482,40 @@ gtk_widget_create_render_node (GtkWidget   *widget,
 
   gtk_css_style_snapshot_outline (&boxes, snapshot);
 
+  return gtk_snapshot_pop_collect (snapshot);
+}
+
+/* Wraps the content node in the opacity and filters from the
+ * style. This is all that needs to be redone when only those
+ * change, as is common for animations and transitions.
+ */
+static GskRenderNode *
+gtk_widget_wrap_content_node (GtkWidget   *widget,
+                              GtkSnapshot *snapshot,
+                              double       opacity)
+{
+  GtkWidgetPrivate *priv = gtk_widget_get_instance_private (widget);
+  GtkCssValue *filter_value;
+  GtkCssStyle *style;
+
+  if (priv->content_node == NULL)
+    return NULL;
+
+  style = gtk_css_node_get_style (priv->cssnode);
+
+  gtk_snapshot_push_collect (snapshot);
+  gtk_snapshot_push_debug (snapshot,
+                           "RenderNode for %s %p",
+                           G_OBJECT_TYPE_NAME (widget), widget);
+
+  filter_value = style->other->filter;
+  gtk_css_filter_value_push_snapshot (filter_value, snapshot);
+
+  if (opacity < 1.0)
+    gtk_snapshot_push_opacity (snapshot, opacity);
+
+  gtk_snapshot_append_node (snapshot, priv->content_node);
+
   if (opacity < 1.0)
     gtk_snapshot_pop (snapshot);
 
@@ -11406,15 +11526,51 @@ gtk_widget_create_render_node (GtkWidget   *widget,
   return gtk_snapshot_pop_collect (snapshot);
 }
 
+static double
+gtk_widget_get_effective_opacity (GtkWidget *widget)
+{
+  GtkWidgetPrivate *priv = gtk_widget_get_instance_private (widget);
+  GtkCssStyle *style;
+  double css_opacity;
+
+  style = gtk_css_node_get_style (priv->cssnode);
+
+  css_opacity = _gtk_css_number_value_get (style->other->opacity, 100);
+
+  return CLAMP (css_opacity, 0.0, 1.0) * priv->user_alpha / 255.0;
+}
+
 static void
 gtk_widget_do_snapshot (GtkWidget *widget,
                         GtkSnapshot *snapshot)
 {
   GtkWidgetPrivate *priv = gtk_widget_get_instance_private (widget);
-  GskRenderNode *render_node;
+  GskRenderNodeArena *arena;
+  GskRenderNode *content_node;
+  double opacity;
 
   if (!priv->draw_needed)
-    return;
+    {
+      if (priv->effects_needed)
+        {
+          /* Only opacity or filters changed, keep the contents */
+          opacity = gtk_widget_get_effective_opacity (widget);
+          g_clear_pointer (&priv->render_node, gsk_render_node_unref);
+          if (opacity > 0.0)
+            {
+              /* The wrapper is cached, keep it out of the parent's arena */
+              arena = gsk_render_node_arena_begin (0);
+              priv->render_node = gtk_widget_wrap_content_node (widget, snapshot, opacity);
+              gsk_render_node_arena_end (arena);
+            }
+          priv->effects_needed = FALSE;
+
+          /* Paintables show the render node, so they changed too */
+          gtk_widget_update_paintables (widget);
+        }
+
+      return;
+    }
 
   g_assert (priv->mapped);
 
@@ -11426,12 +11582,29 @@ gtk_widget_do_snapshot (GtkWidget *widget,
 
   gtk_widget_push_paintables (widget);
 
-  render_node = gtk_widget_create_render_node (widget, snapshot);
+  /* The nodes of each widget, including the wrapper for its
+   * effects, get their own arena, so that the cached render node
+   * only keeps its own memory alive and not the parent's. It is
+   * sized from the last snapshot, so small widgets don't keep
+   * a whole chunk alive. */
+  arena = gsk_render_node_arena_begin (priv->content_arena_size);
+  opacity = gtk_widget_get_effective_opacity (widget);
+  if (opacity > 0.0)
+    content_node = gtk_widget_create_content_node (widget, snapshot);
+  else
+    content_node = NULL;
+
   /* This can happen when nested drawing happens and a widget contains itself
    * or when we replace a clipped area */
+  g_clear_pointer (&priv->content_node, gsk_render_node_unref);
+  priv->content_node = content_node;
+
   g_clear_pointer (&priv->render_node, gsk_render_node_unref);
-  priv->render_node = render_node;
+  if (content_node)
+    priv->render_node = gtk_widget_wrap_content_node (widget, snapshot, opacity);
+  priv->content_arena_size = gsk_render_node_arena_end (arena);
 
+  priv->effects_needed = FALSE;
   priv->draw_needed = FALSE;
 
   gtk_widget_pop_paintables (widget);
@@ -88,6 +88,7 @@ struct _GtkWidgetPrivate
 
   /* Queue-draw related flags */
   guint draw_needed           : 1;
+  guint effects_needed        : 1; /* only opacity or filter changed, rewrap content_node */
   /* Expand-related flags */
   guint need_compute_expand   : 1; /* Need to recompute computed_[hv]_expand */
   guint computed_hexpand      : 1; /* computed results (composite of child flags) */
@@ -159,11 +160,21 @@ struct _GtkWidgetPrivate
   int baseline;
   GskTransform *transform;
 
+  /* The box the CSS transform is applied to, relative
+   * to allocated_transform. */
+  GdkRectangle css_transform_box;
+
   /* The widget's requested sizes */
   SizeRequestCache requests;
 
   /* The render node we draw or %NULL if not yet created.*/
   GskRenderNode *render_node;
+  /* The contents of render_node, before opacity and filters
+   * are applied, or %NULL if not yet created. */
+  GskRenderNode *content_node;
+  /* The size of the arena content_node was allocated from,
+   * to size the next one. */
+  gsize content_arena_size;
 
   /* The layout manager, or %NULL */
   GtkLayoutManager *layout_manager;
@@ -37,6 +37,7 @@
 #include "gtkcsscolorvalueprivate.h"
 #include "gtkcssshadowvalueprivate.h"
 #include "gtkcssstylepropertyprivate.h"
+#include "gtkcssstatsprivate.h"
 #include "gtkdroptargetasync.h"
 #include "gtkeventcontrollerlegacy.h"
 #include "gtkeventcontrollerkey.h"
@@ -388,6 +389,8 @@ static gboolean surface_render            (GdkSurface         *surface,
 static gboolean surface_event             (GdkSurface         *surface,
                                            GdkEvent           *event,
                                            GtkWidget          *widget);
+static void     frame_clock_after_paint   (GdkFrameClock      *clock,
+                                           GtkWidget          *widget);
 
 static int gtk_window_focus              (GtkWidget        *widget,
 				           GtkDirectionType  direction);
@@ -4352,6 +4355,8 @@ gtk_window_realize (GtkWidget *widget)
   g_signal_connect_swapped (surface, "size-changed", G_CALLBACK (surface_size_changed), widget);
   g_signal_connect (surface, "render", G_CALLBACK (surface_render), widget);
   g_signal_connect (surface, "event", G_CALLBACK (surface_event), widget);
+  g_signal_connect (gdk_surface_get_frame_clock (surface), "after-paint",
+                    G_CALLBACK (frame_clock_after_paint), widget);
 
   GTK_WIDGET_CLASS (gtk_window_parent_class)->realize (widget);
 
@@ -4460,6 +4465,8 @@ gtk_window_unrealize (GtkWidget *widget)
   g_signal_handlers_disconnect_by_func (surface, surface_size_changed, widget);
   g_signal_handlers_disconnect_by_func (surface, surface_render, widget);
   g_signal_handlers_disconnect_by_func (surface, surface_event, widget);
+  g_signal_handlers_disconnect_by_func (gdk_surface_get_frame_clock (surface),
+                                        frame_clock_after_paint, widget);
 
   gtk_root_stop_layout (GTK_ROOT (window));
 
@@ -4740,6 +4747,13 @@ surface_event (GdkSurface *surface,
   return TRUE;
 }
 
+static void
+frame_clock_after_paint (GdkFrameClock *clock,
+                         GtkWidget     *widget)
+{
+  gtk_css_stats_end_frame (g_get_monotonic_time ());
+}
+
 static void
 gtk_window_real_activate_focus (GtkWindow *window)
 {
@@ -82,6 +82,7 @@ struct _GtkInspectorCssNodeTreePrivate
   GtkWidget *prop_tree;
   GtkTreeViewColumn *prop_name_column;
   GHashTable *prop_iters;
+  GtkWidget *lookup_cache_stats;
   GtkCssNode *node;
 };
 
@@ -249,6 +250,7 @@ gtk_inspector_css_node_tree_class_init (GtkInspectorCssNodeTreeClass *klass)
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorCssNodeTree, node_classes_column);
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorCssNodeTree, prop_name_column);
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorCssNodeTree, prop_model);
+  gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorCssNodeTree, lookup_cache_stats);
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorCssNodeTree, prop_name_column);
 
   gtk_widget_class_bind_template_callback (widget_class, row_activated);
@@ -428,6 +430,23 @@ gtk_inspector_css_node_tree_set_object (GtkInspectorCssNodeTree *cnt,
   gtk_tree_path_free (path);
 }
 
+static void
+gtk_inspector_css_node_tree_update_lookup_cache_stats (GtkInspectorCssNodeTree *cnt)
+{
+  guint64 hits, misses;
+  char *hits_str, *misses_str, *text;
+
+  gtk_css_provider_get_lookup_cache_stats (&hits, &misses);
+
+  hits_str = g_strdup_printf ("%" G_GUINT64_FORMAT, hits);
+  misses_str = g_strdup_printf ("%" G_GUINT64_FORMAT, misses);
+  text = g_strdup_printf (_("Style lookup cache: %s hits, %s misses"), hits_str, misses_str);
+  gtk_label_set_text (GTK_LABEL (cnt->priv->lookup_cache_stats), text);
+  g_free (text);
+  g_free (misses_str);
+  g_free (hits_str);
+}
+
 static void
 gtk_inspector_css_node_tree_update_style (GtkInspectorCssNodeTree *cnt,
                                           GtkCssStyle             *new_style)
@@ -435,6 +454,8 @@ gtk_inspector_css_node_tree_update_style (GtkInspectorCssNodeTree *cnt,
   GtkInspectorCssNodeTreePrivate *priv = cnt->priv;
   int i;
 
+  gtk_inspector_css_node_tree_update_lookup_cache_stats (cnt);
+
   for (i = 0; i < _gtk_css_style_property_get_n_properties (); i++)
     {
       GtkCssStyleProperty *prop;
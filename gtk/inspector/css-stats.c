@@ -0,0 +1,176 @@
+/*
+ * Copyright © 2020 GNOME Foundation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <glib/gi18n-lib.h>
+
+#include "css-stats.h"
+
+#include "gtkbinlayout.h"
+#include "gtkbutton.h"
+#include "gtkcssstatsprivate.h"
+#include "gtkgrid.h"
+#include "gtklabel.h"
+
+struct _GtkInspectorCssStats
+{
+  GtkWidget parent;
+
+  GtkWidget *swin;
+  GtkWidget *grid;
+
+  GtkWidget *last_frame[GTK_CSS_N_STATS];
+  GtkWidget *total[GTK_CSS_N_STATS];
+
+  guint update_source_id;
+};
+
+typedef struct _GtkInspectorCssStatsClass
+{
+  GtkWidgetClass parent;
+} GtkInspectorCssStatsClass;
+
+G_DEFINE_TYPE (GtkInspectorCssStats, gtk_inspector_css_stats, GTK_TYPE_WIDGET)
+
+static const char *stat_names[GTK_CSS_N_STATS] = {
+  N_("Invalidated nodes"),
+  N_("Created styles"),
+  N_("Animated styles"),
+  N_("Selectors visited"),
+  N_("Bloom filter rejections"),
+  N_("Style cache hits"),
+  N_("Style cache misses"),
+  N_("Lookup time (µs)"),
+  N_("Compute time (µs)"),
+  N_("Animation time (µs)"),
+};
+
+static gboolean
+update_stats (gpointer data)
+{
+  GtkInspectorCssStats *sl = data;
+  guint i;
+
+  for (i = 0; i < GTK_CSS_N_STATS; i++)
+    {
+      gint64 last_frame, total;
+      char *text;
+
+      gtk_css_stats_get (i, &last_frame, &total);
+
+      text = g_strdup_printf ("%" G_GINT64_FORMAT, last_frame);
+      gtk_label_set_text (GTK_LABEL (sl->last_frame[i]), text);
+      g_free (text);
+
+      text = g_strdup_printf ("%" G_GINT64_FORMAT, total);
+      gtk_label_set_text (GTK_LABEL (sl->total[i]), text);
+      g_free (text);
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+reset_clicked (GtkButton            *button,
+               GtkInspectorCssStats *sl)
+{
+  gtk_css_stats_reset ();
+  update_stats (sl);
+}
+
+static void
+gtk_inspector_css_stats_init (GtkInspectorCssStats *sl)
+{
+  guint i;
+
+  gtk_widget_init_template (GTK_WIDGET (sl));
+
+  for (i = 0; i < GTK_CSS_N_STATS; i++)
+    {
+      GtkWidget *label;
+
+      label = gtk_label_new (_(stat_names[i]));
+      gtk_label_set_xalign (GTK_LABEL (label), 0.0);
+      gtk_grid_attach (GTK_GRID (sl->grid), label, 0, i + 1, 1, 1);
+
+      sl->last_frame[i] = gtk_label_new ("0");
+      gtk_label_set_xalign (GTK_LABEL (sl->last_frame[i]), 1.0);
+      gtk_grid_attach (GTK_GRID (sl->grid), sl->last_frame[i], 1, i + 1, 1, 1);
+
+      sl->total[i] = gtk_label_new ("0");
+      gtk_label_set_xalign (GTK_LABEL (sl->total[i]), 1.0);
+      gtk_grid_attach (GTK_GRID (sl->grid), sl->total[i], 2, i + 1, 1, 1);
+    }
+}
+
+static void
+map (GtkWidget *widget)
+{
+  GtkInspectorCssStats *sl = GTK_INSPECTOR_CSS_STATS (widget);
+
+  GTK_WIDGET_CLASS (gtk_inspector_css_stats_parent_class)->map (widget);
+
+  /* Only measure times while somebody is looking */
+  gtk_css_stats_set_timing (TRUE);
+
+  sl->update_source_id = g_timeout_add_seconds (1, update_stats, sl);
+  update_stats (sl);
+}
+
+static void
+unmap (GtkWidget *widget)
+{
+  GtkInspectorCssStats *sl = GTK_INSPECTOR_CSS_STATS (widget);
+
+  g_source_remove (sl->update_source_id);
+  sl->update_source_id = 0;
+
+  gtk_css_stats_set_timing (FALSE);
+
+  GTK_WIDGET_CLASS (gtk_inspector_css_stats_parent_class)->unmap (widget);
+}
+
+static void
+dispose (GObject *o)
+{
+  GtkInspectorCssStats *sl = GTK_INSPECTOR_CSS_STATS (o);
+
+  g_clear_pointer (&sl->swin, gtk_widget_unparent);
+
+  G_OBJECT_CLASS (gtk_inspector_css_stats_parent_class)->dispose (o);
+}
+
+static void
+gtk_inspector_css_stats_class_init (GtkInspectorCssStatsClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->dispose = dispose;
+
+  widget_class->map = map;
+  widget_class->unmap = unmap;
+
+  gtk_widget_class_set_template_from_resource (widget_class, "/org/gtk/libgtk/inspector/css-stats.ui");
+  gtk_widget_class_bind_template_child (widget_class, GtkInspectorCssStats, swin);
+  gtk_widget_class_bind_template_child (widget_class, GtkInspectorCssStats, grid);
+  gtk_widget_class_bind_template_callback (widget_class, reset_clicked);
+
+  gtk_widget_class_set_layout_manager_type (widget_class, GTK_TYPE_BIN_LAYOUT);
+}
+
+// vim: set et sw=2 ts=2:
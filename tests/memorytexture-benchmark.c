@@ -0,0 +1,118 @@
+/* memorytexture-benchmark: Measures how fast memory textures of all
+ * formats can be converted, by downloading a 4K texture.
+ */
+#include <gtk/gtk.h>
+
+static int runs = 20;
+static int width = 3840;
+static int height = 2160;
+
+static GOptionEntry options[] = {
+  { "runs", 'r', 0, G_OPTION_ARG_INT, &runs, "Download each texture N times", "N" },
+  { "width", 'w', 0, G_OPTION_ARG_INT, &width, "Width of the textures", "WIDTH" },
+  { "height", 'h', 0, G_OPTION_ARG_INT, &height, "Height of the textures", "HEIGHT" },
+  { NULL }
+};
+
+static gsize
+bytes_per_pixel (GdkMemoryFormat format)
+{
+  switch (format)
+    {
+    case GDK_MEMORY_R8G8B8:
+    case GDK_MEMORY_B8G8R8:
+      return 3;
+
+    case GDK_MEMORY_B8G8R8A8_PREMULTIPLIED:
+    case GDK_MEMORY_A8R8G8B8_PREMULTIPLIED:
+    case GDK_MEMORY_B8G8R8A8:
+    case GDK_MEMORY_A8R8G8B8:
+    case GDK_MEMORY_R8G8B8A8:
+    case GDK_MEMORY_A8B8G8R8:
+    case GDK_MEMORY_N_FORMATS:
+    default:
+      return 4;
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  GEnumClass *enum_class;
+  GdkMemoryFormat format;
+  guchar *dest;
+  GRand *rand;
+
+  context = g_option_context_new ("");
+  g_option_context_add_main_entries (context, options, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  if (runs < 1 || width < 1 || height < 1)
+    {
+      g_printerr ("Runs, width and height must be at least 1\n");
+      return 1;
+    }
+
+  gtk_init ();
+
+  enum_class = g_type_class_ref (GDK_TYPE_MEMORY_FORMAT);
+  rand = g_rand_new_with_seed (0);
+  dest = g_malloc ((gsize) width * height * 4);
+
+  for (format = 0; format < GDK_MEMORY_N_FORMATS; format++)
+    {
+      gsize stride = width * bytes_per_pixel (format);
+      GdkTexture *texture;
+      GBytes *bytes;
+      guchar *data;
+      gint64 start, total, best;
+      gsize i;
+      int run;
+
+      data = g_malloc (stride * height);
+      for (i = 0; i < stride * height; i++)
+        data[i] = g_rand_int (rand);
+
+      bytes = g_bytes_new_take (data, stride * height);
+      texture = gdk_memory_texture_new (width, height, format, bytes, stride);
+      g_bytes_unref (bytes);
+
+      /* Warm up the caches and the thread pool */
+      gdk_texture_download (texture, dest, width * 4);
+
+      total = 0;
+      best = G_MAXINT64;
+      for (run = 0; run < runs; run++)
+        {
+          gint64 elapsed;
+
+          start = g_get_monotonic_time ();
+          gdk_texture_download (texture, dest, width * 4);
+          elapsed = g_get_monotonic_time () - start;
+
+          total += elapsed;
+          best = MIN (best, elapsed);
+        }
+
+      g_print ("%-28s -> default: avg %7.3f ms, best %7.3f ms, %8.1f Mpixels/s\n",
+               g_enum_get_value (enum_class, format)->value_name + strlen ("GDK_MEMORY_"),
+               (double) total / runs / 1000.,
+               (double) best / 1000.,
+               (double) width * height * runs / MAX (total, 1));
+
+      g_object_unref (texture);
+    }
+
+  g_free (dest);
+  g_rand_free (rand);
+  g_type_class_unref (enum_class);
+
+  return 0;
+}
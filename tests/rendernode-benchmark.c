@@ -0,0 +1,610 @@
+/* rendernode-benchmark: Replays a directory of render node files
+ * through the available renderers and reports their profiler values.
+ *
+ * The results are written as JSON, and can be compared against the
+ * output of a previous run with --baseline.
+ */
+#include <gtk/gtk.h>
+
+#include "gsk/gskrendererprivate.h"
+
+static char **renderers = NULL;
+static int warmup = 3;
+static int runs = 10;
+static char *output = NULL;
+static char *baseline = NULL;
+static double threshold = 10.0;
+
+static GOptionEntry options[] = {
+  { "renderer", 'r', 0, G_OPTION_ARG_STRING_ARRAY, &renderers, "Benchmark renderer NAME (cairo, opengl, vulkan). May be given multiple times", "NAME" },
+  { "warmup", 'w', 0, G_OPTION_ARG_INT, &warmup, "Render each node N times before measuring", "N" },
+  { "runs", 'n', 0, G_OPTION_ARG_INT, &runs, "Measure N renders of each node", "N" },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Write the JSON results to FILE", "FILE" },
+  { "baseline", 'b', 0, G_OPTION_ARG_FILENAME, &baseline, "Compare the results against FILE", "FILE" },
+  { "threshold", 't', 0, G_OPTION_ARG_DOUBLE, &threshold, "Report changes of more than PERCENT as regressions", "PERCENT" },
+  { NULL }
+};
+
+static const char *default_renderers[] = { "cairo", "opengl", "vulkan", NULL };
+
+static const struct {
+  const char *name;
+  const char *type_name;
+} renderer_types[] = {
+  { "cairo", "GskCairoRenderer" },
+  { "opengl", "GskGLRenderer" },
+  { "gl", "GskGLRenderer" },
+  { "vulkan", "GskVulkanRenderer" },
+};
+
+static void
+deserialize_error_func (const GtkCssSection *section,
+                        const GError        *error,
+                        gpointer             user_data)
+{
+  char *section_str = gtk_css_section_to_string (section);
+
+  g_warning ("Error at %s: %s", section_str, error->message);
+
+  g_free (section_str);
+}
+
+static int
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return strcmp (*(const char **) a, *(const char **) b);
+}
+
+static int
+compare_doubles (gconstpointer a,
+                 gconstpointer b)
+{
+  double da = *(const double *) a;
+  double db = *(const double *) b;
+
+  return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+static GPtrArray *
+list_node_files (const char  *path,
+                 GError     **error)
+{
+  GPtrArray *files;
+  GDir *dir;
+  const char *name;
+
+  files = g_ptr_array_new_with_free_func (g_free);
+
+  if (!g_file_test (path, G_FILE_TEST_IS_DIR))
+    {
+      g_ptr_array_add (files, g_strdup (path));
+      return files;
+    }
+
+  dir = g_dir_open (path, 0, error);
+  if (dir == NULL)
+    {
+      g_ptr_array_unref (files);
+      return NULL;
+    }
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      if (g_str_has_suffix (name, ".node"))
+        g_ptr_array_add (files, g_build_filename (path, name, NULL));
+    }
+
+  g_dir_close (dir);
+
+  g_ptr_array_sort (files, compare_strings);
+
+  return files;
+}
+
+static GskRenderer *
+create_renderer (GdkSurface *surface,
+                 const char *name)
+{
+  GdkDisplay *display = gdk_surface_get_display (surface);
+  const char *type_name = NULL;
+  GskRenderer *renderer;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (renderer_types); i++)
+    {
+      if (g_ascii_strcasecmp (renderer_types[i].name, name) == 0)
+        type_name = renderer_types[i].type_name;
+    }
+
+  if (type_name == NULL)
+    {
+      g_printerr ("Unknown renderer \"%s\"\n", name);
+      return NULL;
+    }
+
+  /* Use the same hook as the inspector to force a renderer */
+  g_object_set_data_full (G_OBJECT (display), "gsk-renderer", g_strdup (name), g_free);
+  renderer = gsk_renderer_new_for_surface (surface);
+  g_object_set_data (G_OBJECT (display), "gsk-renderer", NULL);
+
+  if (renderer != NULL && strcmp (G_OBJECT_TYPE_NAME (renderer), type_name) != 0)
+    {
+      g_printerr ("Renderer \"%s\" is not available, skipping\n", name);
+      gsk_renderer_unrealize (renderer);
+      g_clear_object (&renderer);
+    }
+
+  return renderer;
+}
+
+static void
+add_values (GHashTable *sums,
+            GVariant   *values)
+{
+  GVariantIter iter;
+  const char *key;
+  gint64 value;
+
+  g_variant_iter_init (&iter, values);
+  while (g_variant_iter_next (&iter, "{&sx}", &key, &value))
+    {
+      double *sum = g_hash_table_lookup (sums, key);
+
+      if (sum == NULL)
+        {
+          sum = g_new0 (double, 1);
+          g_hash_table_insert (sums, g_strdup (key), sum);
+        }
+
+      *sum += value;
+    }
+}
+
+/* Renders @node with @renderer and appends a JSON object with the
+ * averaged profiler values of the measured runs to @json.
+ */
+static gboolean
+benchmark_node (GskRenderer   *renderer,
+                GskRenderNode *node,
+                GString       *json)
+{
+  GHashTable *sums;
+  GArray *wall_times;
+  GPtrArray *keys;
+  gint64 start, end;
+  double median;
+  int run;
+  guint i;
+
+  for (run = 0; run < warmup; run++)
+    {
+      GdkTexture *texture = gsk_renderer_render_texture (renderer, node, NULL);
+
+      if (texture == NULL)
+        return FALSE;
+
+      g_object_unref (texture);
+    }
+
+  sums = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  wall_times = g_array_sized_new (FALSE, FALSE, sizeof (double), runs);
+
+  for (run = 0; run < runs; run++)
+    {
+      GdkTexture *texture;
+      GVariant *values;
+      double wall_time;
+
+      start = g_get_monotonic_time ();
+      texture = gsk_renderer_render_texture (renderer, node, NULL);
+      end = g_get_monotonic_time ();
+
+      if (texture == NULL)
+        {
+          g_hash_table_unref (sums);
+          g_array_unref (wall_times);
+          return FALSE;
+        }
+
+      g_object_unref (texture);
+
+      wall_time = end - start;
+      g_array_append_val (wall_times, wall_time);
+      values = g_variant_ref_sink (gsk_renderer_get_profiler_values (renderer));
+      add_values (sums, values);
+      g_variant_unref (values);
+    }
+
+  g_array_sort (wall_times, compare_doubles);
+  median = g_array_index (wall_times, double, wall_times->len / 2);
+
+  g_string_append_printf (json, "{\n        \"wall-time\": %.2f,\n        \"wall-time-min\": %.2f",
+                          median, g_array_index (wall_times, double, 0));
+
+  keys = g_hash_table_get_keys_as_ptr_array (sums);
+  g_ptr_array_sort (keys, compare_strings);
+  for (i = 0; i < keys->len; i++)
+    {
+      const char *key = g_ptr_array_index (keys, i);
+      double *sum = g_hash_table_lookup (sums, key);
+
+      g_string_append_printf (json, ",\n        \"%s\": %.2f", key, *sum / runs);
+    }
+  g_string_append (json, "\n      }");
+
+  g_ptr_array_unref (keys);
+  g_array_unref (wall_times);
+  g_hash_table_unref (sums);
+
+  return TRUE;
+}
+
+static char *
+benchmark_renderer (GdkSurface *surface,
+                    const char *name,
+                    GPtrArray  *nodes,
+                    GPtrArray  *files)
+{
+  GskRenderer *renderer;
+  GString *json;
+  gboolean first = TRUE;
+  guint i;
+
+  renderer = create_renderer (surface, name);
+  if (renderer == NULL)
+    return NULL;
+
+  json = g_string_new ("{");
+
+  for (i = 0; i < files->len; i++)
+    {
+      GskRenderNode *node = g_ptr_array_index (nodes, i);
+      char *basename;
+
+      basename = g_path_get_basename (g_ptr_array_index (files, i));
+      g_string_append_printf (json, "%s\n      \"%s\": ", first ? "" : ",", basename);
+      if (!benchmark_node (renderer, node, json))
+        {
+          g_printerr ("%s: Rendering %s failed\n", name, basename);
+          g_string_append (json, "null");
+        }
+      first = FALSE;
+      g_free (basename);
+    }
+
+  g_string_append (json, "\n    }");
+
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+
+  return g_string_free (json, FALSE);
+}
+
+/* A minimal JSON reader for the files we write ourselves. It flattens
+ * nested objects into "renderer/file/key" -> number.
+ */
+typedef struct {
+  const char *p;
+  const char *end;
+} Reader;
+
+static void
+reader_skip_whitespace (Reader *reader)
+{
+  while (reader->p < reader->end && g_ascii_isspace (*reader->p))
+    reader->p++;
+}
+
+static char *
+reader_parse_string (Reader *reader)
+{
+  const char *start;
+
+  reader_skip_whitespace (reader);
+  if (reader->p >= reader->end || *reader->p != '"')
+    return NULL;
+
+  start = ++reader->p;
+  while (reader->p < reader->end && *reader->p != '"')
+    reader->p++;
+
+  if (reader->p >= reader->end)
+    return NULL;
+
+  return g_strndup (start, reader->p++ - start);
+}
+
+static gboolean
+reader_parse_object (Reader     *reader,
+                     const char *prefix,
+                     GHashTable *values)
+{
+  reader_skip_whitespace (reader);
+  if (reader->p >= reader->end || *reader->p != '{')
+    return FALSE;
+  reader->p++;
+
+  while (TRUE)
+    {
+      char *key, *path;
+      gboolean result = TRUE;
+
+      reader_skip_whitespace (reader);
+      if (reader->p < reader->end && *reader->p == '}')
+        {
+          reader->p++;
+          return TRUE;
+        }
+
+      key = reader_parse_string (reader);
+      if (key == NULL)
+        return FALSE;
+
+      reader_skip_whitespace (reader);
+      if (reader->p >= reader->end || *reader->p != ':')
+        {
+          g_free (key);
+          return FALSE;
+        }
+      reader->p++;
+      reader_skip_whitespace (reader);
+
+      path = prefix ? g_strconcat (prefix, "/", key, NULL) : g_strdup (key);
+      g_free (key);
+
+      if (reader->p < reader->end && *reader->p == '{')
+        {
+          result = reader_parse_object (reader, path, values);
+          g_free (path);
+        }
+      else if (reader->end - reader->p >= 4 && strncmp (reader->p, "null", 4) == 0)
+        {
+          reader->p += 4;
+          g_free (path);
+        }
+      else
+        {
+          char *number_end;
+          double *value = g_new (double, 1);
+
+          *value = g_ascii_strtod (reader->p, &number_end);
+          if (number_end == reader->p)
+            {
+              g_free (value);
+              g_free (path);
+              return FALSE;
+            }
+          reader->p = number_end;
+          g_hash_table_insert (values, path, value);
+        }
+
+      if (!result)
+        return FALSE;
+
+      reader_skip_whitespace (reader);
+      if (reader->p < reader->end && *reader->p == ',')
+        reader->p++;
+    }
+}
+
+static GHashTable *
+parse_results (const char  *json,
+               gsize        length)
+{
+  GHashTable *values;
+  Reader reader = { json, json + length };
+
+  values = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  if (!reader_parse_object (&reader, NULL, values))
+    g_clear_pointer (&values, g_hash_table_unref);
+
+  return values;
+}
+
+static guint
+compare_results (GHashTable *current,
+                 GHashTable *previous)
+{
+  GPtrArray *keys;
+  guint n_regressions = 0;
+  guint i;
+
+  keys = g_hash_table_get_keys_as_ptr_array (current);
+  g_ptr_array_sort (keys, compare_strings);
+
+  for (i = 0; i < keys->len; i++)
+    {
+      const char *key = g_ptr_array_index (keys, i);
+      double *value = g_hash_table_lookup (current, key);
+      double *old_value;
+      double change;
+
+      if (!g_str_has_prefix (key, "results/") ||
+          g_str_has_suffix (key, "/frames"))
+        continue;
+
+      old_value = g_hash_table_lookup (previous, key);
+      if (old_value == NULL)
+        continue;
+
+      if (*old_value == 0)
+        change = *value == 0 ? 0 : 100.0;
+      else
+        change = 100.0 * (*value - *old_value) / *old_value;
+
+      if (change > threshold)
+        {
+          g_printerr ("REGRESSION %s: %.2f -> %.2f (%+.1f%%)\n",
+                   key + strlen ("results/"), *old_value, *value, change);
+          n_regressions++;
+        }
+      else if (change < -threshold)
+        {
+          g_printerr ("improvement %s: %.2f -> %.2f (%+.1f%%)\n",
+                   key + strlen ("results/"), *old_value, *value, change);
+        }
+    }
+
+  g_ptr_array_unref (keys);
+
+  return n_regressions;
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  GPtrArray *files, *nodes;
+  GdkSurface *surface;
+  GString *json;
+  const char * const *names;
+  gboolean first = TRUE;
+  int status = 0;
+  guint i;
+
+  context = g_option_context_new ("NODE-FILE-OR-DIRECTORY");
+  g_option_context_add_main_entries (context, options, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  if (argc != 2)
+    {
+      g_printerr ("Usage: %s [OPTIONS] NODE-FILE-OR-DIRECTORY\n", argv[0]);
+      return 1;
+    }
+
+  if (runs < 1 || warmup < 0)
+    {
+      g_printerr ("Need at least 1 run and no negative warmup runs\n");
+      return 1;
+    }
+
+  gtk_init ();
+
+  files = list_node_files (argv[1], &error);
+  if (files == NULL)
+    {
+      g_printerr ("Could not list node files: %s\n", error->message);
+      return 1;
+    }
+
+  nodes = g_ptr_array_new_with_free_func ((GDestroyNotify) gsk_render_node_unref);
+  for (i = 0; i < files->len; )
+    {
+      const char *filename = g_ptr_array_index (files, i);
+      GskRenderNode *node = NULL;
+      char *contents;
+      gsize len;
+
+      if (g_file_get_contents (filename, &contents, &len, &error))
+        {
+          GBytes *bytes = g_bytes_new_take (contents, len);
+
+          node = gsk_render_node_deserialize (bytes, deserialize_error_func, NULL);
+          g_bytes_unref (bytes);
+        }
+      else
+        {
+          g_printerr ("Could not open node file: %s\n", error->message);
+          g_clear_error (&error);
+        }
+
+      /* Keep the indexes of files and nodes in sync */
+      if (node == NULL)
+        {
+          g_ptr_array_remove_index (files, i);
+          status = 1;
+          continue;
+        }
+
+      g_ptr_array_add (nodes, node);
+      i++;
+    }
+
+  surface = gdk_surface_new_toplevel (gdk_display_get_default (), 10, 10);
+
+  json = g_string_new (NULL);
+  g_string_append_printf (json, "{\n  \"warmup\": %d,\n  \"runs\": %d,\n  \"results\": {", warmup, runs);
+
+  names = renderers ? (const char * const *) renderers : default_renderers;
+  for (i = 0; names[i]; i++)
+    {
+      char *result = benchmark_renderer (surface, names[i], nodes, files);
+
+      if (result == NULL)
+        continue;
+
+      g_string_append_printf (json, "%s\n    \"%s\": %s", first ? "" : ",", names[i], result);
+      first = FALSE;
+      g_free (result);
+    }
+
+  g_string_append (json, "\n  }\n}\n");
+
+  if (output)
+    {
+      if (!g_file_set_contents (output, json->str, json->len, &error))
+        {
+          g_printerr ("Could not write results: %s\n", error->message);
+          g_clear_error (&error);
+          status = 1;
+        }
+    }
+  else
+    {
+      g_print ("%s", json->str);
+    }
+
+  if (baseline)
+    {
+      GHashTable *current, *previous = NULL;
+      char *contents;
+      gsize len;
+
+      current = parse_results (json->str, json->len);
+
+      if (g_file_get_contents (baseline, &contents, &len, &error))
+        {
+          previous = parse_results (contents, len);
+          g_free (contents);
+        }
+      else
+        {
+          g_printerr ("Could not open baseline: %s\n", error->message);
+          g_clear_error (&error);
+        }
+
+      if (previous == NULL)
+        {
+          g_printerr ("Could not parse baseline %s\n", baseline);
+          status = 1;
+        }
+      else
+        {
+          guint n_regressions = compare_results (current, previous);
+
+          if (n_regressions > 0)
+            {
+              g_printerr ("%u regressions over %.1f%%\n", n_regressions, threshold);
+              status = 1;
+            }
+
+          g_hash_table_unref (previous);
+        }
+
+      g_hash_table_unref (current);
+    }
+
+  g_string_free (json, TRUE);
+  g_object_unref (surface);
+  g_ptr_array_unref (nodes);
+  g_ptr_array_unref (files);
+
+  return status;
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright © 2020 GNOME Foundation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+#include "../../gtk/css/gtkcsstokenizerprivate.h"
+
+/* Checks that replaying a precompiled token stream gives the same
+ * tokens, errors and locations as tokenizing the CSS text, using the
+ * parser tests as input.
+ */
+
+/* Consumes @tokenizer */
+static char *
+tokenize (GtkCssTokenizer *tokenizer)
+{
+  GString *result = g_string_new ("");
+
+  if (tokenizer == NULL)
+    return g_string_free (result, FALSE);
+
+  while (TRUE)
+    {
+      const GtkCssLocation *location;
+      GtkCssToken token;
+      GError *error = NULL;
+      char *string;
+
+      gtk_css_tokenizer_read_token (tokenizer, &token, &error);
+      location = gtk_css_tokenizer_get_location (tokenizer);
+
+      string = gtk_css_token_to_string (&token);
+      g_string_append_printf (result, "%" G_GSIZE_FORMAT ":%" G_GSIZE_FORMAT ":%" G_GSIZE_FORMAT ":%" G_GSIZE_FORMAT ":%" G_GSIZE_FORMAT " %s",
+                              location->bytes, location->chars, location->lines,
+                              location->line_bytes, location->line_chars,
+                              string);
+      g_free (string);
+
+      if (error)
+        {
+          g_string_append_printf (result, " error: %s", error->message);
+          g_error_free (error);
+        }
+      g_string_append_c (result, '\n');
+
+      if (token.type == GTK_CSS_TOKEN_EOF)
+        {
+          gtk_css_token_clear (&token);
+          break;
+        }
+
+      gtk_css_token_clear (&token);
+    }
+
+  gtk_css_tokenizer_unref (tokenizer);
+
+  return g_string_free (result, FALSE);
+}
+
+static void
+test_precompile (gconstpointer data)
+{
+  const char *filename = data;
+  GBytes *bytes, *precompiled;
+  char *contents, *tokens, *precompiled_tokens;
+  gsize length;
+  GError *error = NULL;
+
+  g_file_get_contents (filename, &contents, &length, &error);
+  g_assert_no_error (error);
+  bytes = g_bytes_new_take (contents, length);
+
+  g_assert_false (gtk_css_tokenizer_is_precompiled (bytes));
+  precompiled = gtk_css_tokenizer_precompile (bytes);
+  g_assert_true (gtk_css_tokenizer_is_precompiled (precompiled));
+
+  tokens = tokenize (gtk_css_tokenizer_new (bytes));
+  precompiled_tokens = tokenize (gtk_css_tokenizer_new_precompiled (precompiled));
+
+  g_assert_cmpstr (tokens, ==, precompiled_tokens);
+
+  g_free (tokens);
+  g_free (precompiled_tokens);
+  g_bytes_unref (precompiled);
+  g_bytes_unref (bytes);
+}
+
+static void
+test_no_sniffing (void)
+{
+  GBytes *bytes, *precompiled;
+  const char *text = ".a { color: red; }";
+  char *tokens, *sniffed_tokens;
+
+  bytes = g_bytes_new_static (text, strlen (text));
+  precompiled = gtk_css_tokenizer_precompile (bytes);
+
+  /* Data that happens to look precompiled must still be
+   * tokenized as CSS text by the generic entry point.
+   */
+  tokens = tokenize (gtk_css_tokenizer_new_precompiled (precompiled));
+  sniffed_tokens = tokenize (gtk_css_tokenizer_new (precompiled));
+  g_assert_cmpstr (tokens, !=, sniffed_tokens);
+
+  /* And text is never replayed */
+  g_assert_null (gtk_css_tokenizer_new_precompiled (bytes));
+
+  g_free (tokens);
+  g_free (sniffed_tokens);
+  g_bytes_unref (precompiled);
+  g_bytes_unref (bytes);
+}
+
+static void
+test_corrupt (void)
+{
+  GBytes *bytes, *precompiled, *truncated, *corrupt;
+  guint32 strings_size;
+  guchar *data;
+  gsize size;
+  const char *text = ".a { color: red; } .b { background: url(\"foo.png\"); }";
+  char *tokens;
+
+  bytes = g_bytes_new_static (text, strlen (text));
+  precompiled = gtk_css_tokenizer_precompile (bytes);
+
+  /* Cutting off the end fails the size check */
+  truncated = g_bytes_new_from_bytes (precompiled, 0, g_bytes_get_size (precompiled) - 3);
+  g_assert_false (gtk_css_tokenizer_is_precompiled (truncated));
+  g_assert_null (gtk_css_tokenizer_new_precompiled (truncated));
+
+  /* Garbage tokens must be reported as errors */
+  data = g_bytes_unref_to_data (g_bytes_ref (precompiled), &size);
+  memcpy (&strings_size, data + 12, sizeof (guint32));
+  memset (data + 24 + GUINT32_FROM_LE (strings_size), 0xFF, size - 24 - GUINT32_FROM_LE (strings_size));
+  corrupt = g_bytes_new_take (data, size);
+  g_assert_true (gtk_css_tokenizer_is_precompiled (corrupt));
+
+  tokens = tokenize (gtk_css_tokenizer_new_precompiled (corrupt));
+  g_assert_nonnull (strstr (tokens, "corrupt"));
+  g_free (tokens);
+
+  g_bytes_unref (corrupt);
+  g_bytes_unref (truncated);
+  g_bytes_unref (precompiled);
+  g_bytes_unref (bytes);
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *name;
+  char *path;
+  GDir *dir;
+  GError *error = NULL;
+
+  gtk_test_init (&argc, &argv);
+
+  path = g_test_build_filename (G_TEST_DIST, "parser", NULL);
+  dir = g_dir_open (path, 0, &error);
+  g_assert_no_error (error);
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      char *test_name;
+
+      if (!g_str_has_suffix (name, ".css") || g_str_has_suffix (name, ".ref.css"))
+        continue;
+
+      test_name = g_strconcat ("/css/precompile/", name, NULL);
+      g_test_add_data_func_full (test_name,
+                                 g_build_filename (path, name, NULL),
+                                 test_precompile,
+                                 g_free);
+      g_free (test_name);
+    }
+
+  g_dir_close (dir);
+  g_free (path);
+
+  g_test_add_func ("/css/precompile/no-sniffing", test_no_sniffing);
+  g_test_add_func ("/css/precompile/corrupt", test_corrupt);
+
+  return g_test_run ();
+}
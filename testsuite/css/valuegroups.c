@@ -0,0 +1,242 @@
+/*
+ * Copyright © 2020 GNOME Foundation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* When a style is recomputed, the groups of values that can't have
+ * changed are shared with the previous style. These tests check that
+ * the groups that did change are still recomputed.
+ */
+
+#include <gtk/gtk.h>
+
+static GtkCssProvider *
+add_provider (const char *css)
+{
+  GtkCssProvider *provider;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider, css, -1);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  return provider;
+}
+
+static void
+remove_provider (GtkCssProvider *provider)
+{
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (provider));
+  g_object_unref (provider);
+}
+
+static void
+assert_color (GtkWidget  *widget,
+              const char *expected)
+{
+  GdkRGBA color, expected_color;
+
+  gtk_style_context_get_color (gtk_widget_get_style_context (widget), &color);
+  g_assert_true (gdk_rgba_parse (&expected_color, expected));
+  g_assert_true (gdk_rgba_equal (&color, &expected_color));
+}
+
+static int
+get_padding_top (GtkWidget *widget)
+{
+  GtkBorder padding;
+
+  gtk_style_context_get_padding (gtk_widget_get_style_context (widget), &padding);
+
+  return padding.top;
+}
+
+static int
+get_border_top (GtkWidget *widget)
+{
+  GtkBorder border;
+
+  gtk_style_context_get_border (gtk_widget_get_style_context (widget), &border);
+
+  return border.top;
+}
+
+static char *
+get_font_family (GtkWidget *widget)
+{
+  PangoContext *context;
+  char *family;
+
+  context = gtk_widget_create_pango_context (widget);
+  family = g_strdup (pango_font_description_get_family (pango_context_get_font_description (context)));
+  g_object_unref (context);
+
+  return family;
+}
+
+static void
+set_hover (GtkWidget *widget,
+           gboolean   hover)
+{
+  if (hover)
+    gtk_widget_set_state_flags (widget, GTK_STATE_FLAG_PRELIGHT, FALSE);
+  else
+    gtk_widget_unset_state_flags (widget, GTK_STATE_FLAG_PRELIGHT);
+}
+
+/* Changing one group keeps the values of the others */
+static void
+test_change_one_group (void)
+{
+  GtkCssProvider *provider;
+  GtkWidget *box;
+
+  provider = add_provider ("box { color: rgb(0,0,255); border: 2px solid; padding: 3px; }"
+                           "box:hover { padding: 7px; }");
+
+  box = g_object_ref_sink (gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0));
+
+  g_assert_cmpint (get_padding_top (box), ==, 3);
+  g_assert_cmpint (get_border_top (box), ==, 2);
+  assert_color (box, "rgb(0,0,255)");
+
+  set_hover (box, TRUE);
+  g_assert_cmpint (get_padding_top (box), ==, 7);
+  g_assert_cmpint (get_border_top (box), ==, 2);
+  assert_color (box, "rgb(0,0,255)");
+
+  set_hover (box, FALSE);
+  g_assert_cmpint (get_padding_top (box), ==, 3);
+  g_assert_cmpint (get_border_top (box), ==, 2);
+  assert_color (box, "rgb(0,0,255)");
+
+  g_object_unref (box);
+  remove_provider (provider);
+}
+
+/* Groups that aren't set by the changed rule still depend
+ * on the core values, like font-size for em units */
+static void
+test_change_core (void)
+{
+  GtkCssProvider *provider;
+  GtkWidget *box;
+
+  provider = add_provider ("box { font-size: 10px; padding: 1em; }"
+                           "box:hover { font-size: 20px; }");
+
+  box = g_object_ref_sink (gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0));
+
+  g_assert_cmpint (get_padding_top (box), ==, 10);
+
+  set_hover (box, TRUE);
+  g_assert_cmpint (get_padding_top (box), ==, 20);
+
+  set_hover (box, FALSE);
+  g_assert_cmpint (get_padding_top (box), ==, 10);
+
+  g_object_unref (box);
+  remove_provider (provider);
+}
+
+/* Inherited groups follow changes to the parent style, even
+ * though no rule matching the child changed */
+static void
+test_parent_change (void)
+{
+  GtkCssProvider *provider;
+  GtkWidget *box, *label;
+  char *family;
+
+  provider = add_provider ("box { color: rgb(0,0,255); font-family: Cantarell; }"
+                           "box:hover { color: rgb(255,0,0); font-family: Sans; }"
+                           "label { padding: 3px; }");
+
+  box = g_object_ref_sink (gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0));
+  label = gtk_label_new ("label");
+  gtk_box_append (GTK_BOX (box), label);
+
+  assert_color (box, "rgb(0,0,255)");
+  assert_color (label, "rgb(0,0,255)");
+  family = get_font_family (label);
+  g_assert_cmpstr (family, ==, "Cantarell");
+  g_free (family);
+
+  set_hover (box, TRUE);
+  assert_color (box, "rgb(255,0,0)");
+  assert_color (label, "rgb(255,0,0)");
+  family = get_font_family (label);
+  g_assert_cmpstr (family, ==, "Sans");
+  g_free (family);
+  g_assert_cmpint (get_padding_top (label), ==, 3);
+
+  set_hover (box, FALSE);
+  assert_color (box, "rgb(0,0,255)");
+  assert_color (label, "rgb(0,0,255)");
+  family = get_font_family (label);
+  g_assert_cmpstr (family, ==, "Cantarell");
+  g_free (family);
+
+  g_object_unref (box);
+  remove_provider (provider);
+}
+
+/* The inherit keyword makes a group that isn't inherited
+ * by default depend on the parent style */
+static void
+test_inherit_keyword (void)
+{
+  GtkCssProvider *provider;
+  GtkWidget *box, *label;
+
+  provider = add_provider ("box { border: 2px solid; }"
+                           "box:hover { border-width: 6px; }"
+                           "label { border-style: solid; border-top-width: inherit; }");
+
+  box = g_object_ref_sink (gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0));
+  label = gtk_label_new ("label");
+  gtk_box_append (GTK_BOX (box), label);
+
+  g_assert_cmpint (get_border_top (box), ==, 2);
+  g_assert_cmpint (get_border_top (label), ==, 2);
+
+  set_hover (box, TRUE);
+  g_assert_cmpint (get_border_top (box), ==, 6);
+  g_assert_cmpint (get_border_top (label), ==, 6);
+
+  set_hover (box, FALSE);
+  g_assert_cmpint (get_border_top (box), ==, 2);
+  g_assert_cmpint (get_border_top (label), ==, 2);
+
+  g_object_unref (box);
+  remove_provider (provider);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_setenv ("GTK_THEME", "Empty", TRUE);
+
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/css/value-groups/change-one-group", test_change_one_group);
+  g_test_add_func ("/css/value-groups/change-core", test_change_core);
+  g_test_add_func ("/css/value-groups/parent-change", test_parent_change);
+  g_test_add_func ("/css/value-groups/inherit-keyword", test_inherit_keyword);
+
+  return g_test_run ();
+}
@@ -71,9 +71,9 @@ compare_textures (GdkTexture *expected,
       for (x = 0; x < width; x++)
         {
           if (ignore_alpha)
-            g_assert_cmphex (*(guint32 *) &expected_data[y * width + x * 4] & 0xFFFFFF, ==, *(guint32 *) &test_data[y * width + x * 4] & 0xFFFFFF);
+            g_assert_cmphex (*(guint32 *) &expected_data[(y * width + x) * 4] & 0xFFFFFF, ==, *(guint32 *) &test_data[(y * width + x) * 4] & 0xFFFFFF);
           else
-            g_assert_cmphex (*(guint32 *) &expected_data[y * width + x * 4], ==, *(guint32 *) &test_data[y * width + x * 4]);
+            g_assert_cmphex (*(guint32 *) &expected_data[(y * width + x) * 4], ==, *(guint32 *) &test_data[(y * width + x) * 4]);
         }
     }
 
@@ -172,12 +172,168 @@ test_download_4x4_with_stride (gconstpointer data)
   g_object_unref (test);
 }
 
+/* Big enough to use the vectorized converters, including
+ * their tails, and to be split across threads.
+ */
+static void
+test_download_large (gconstpointer data)
+{
+  const TestData *test_data = data;
+  GdkTexture *expected, *test;
+
+  expected = create_texture (GDK_MEMORY_DEFAULT, test_data->color, 1031, 300, 1031 * 4);
+  test = create_texture (test_data->format, test_data->color, 1031, 300, 1031 * tests[test_data->format].bytes_per_pixel);
+
+  compare_textures (expected, test, tests[test_data->format].opaque);
+
+  g_object_unref (expected);
+  g_object_unref (test);
+}
+
+/* The channel order of each format, in memory */
+static const struct {
+  const char *channels;
+  gboolean premultiplied;
+} format_layout[GDK_MEMORY_N_FORMATS] = {
+  { "bgra", TRUE },
+  { "argb", TRUE },
+  { "bgra", FALSE },
+  { "argb", FALSE },
+  { "rgba", FALSE },
+  { "abgr", FALSE },
+  { "rgb", FALSE },
+  { "bgr", FALSE },
+};
+
+/* Different for every channel and pixel, so that swapped channels,
+ * wrong strides or rows converted in the wrong place show up.
+ */
+static guchar
+pattern_value (int  x,
+               int  y,
+               char channel)
+{
+  switch (channel)
+    {
+    case 'r':
+      return (x * 7 + y * 13) & 0xff;
+    case 'g':
+      return (x * 3 + y * 11 + 85) & 0xff;
+    case 'b':
+      return (x * 5 + y * 17 + 170) & 0xff;
+    case 'a':
+      return (x + y * 31 + 40) & 0xff;
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static guchar
+premultiply (guchar c,
+             guchar a)
+{
+  guint t = c * a + 0x80;
+
+  return ((t >> 8) + t) >> 8;
+}
+
+static void
+test_download_pattern (GdkMemoryFormat format,
+                       int             width,
+                       int             height)
+{
+  const char *channels = format_layout[format].channels;
+  gsize bpp = strlen (channels);
+  gsize stride;
+  GdkTexture *texture;
+  GBytes *bytes;
+  guchar *data, *downloaded;
+  int x, y;
+  gsize c;
+
+  /* An odd stride, so rows don't start aligned */
+  stride = width * bpp + 5;
+  data = g_malloc (stride * height);
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      for (c = 0; c < bpp; c++)
+        data[y * stride + x * bpp + c] = pattern_value (x, y, channels[c]);
+
+  bytes = g_bytes_new_take (data, stride * height);
+  texture = gdk_memory_texture_new (width, height, format, bytes, stride);
+  g_bytes_unref (bytes);
+
+  downloaded = g_malloc (width * height * 4);
+  gdk_texture_download (texture, downloaded, width * 4);
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        const guchar *pixel = &downloaded[(y * width + x) * 4];
+        guchar r, g, b, a;
+
+        r = pattern_value (x, y, 'r');
+        g = pattern_value (x, y, 'g');
+        b = pattern_value (x, y, 'b');
+        if (bpp == 3)
+          a = 0xff;
+        else
+          a = pattern_value (x, y, 'a');
+
+        if (!format_layout[format].premultiplied)
+          {
+            r = premultiply (r, a);
+            g = premultiply (g, a);
+            b = premultiply (b, a);
+          }
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+        g_assert_cmphex (pixel[0], ==, b);
+        g_assert_cmphex (pixel[1], ==, g);
+        g_assert_cmphex (pixel[2], ==, r);
+        g_assert_cmphex (pixel[3], ==, a);
+#else
+        g_assert_cmphex (pixel[0], ==, a);
+        g_assert_cmphex (pixel[1], ==, r);
+        g_assert_cmphex (pixel[2], ==, g);
+        g_assert_cmphex (pixel[3], ==, b);
+#endif
+      }
+
+  g_free (downloaded);
+  g_object_unref (texture);
+}
+
+/* Sizes that aren't a multiple of the vector width, so every row
+ * has a tail, and big enough to be split into row chunks where the
+ * last chunk is a partial one.
+ */
+static void
+test_download_pattern_small (gconstpointer data)
+{
+  GdkMemoryFormat format = GPOINTER_TO_UINT (data);
+
+  test_download_pattern (format, 1, 1);
+  test_download_pattern (format, 7, 3);
+  test_download_pattern (format, 13, 5);
+}
+
+static void
+test_download_pattern_large (gconstpointer data)
+{
+  GdkMemoryFormat format = GPOINTER_TO_UINT (data);
+
+  test_download_pattern (format, 1031, 301);
+  test_download_pattern (format, 517, 1029);
+}
+
 int
 main (int argc, char *argv[])
 {
   GdkMemoryFormat format;
   Color color;
   GEnumClass *enum_class;
+  char *test_name;
 
   g_test_init (&argc, &argv, NULL);
 
@@ -188,9 +344,9 @@ main (int argc, char *argv[])
       for (color = 0; color < N_COLORS; color++)
         {
           TestData *test_data = g_new (TestData, 1);
-          char *test_name = g_strdup_printf ("/memorytexture/download_1x1/%s/%s",
-                                             g_enum_get_value (enum_class, format)->value_nick,
-                                             color_names[color]);
+          test_name = g_strdup_printf ("/memorytexture/download_1x1/%s/%s",
+                                       g_enum_get_value (enum_class, format)->value_nick,
+                                       color_names[color]);
           test_data->format = format;
           test_data->color = color;
           g_test_add_data_func_full (test_name, test_data, test_download_1x1, g_free);
@@ -222,7 +378,26 @@ main (int argc, char *argv[])
           test_data->color = color;
           g_test_add_data_func_full (test_name, test_data, test_download_4x4_with_stride, g_free);
           g_free (test_name);
+
+          test_data = g_new (TestData, 1);
+          test_name = g_strdup_printf ("/memorytexture/download_large/%s/%s",
+                                       g_enum_get_value (enum_class, format)->value_nick,
+                                       color_names[color]);
+          test_data->format = format;
+          test_data->color = color;
+          g_test_add_data_func_full (test_name, test_data, test_download_large, g_free);
+          g_free (test_name);
         }
+
+      test_name = g_strdup_printf ("/memorytexture/download_pattern/%s",
+                                   g_enum_get_value (enum_class, format)->value_nick);
+      g_test_add_data_func (test_name, GUINT_TO_POINTER (format), test_download_pattern_small);
+      g_free (test_name);
+
+      test_name = g_strdup_printf ("/memorytexture/download_pattern_large/%s",
+                                   g_enum_get_value (enum_class, format)->value_nick);
+      g_test_add_data_func (test_name, GUINT_TO_POINTER (format), test_download_pattern_large);
+      g_free (test_name);
     }
 
   return g_test_run ();
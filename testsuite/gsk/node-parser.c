@@ -149,6 +149,48 @@ deserialize_error_func (const GtkCssSection *section,
   g_string_append_c (errors, '\n');
 }
 
+static gboolean
+test_binary_roundtrip (GskRenderNode *node,
+                       GBytes        *text)
+{
+  GskRenderNode *loaded;
+  GBytes *binary, *roundtrip;
+  GString *errors;
+  gboolean result = TRUE;
+
+  /* Cairo scripts are not part of the binary format */
+  if (g_strstr_len (g_bytes_get_data (text, NULL), g_bytes_get_size (text), "script:"))
+    return TRUE;
+
+  errors = g_string_new ("");
+
+  binary = gsk_render_node_serialize_binary (node);
+  loaded = gsk_render_node_deserialize (binary, deserialize_error_func, errors);
+  g_bytes_unref (binary);
+
+  if (errors->str[0] || loaded == NULL)
+    {
+      g_print ("Errors loading binary data:\n%s\n", errors->str);
+      g_clear_pointer (&loaded, gsk_render_node_unref);
+      g_string_free (errors, TRUE);
+      return FALSE;
+    }
+
+  roundtrip = gsk_render_node_serialize (loaded);
+  if (!g_bytes_equal (roundtrip, text))
+    {
+      g_print ("Binary data doesn't round-trip:\n%s\n",
+               (const char *) g_bytes_get_data (roundtrip, NULL));
+      result = FALSE;
+    }
+
+  g_bytes_unref (roundtrip);
+  gsk_render_node_unref (loaded);
+  g_string_free (errors, TRUE);
+
+  return result;
+}
+
 static gboolean
 parse_node_file (GFile *file, gboolean generate)
 {
@@ -173,16 +215,20 @@ parse_node_file (GFile *file, gboolean generate)
   node = gsk_render_node_deserialize (bytes, deserialize_error_func, errors);
   g_bytes_unref (bytes);
   bytes = gsk_render_node_serialize (node);
-  gsk_render_node_unref (node);
 
   if (generate)
     {
       g_print ("%s", (char *) g_bytes_get_data (bytes, NULL));
       g_bytes_unref (bytes);
       g_string_free (errors, TRUE);
+      gsk_render_node_unref (node);
       return TRUE;
     }
 
+  if (!test_binary_roundtrip (node, bytes))
+    result = FALSE;
+  gsk_render_node_unref (node);
+
   node_file = g_file_get_path (file);
   reference_file = test_get_reference_file (node_file);
 
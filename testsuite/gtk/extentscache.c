@@ -0,0 +1,206 @@
+/*
+ * Copyright © 2020 GNOME Foundation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+#include "gtk/gtkextentscacheprivate.h"
+
+static PangoContext *
+create_context (void)
+{
+  PangoContext *context;
+  PangoFontDescription *desc;
+
+  context = pango_font_map_create_context (pango_cairo_font_map_get_default ());
+  desc = pango_font_description_from_string ("Sans 12");
+  pango_context_set_font_description (context, desc);
+  pango_font_description_free (desc);
+
+  return context;
+}
+
+/* Measures @layout and stores the result in the cache */
+static void
+measure_and_cache (PangoLayout *layout,
+                   int          width)
+{
+  PangoRectangle rect;
+
+  pango_layout_set_width (layout, width);
+  pango_layout_get_extents (layout, NULL, &rect);
+  gtk_pango_layout_cache_extents (layout, width, &rect, pango_layout_get_baseline (layout));
+}
+
+static gboolean
+is_cached (PangoLayout *layout,
+           int          width)
+{
+  PangoRectangle rect;
+  int baseline;
+
+  return gtk_pango_layout_get_cached_extents (layout, width, &rect, &baseline);
+}
+
+/* A hit returns what measuring the layout itself returns */
+static void
+test_hit (void)
+{
+  PangoContext *context;
+  PangoLayout *layout, *other;
+  PangoRectangle rect, cached_rect;
+  int baseline, cached_baseline;
+
+  context = create_context ();
+  layout = pango_layout_new (context);
+  pango_layout_set_text (layout, "Hit the cache", -1);
+  measure_and_cache (layout, -1);
+
+  other = pango_layout_new (context);
+  pango_layout_set_text (other, "Hit the cache", -1);
+  pango_layout_get_extents (other, NULL, &rect);
+  baseline = pango_layout_get_baseline (other);
+
+  g_assert_true (gtk_pango_layout_get_cached_extents (other, -1, &cached_rect, &cached_baseline));
+  g_assert_cmpint (cached_rect.x, ==, rect.x);
+  g_assert_cmpint (cached_rect.y, ==, rect.y);
+  g_assert_cmpint (cached_rect.width, ==, rect.width);
+  g_assert_cmpint (cached_rect.height, ==, rect.height);
+  g_assert_cmpint (cached_baseline, ==, baseline);
+
+  g_object_unref (other);
+  g_object_unref (layout);
+  g_object_unref (context);
+}
+
+static void
+test_miss_font (void)
+{
+  PangoContext *context;
+  PangoLayout *layout;
+  PangoFontDescription *desc;
+
+  context = create_context ();
+  layout = pango_layout_new (context);
+  pango_layout_set_text (layout, "Change the font", -1);
+  measure_and_cache (layout, -1);
+  g_assert_true (is_cached (layout, -1));
+
+  /* The font of the layout */
+  desc = pango_font_description_from_string ("Sans 20");
+  pango_layout_set_font_description (layout, desc);
+  g_assert_false (is_cached (layout, -1));
+  pango_layout_set_font_description (layout, NULL);
+  g_assert_true (is_cached (layout, -1));
+
+  /* The font of the context */
+  pango_context_set_font_description (context, desc);
+  pango_layout_context_changed (layout);
+  g_assert_false (is_cached (layout, -1));
+  pango_font_description_free (desc);
+
+  g_object_unref (layout);
+  g_object_unref (context);
+}
+
+static void
+test_miss_attributes (void)
+{
+  PangoContext *context;
+  PangoLayout *layout;
+  PangoAttrList *attrs;
+  PangoAttribute *attr;
+
+  context = create_context ();
+  layout = pango_layout_new (context);
+  pango_layout_set_text (layout, "Change the attributes", -1);
+  measure_and_cache (layout, -1);
+
+  attrs = pango_attr_list_new ();
+  pango_attr_list_insert (attrs, pango_attr_weight_new (PANGO_WEIGHT_BOLD));
+  pango_layout_set_attributes (layout, attrs);
+  g_assert_false (is_cached (layout, -1));
+  measure_and_cache (layout, -1);
+  g_assert_true (is_cached (layout, -1));
+
+  /* Same attribute type and range, different value */
+  attr = pango_attr_weight_new (PANGO_WEIGHT_LIGHT);
+  pango_attr_list_change (attrs, attr);
+  pango_layout_set_attributes (layout, attrs);
+  g_assert_false (is_cached (layout, -1));
+  pango_attr_list_unref (attrs);
+
+  pango_layout_set_attributes (layout, NULL);
+  g_assert_true (is_cached (layout, -1));
+
+  g_object_unref (layout);
+  g_object_unref (context);
+}
+
+static void
+test_miss_width (void)
+{
+  PangoContext *context;
+  PangoLayout *layout;
+
+  context = create_context ();
+  layout = pango_layout_new (context);
+  pango_layout_set_text (layout, "Change the width of a long line of text", -1);
+  pango_layout_set_wrap (layout, PANGO_WRAP_WORD);
+  measure_and_cache (layout, 50 * PANGO_SCALE);
+
+  g_assert_true (is_cached (layout, 50 * PANGO_SCALE));
+  g_assert_false (is_cached (layout, 100 * PANGO_SCALE));
+  g_assert_false (is_cached (layout, -1));
+
+  g_object_unref (layout);
+  g_object_unref (context);
+}
+
+static void
+test_miss_gravity_hint (void)
+{
+  PangoContext *context;
+  PangoLayout *layout;
+
+  context = create_context ();
+  pango_context_set_base_gravity (context, PANGO_GRAVITY_EAST);
+  layout = pango_layout_new (context);
+  pango_layout_set_text (layout, "Change the gravity hint", -1);
+  measure_and_cache (layout, -1);
+  g_assert_true (is_cached (layout, -1));
+
+  pango_context_set_gravity_hint (context, PANGO_GRAVITY_HINT_STRONG);
+  pango_layout_context_changed (layout);
+  g_assert_false (is_cached (layout, -1));
+
+  g_object_unref (layout);
+  g_object_unref (context);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/extents-cache/hit", test_hit);
+  g_test_add_func ("/extents-cache/miss/font", test_miss_font);
+  g_test_add_func ("/extents-cache/miss/attributes", test_miss_attributes);
+  g_test_add_func ("/extents-cache/miss/width", test_miss_width);
+  g_test_add_func ("/extents-cache/miss/gravity-hint", test_miss_gravity_hint);
+
+  return g_test_run ();
+}
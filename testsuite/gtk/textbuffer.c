@@ -1581,6 +1581,360 @@ test_get_iter (void)
   g_object_unref (buffer);
 }
 
+typedef struct {
+  GString *matches;
+  guint n_matches;
+  gboolean done;
+} SearchResult;
+
+static void
+search_match_cb (GtkTextBuffer     *buffer,
+                 const GtkTextIter *match_start,
+                 const GtkTextIter *match_end,
+                 gpointer           user_data)
+{
+  SearchResult *result = user_data;
+
+  g_string_append_printf (result->matches, "%d-%d ",
+                          gtk_text_iter_get_offset (match_start),
+                          gtk_text_iter_get_offset (match_end));
+}
+
+static void
+search_done_cb (GObject      *source,
+                GAsyncResult *res,
+                gpointer      user_data)
+{
+  SearchResult *result = user_data;
+  GError *error = NULL;
+
+  result->n_matches = gtk_text_buffer_search_finish (GTK_TEXT_BUFFER (source), res, &error);
+  g_assert_no_error (error);
+  result->done = TRUE;
+}
+
+static void
+check_search (GtkTextBuffer      *buffer,
+              const char         *str,
+              GRegex             *regex,
+              GtkTextSearchFlags  flags,
+              guint               expected_n_matches,
+              const char         *expected_matches)
+{
+  SearchResult result = { g_string_new (NULL), 0, FALSE };
+
+  if (regex)
+    gtk_text_buffer_search_regex_async (buffer, regex, 0, search_match_cb,
+                                        NULL, search_done_cb, &result);
+  else
+    gtk_text_buffer_search_async (buffer, str, flags, search_match_cb,
+                                  NULL, search_done_cb, &result);
+
+  while (!result.done)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpuint (result.n_matches, ==, expected_n_matches);
+  g_assert_cmpstr (result.matches->str, ==, expected_matches);
+
+  g_string_free (result.matches, TRUE);
+}
+
+static void
+test_search_async (void)
+{
+  GtkTextBuffer *buffer;
+  GRegex *regex;
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (buffer, "Foo foo\n\303\200 foofoo bar", -1);
+
+  check_search (buffer, "foo", NULL, 0, 3, "4-7 10-13 13-16 ");
+  check_search (buffer, "foo", NULL, GTK_TEXT_SEARCH_CASE_INSENSITIVE, 4, "0-3 4-7 10-13 13-16 ");
+  check_search (buffer, "baz", NULL, 0, 0, "");
+
+  regex = g_regex_new ("^\\S+", G_REGEX_MULTILINE, 0, NULL);
+  check_search (buffer, NULL, regex, 0, 2, "0-3 8-9 ");
+  g_regex_unref (regex);
+
+  g_object_unref (buffer);
+}
+
+static void
+test_bulk_insert (void)
+{
+  const char *separators[] = { "\n", "\r\n", "\r", "\342\200\251" };
+  GtkTextBuffer *buffer;
+  GtkTextMark *mark;
+  GtkTextIter iter, start, end;
+  GString *str;
+  int i, n_lines, offset;
+  char *text;
+
+  str = g_string_new (NULL);
+  for (i = 0; i < 10000; i++)
+    g_string_append_printf (str, "line %d \303\200%s", i, separators[i % G_N_ELEMENTS (separators)]);
+  g_string_append (str, "last");
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  mark = gtk_text_buffer_create_mark (buffer, "left", &iter, TRUE);
+
+  check_get_set_text (buffer, str->str);
+
+  g_assert_cmpint (gtk_text_buffer_get_line_count (buffer), ==, 10001);
+  gtk_text_buffer_get_iter_at_mark (buffer, &iter, mark);
+  g_assert_true (gtk_text_iter_is_start (&iter));
+  gtk_text_buffer_get_iter_at_mark (buffer, &iter, gtk_text_buffer_get_insert (buffer));
+  g_assert_true (gtk_text_iter_is_end (&iter));
+
+  /* Lines must be where they were put */
+  offset = 0;
+  for (i = 0; i < 10000; i++)
+    {
+      char *line = g_strdup_printf ("line %d \303\200", i);
+
+      gtk_text_buffer_get_iter_at_line (buffer, &iter, i);
+      g_assert_cmpint (gtk_text_iter_get_offset (&iter), ==, offset);
+      g_assert_cmpint (gtk_text_iter_get_line (&iter), ==, i);
+
+      offset += g_utf8_strlen (line, -1) + (i % G_N_ELEMENTS (separators) == 1 ? 2 : 1);
+      g_free (line);
+    }
+
+  /* The tree must survive editing */
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, 5000);
+  gtk_text_buffer_insert (buffer, &iter, "a\nb\nc\n", -1);
+  g_assert_cmpint (gtk_text_buffer_get_line_count (buffer), ==, 10004);
+  gtk_text_buffer_get_iter_at_line (buffer, &start, 100);
+  gtk_text_buffer_get_iter_at_line (buffer, &end, 9900);
+  gtk_text_buffer_delete (buffer, &start, &end);
+  g_assert_cmpint (gtk_text_buffer_get_line_count (buffer), ==, 204);
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, 100);
+  g_assert_cmpint (gtk_text_iter_get_chars_in_line (&iter), ==, g_utf8_strlen ("line 9897 \303\200\r\n", -1));
+
+  /* Loading into a buffer that had text */
+  check_get_set_text (buffer, str->str);
+  g_assert_cmpint (gtk_text_buffer_get_line_count (buffer), ==, 10001);
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  text = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+  g_assert_cmpstr (text, ==, str->str);
+  g_free (text);
+
+  g_object_unref (buffer);
+  g_string_free (str, TRUE);
+}
+
+static char *
+get_tag_toggles (GtkTextBuffer *buffer,
+                 GtkTextTag    *tag)
+{
+  GString *str = g_string_new (NULL);
+  GtkTextIter iter;
+
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  if (gtk_text_iter_starts_tag (&iter, tag))
+    g_string_append (str, "0 ");
+  while (gtk_text_iter_forward_to_tag_toggle (&iter, tag))
+    g_string_append_printf (str, "%d ", gtk_text_iter_get_offset (&iter));
+
+  return g_string_free (str, FALSE);
+}
+
+static void
+record_tag_span (GtkTextBuffer *buffer,
+                 GtkTextTag    *tag,
+                 GtkTextIter   *start,
+                 GtkTextIter   *end,
+                 GString       *spans)
+{
+  g_string_append_printf (spans, "%d-%d ",
+                          gtk_text_iter_get_offset (start),
+                          gtk_text_iter_get_offset (end));
+}
+
+static void
+test_tag_ranges (void)
+{
+  const int offsets[] = { 0, 3, 3, 5, 9, 12, 12, 12, 20, 31, 40, 45 };
+  GtkTextBuffer *buffer, *expected;
+  GtkTextTag *tag, *expected_tag;
+  GtkTextIter start, end;
+  char *toggles, *expected_toggles;
+  GString *spans;
+  guint i;
+
+  buffer = gtk_text_buffer_new (NULL);
+  expected = gtk_text_buffer_new (NULL);
+  tag = gtk_text_buffer_create_tag (buffer, "bold", "weight", PANGO_WEIGHT_BOLD, NULL);
+  expected_tag = gtk_text_buffer_create_tag (expected, "bold", "weight", PANGO_WEIGHT_BOLD, NULL);
+
+  for (i = 0; i < 2; i++)
+    {
+      GtkTextBuffer *b = i == 0 ? buffer : expected;
+      GtkTextTag *t = i == 0 ? tag : expected_tag;
+
+      gtk_text_buffer_set_text (b, "line one\nline two\n\nline \303\244our\nfive\nsix and the rest", -1);
+      gtk_text_buffer_get_iter_at_offset (b, &start, 7);
+      gtk_text_buffer_get_iter_at_offset (b, &end, 25);
+      gtk_text_buffer_apply_tag (b, t, &start, &end);
+    }
+
+  spans = g_string_new (NULL);
+  g_signal_connect (buffer, "apply-tag", G_CALLBACK (record_tag_span), spans);
+  g_signal_connect (buffer, "remove-tag", G_CALLBACK (record_tag_span), spans);
+
+  /* One emission for the span, the default handler tags only the ranges */
+  gtk_text_buffer_apply_tag_ranges (buffer, tag, offsets, G_N_ELEMENTS (offsets));
+  g_assert_cmpstr (spans->str, ==, "0-45 ");
+  g_string_truncate (spans, 0);
+
+  for (i = 0; i < G_N_ELEMENTS (offsets); i += 2)
+    {
+      gtk_text_buffer_get_iter_at_offset (expected, &start, offsets[i]);
+      gtk_text_buffer_get_iter_at_offset (expected, &end, offsets[i + 1]);
+      gtk_text_buffer_apply_tag (expected, expected_tag, &start, &end);
+    }
+
+  toggles = get_tag_toggles (buffer, tag);
+  expected_toggles = get_tag_toggles (expected, expected_tag);
+  g_assert_cmpstr (toggles, ==, "0 5 7 31 40 45 ");
+  g_assert_cmpstr (toggles, ==, expected_toggles);
+  g_free (toggles);
+  g_free (expected_toggles);
+
+  gtk_text_buffer_remove_tag_ranges (buffer, tag, offsets, 4);
+  g_assert_cmpstr (spans->str, ==, "0-5 ");
+  gtk_text_buffer_get_iter_at_offset (expected, &start, 0);
+  gtk_text_buffer_get_iter_at_offset (expected, &end, 5);
+  gtk_text_buffer_remove_tag (expected, expected_tag, &start, &end);
+
+  toggles = get_tag_toggles (buffer, tag);
+  expected_toggles = get_tag_toggles (expected, expected_tag);
+  g_assert_cmpstr (toggles, ==, "7 31 40 45 ");
+  g_assert_cmpstr (toggles, ==, expected_toggles);
+  g_free (toggles);
+  g_free (expected_toggles);
+
+  g_string_free (spans, TRUE);
+  g_object_unref (buffer);
+  g_object_unref (expected);
+}
+
+static void
+check_buffer_text (GtkTextBuffer *buffer,
+                   const char    *expected)
+{
+  GtkTextIter start, end;
+  char *text;
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  text = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+  g_assert_cmpstr (text, ==, expected);
+  g_free (text);
+}
+
+static void
+replace_range (GtkTextBuffer *buffer,
+               int            begin,
+               int            end,
+               const char    *text)
+{
+  GtkTextIter start, stop;
+
+  gtk_text_buffer_begin_user_action (buffer);
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, begin);
+  gtk_text_buffer_get_iter_at_offset (buffer, &stop, end);
+  gtk_text_buffer_delete (buffer, &start, &stop);
+  gtk_text_buffer_insert (buffer, &start, text, -1);
+  gtk_text_buffer_end_user_action (buffer);
+}
+
+static void
+test_undo_replace (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextIter iter;
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  gtk_text_buffer_insert (buffer, &iter, "int main (void) { return 0; }", -1);
+
+  /* Only part of the text changes */
+  replace_range (buffer, 0, 29, "int\nmain (void)\n{\n  return 0;\n}");
+  check_buffer_text (buffer, "int\nmain (void)\n{\n  return 0;\n}");
+  gtk_text_buffer_undo (buffer);
+  check_buffer_text (buffer, "int main (void) { return 0; }");
+  gtk_text_buffer_redo (buffer);
+  check_buffer_text (buffer, "int\nmain (void)\n{\n  return 0;\n}");
+  gtk_text_buffer_undo (buffer);
+
+  /* Nothing changes at all */
+  replace_range (buffer, 4, 8, "main");
+  check_buffer_text (buffer, "int main (void) { return 0; }");
+
+  /* Pure insertion inside the replaced text */
+  replace_range (buffer, 0, 8, "int \303\244main");
+  check_buffer_text (buffer, "int \303\244main (void) { return 0; }");
+  gtk_text_buffer_undo (buffer);
+  check_buffer_text (buffer, "int main (void) { return 0; }");
+  gtk_text_buffer_redo (buffer);
+  check_buffer_text (buffer, "int \303\244main (void) { return 0; }");
+  gtk_text_buffer_undo (buffer);
+  gtk_text_buffer_undo (buffer);
+  check_buffer_text (buffer, "");
+  g_assert_false (gtk_text_buffer_get_can_undo (buffer));
+
+  g_object_unref (buffer);
+
+  /* Pure deletion inside the replaced text */
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  gtk_text_buffer_insert (buffer, &iter, "int \303\244main", -1);
+  replace_range (buffer, 0, 9, "int main");
+  check_buffer_text (buffer, "int main");
+  gtk_text_buffer_undo (buffer);
+  check_buffer_text (buffer, "int \303\244main");
+  gtk_text_buffer_redo (buffer);
+  check_buffer_text (buffer, "int main");
+
+  g_object_unref (buffer);
+}
+
+static void
+test_undo_max_bytes (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextIter iter;
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_max_undo_bytes (buffer, 16);
+  g_assert_cmpuint (gtk_text_buffer_get_max_undo_bytes (buffer), ==, 16);
+
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  gtk_text_buffer_insert (buffer, &iter, "first\n", -1);
+  gtk_text_buffer_insert (buffer, &iter, "second\n", -1);
+  g_assert_true (gtk_text_buffer_get_can_undo (buffer));
+
+  /* Exceeds the budget together with the previous changes */
+  gtk_text_buffer_insert (buffer, &iter, "third\n", -1);
+  gtk_text_buffer_undo (buffer);
+  gtk_text_buffer_undo (buffer);
+  check_buffer_text (buffer, "first\n");
+  g_assert_false (gtk_text_buffer_get_can_undo (buffer));
+
+  /* Exceeds the budget on its own */
+  gtk_text_buffer_get_end_iter (buffer, &iter);
+  gtk_text_buffer_insert (buffer, &iter, "a line that is too long\n", -1);
+  g_assert_false (gtk_text_buffer_get_can_undo (buffer));
+
+  gtk_text_buffer_set_max_undo_bytes (buffer, 0);
+  gtk_text_buffer_insert (buffer, &iter, "a line that is too long\n", -1);
+  g_assert_true (gtk_text_buffer_get_can_undo (buffer));
+
+  g_object_unref (buffer);
+}
+
 int
 main (int argc, char** argv)
 {
@@ -1600,6 +1954,11 @@ main (int argc, char** argv)
   g_test_add_func ("/TextBuffer/Tag", test_tag);
   g_test_add_func ("/TextBuffer/Clipboard", test_clipboard);
   g_test_add_func ("/TextBuffer/Get iter", test_get_iter);
+  g_test_add_func ("/TextBuffer/Search async", test_search_async);
+  g_test_add_func ("/TextBuffer/Bulk insert", test_bulk_insert);
+  g_test_add_func ("/TextBuffer/Tag ranges", test_tag_ranges);
+  g_test_add_func ("/TextBuffer/Undo replace", test_undo_replace);
+  g_test_add_func ("/TextBuffer/Undo max bytes", test_undo_max_bytes);
 
   return g_test_run();
 }
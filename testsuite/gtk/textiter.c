@@ -194,6 +194,66 @@ test_search (void)
   check_found_backward ("aa \303\200", "aa", 0, 0, 2, "aa");
 }
 
+/* Tags and marks split the text into several segments, matches
+ * have to be found across them. Paintables are only skipped when
+ * searching text.
+ */
+static void
+test_search_segments (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextTag *tag;
+  GtkTextIter i, s, e;
+  GdkPaintable *paintable;
+  gboolean res;
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (buffer, "one foobar two\nfoobar", -1);
+
+  tag = gtk_text_buffer_create_tag (buffer, NULL, NULL);
+  gtk_text_buffer_get_iter_at_offset (buffer, &s, 5);
+  gtk_text_buffer_get_iter_at_offset (buffer, &e, 8);
+  gtk_text_buffer_apply_tag (buffer, tag, &s, &e);
+  gtk_text_buffer_get_iter_at_offset (buffer, &i, 9);
+  gtk_text_buffer_create_mark (buffer, NULL, &i, FALSE);
+
+  gtk_text_buffer_get_start_iter (buffer, &i);
+  res = gtk_text_iter_forward_search (&i, "foobar", 0, &s, &e, NULL);
+  g_assert_true (res);
+  g_assert_cmpint (gtk_text_iter_get_offset (&s), ==, 4);
+  g_assert_cmpint (gtk_text_iter_get_offset (&e), ==, 10);
+
+  /* starting in the middle of a match */
+  gtk_text_buffer_get_iter_at_offset (buffer, &i, 5);
+  res = gtk_text_iter_forward_search (&i, "foobar", 0, &s, &e, NULL);
+  g_assert_true (res);
+  g_assert_cmpint (gtk_text_iter_get_offset (&s), ==, 15);
+  g_assert_cmpint (gtk_text_iter_get_offset (&e), ==, 21);
+
+  /* the limit is the last possible match end */
+  gtk_text_buffer_get_iter_at_offset (buffer, &e, 9);
+  res = gtk_text_iter_forward_search (&i, "foobar", 0, NULL, NULL, &e);
+  g_assert_false (res);
+
+  paintable = gdk_paintable_new_empty (1, 1);
+  gtk_text_buffer_get_iter_at_offset (buffer, &i, 7);
+  gtk_text_buffer_insert_paintable (buffer, &i, paintable);
+  g_object_unref (paintable);
+
+  gtk_text_buffer_get_start_iter (buffer, &i);
+  res = gtk_text_iter_forward_search (&i, "foobar", 0, &s, &e, NULL);
+  g_assert_true (res);
+  g_assert_cmpint (gtk_text_iter_get_offset (&s), ==, 16);
+  g_assert_cmpint (gtk_text_iter_get_offset (&e), ==, 22);
+
+  res = gtk_text_iter_forward_search (&i, "foobar", GTK_TEXT_SEARCH_TEXT_ONLY, &s, &e, NULL);
+  g_assert_true (res);
+  g_assert_cmpint (gtk_text_iter_get_offset (&s), ==, 4);
+  g_assert_cmpint (gtk_text_iter_get_offset (&e), ==, 11);
+
+  g_object_unref (buffer);
+}
+
 static void
 test_search_caseless (void)
 {
@@ -788,6 +848,7 @@ main (int argc, char** argv)
   g_test_add_func ("/TextIter/Search Empty", test_empty_search);
   g_test_add_func ("/TextIter/Search Full Buffer", test_search_full_buffer);
   g_test_add_func ("/TextIter/Search", test_search);
+  g_test_add_func ("/TextIter/Search Segments", test_search_segments);
   g_test_add_func ("/TextIter/Search Caseless", test_search_caseless);
   g_test_add_func ("/TextIter/Forward To Tag Toggle", test_forward_to_tag_toggle);
   g_test_add_func ("/TextIter/Forward To Line End", test_forward_to_line_end);